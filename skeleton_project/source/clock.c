@@ -0,0 +1,32 @@
+/**
+ * @file clock.c
+ * @brief Time source for the control logic.
+ */
+
+#include "clock.h"
+#include <stddef.h>
+#include <time.h>
+
+static uint64_t monotonic_ns(void) {
+    struct timespec ts;
+    clock_gettime(CLOCK_MONOTONIC, &ts);
+    return (uint64_t)ts.tv_sec * 1000000000u + (uint64_t)ts.tv_nsec;
+}
+
+static clock_source_f source = monotonic_ns;
+
+void clock_set_source(clock_source_f new_source) {
+    source = new_source != NULL ? new_source : monotonic_ns;
+}
+
+uint64_t clock_now_ns(void) {
+    return source();
+}
+
+uint64_t clock_now_ms(void) {
+    return source() / 1000000u;
+}
+
+uint64_t clock_wall_ns(void) {
+    return monotonic_ns();
+}
@@ -0,0 +1,44 @@
+/**
+ * @file clock.h
+ * @brief Time source for the control logic.
+ *
+ * Timers and log timestamps read the time through this module. It
+ * defaults to the monotonic clock; a simulator installs a virtual clock
+ * so that the unmodified control code runs on simulated time.
+ */
+
+#ifndef CLOCK_H
+#define CLOCK_H
+
+#include <stdint.h>
+
+/**
+ * @brief A time source returning nanoseconds since an arbitrary epoch.
+ */
+typedef uint64_t (*clock_source_f)(void);
+
+/**
+ * @brief Installs a time source.
+ *
+ * @param source The new source, or NULL for the monotonic clock.
+ */
+void clock_set_source(clock_source_f source);
+
+/**
+ * @brief Returns the current time in nanoseconds.
+ */
+uint64_t clock_now_ns(void);
+
+/**
+ * @brief Returns the current time in milliseconds.
+ */
+uint64_t clock_now_ms(void);
+
+/**
+ * @brief Returns the monotonic clock in nanoseconds, whatever the source.
+ *
+ * For measuring how long code takes to run, which virtual time cannot.
+ */
+uint64_t clock_wall_ns(void);
+
+#endif
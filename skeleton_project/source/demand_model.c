@@ -0,0 +1,224 @@
+/**
+ * @file demand_model.c
+ * @brief Learned hall-call demand and the idle parking policy built on it.
+ *
+ * Each bucket keeps one count per floor and the day it was last updated.
+ * A bucket is aged by DEMAND_DAY_DECAY per day when it is next recorded
+ * into, so a bucket only ever mixes days at consistent weights. Parking
+ * weighs the current bucket and the next, since an idle car may well
+ * wait into the next one, each decayed to the current day.
+ *
+ * A model belongs to one group of cars and is only touched by the thread
+ * running that group.
+ */
+
+#include "demand_model.h"
+#include "clock.h"
+#include <limits.h>
+#include <stdio.h>
+#include <stdlib.h>
+#include <string.h>
+#include <time.h>
+
+#define DEMAND_DAY_MS (24ll * 3600 * 1000)
+#define DEMAND_BUCKET_MS (DEMAND_DAY_MS / DEMAND_BUCKETS)
+
+/** @brief Days after which a bucket's old counts are dropped outright. */
+#define DEMAND_FORGET_DAYS 64
+
+static int64_t local_now_ms(const demand_model_t* model) {
+    return model->origin_local_ms + (int64_t)(clock_now_ms() - model->origin_clock_ms);
+}
+
+static int64_t wall_local_ms(void) {
+    struct timespec now;
+    struct tm local;
+    clock_gettime(CLOCK_REALTIME, &now);
+    localtime_r(&now.tv_sec, &local);
+    return ((int64_t)now.tv_sec + local.tm_gmtoff) * 1000 + now.tv_nsec / 1000000;
+}
+
+/** @brief Weight left on a bucket's counts after it was last updated on a day. */
+static float bucket_weight(const demand_model_t* model, int bucket, int64_t day) {
+    int64_t days = day - model->bucket_day[bucket];
+    if (days <= 0) return 1;
+    if (days >= DEMAND_FORGET_DAYS) return 0;
+
+    float weight = 1;
+    for (int64_t i = 0; i < days; i++) weight *= DEMAND_DAY_DECAY;
+    return weight;
+}
+
+/** @brief Brings a bucket's counts forward to a day. */
+static void age_bucket(demand_model_t* model, int bucket, int64_t day) {
+    if (day <= model->bucket_day[bucket]) return;
+
+    float weight = bucket_weight(model, bucket, day);
+    for (int floor = 0; floor < N_FLOORS_MAX; floor++) {
+        model->counts[bucket][floor] *= weight;
+    }
+    model->bucket_day[bucket] = day;
+}
+
+static bool load(demand_model_t* model, const char* path) {
+    FILE* file = fopen(path, "rb");
+    if (file == NULL) return true;
+
+    demand_file_header_t header;
+    bool ok = fread(&header, sizeof(header), 1, file) == 1 &&
+              memcmp(header.magic, DEMAND_FILE_MAGIC, sizeof(header.magic)) == 0 &&
+              header.version == DEMAND_FILE_VERSION &&
+              header.buckets == DEMAND_BUCKETS && header.floors == (uint32_t)model->n_floors &&
+              fread(model->bucket_day, sizeof(model->bucket_day), 1, file) == 1;
+    for (int bucket = 0; ok && bucket < DEMAND_BUCKETS; bucket++) {
+        ok = fread(model->counts[bucket], sizeof(float), model->n_floors, file) ==
+             (size_t)model->n_floors;
+    }
+    fclose(file);
+
+    if (!ok) {
+        memset(model->counts, 0, sizeof(model->counts));
+        memset(model->bucket_day, 0, sizeof(model->bucket_day));
+    }
+    return ok;
+}
+
+static bool save(const demand_model_t* model, const char* path) {
+    char tmp_path[PATH_MAX];
+    snprintf(tmp_path, sizeof(tmp_path), "%s.tmp", path);
+
+    FILE* file = fopen(tmp_path, "wb");
+    if (file == NULL) return false;
+
+    demand_file_header_t header = {
+        .magic = DEMAND_FILE_MAGIC,
+        .version = DEMAND_FILE_VERSION,
+        .buckets = DEMAND_BUCKETS,
+        .floors = (uint32_t)model->n_floors,
+    };
+    fwrite(&header, sizeof(header), 1, file);
+    fwrite(model->bucket_day, sizeof(model->bucket_day), 1, file);
+    for (int bucket = 0; bucket < DEMAND_BUCKETS; bucket++) {
+        fwrite(model->counts[bucket], sizeof(float), model->n_floors, file);
+    }
+
+    bool ok = !ferror(file);
+    ok = fclose(file) == 0 && ok;
+    return ok && rename(tmp_path, path) == 0;
+}
+
+static void save_if_due(demand_model_t* model, bool force) {
+    if (!model->persist || !model->dirty) return;
+    if (!force && clock_now_ms() - model->last_save_ms < DEMAND_SAVE_PERIOD_MS) return;
+
+    if (save(model, model->path)) {
+        model->dirty = false;
+    } else {
+        printf("WARNING: Failed to save demand model to %s\n", model->path);
+    }
+    model->last_save_ms = clock_now_ms();
+}
+
+bool demand_model_init(demand_model_t* model, const building_t* building, const char* path,
+                       int64_t local_ms) {
+    model->n_floors = building->n_floors;
+    memset(model->counts, 0, sizeof(model->counts));
+    memset(model->bucket_day, 0, sizeof(model->bucket_day));
+    for (int car = 0; car < N_CARS_MAX; car++) model->claims[car] = -1;
+
+    model->origin_clock_ms = clock_now_ms();
+    model->origin_local_ms = local_ms == DEMAND_WALL_CLOCK ? wall_local_ms() : local_ms;
+    model->last_save_ms = model->origin_clock_ms;
+    model->dirty = false;
+    model->active = true;
+
+    model->persist = path != NULL;
+    if (!model->persist) return true;
+    snprintf(model->path, sizeof(model->path), "%s", path);
+    return load(model, path);
+}
+
+bool demand_model_load(demand_model_t* model, const building_t* building, const char* path,
+                       int64_t local_ms) {
+    demand_model_init(model, building, NULL, local_ms);
+    FILE* file = fopen(path, "rb");
+    if (file == NULL) return false;
+    fclose(file);
+    return load(model, path);
+}
+
+bool demand_model_save_as(const demand_model_t* model, const char* path) {
+    return save(model, path);
+}
+
+void demand_model_shutdown(demand_model_t* model) {
+    if (!model->active) return;
+    save_if_due(model, true);
+    model->active = false;
+}
+
+void demand_model_record_call(demand_model_t* model, int floor) {
+    if (!model->active || floor < 0 || floor >= model->n_floors) return;
+
+    int64_t now = local_now_ms(model);
+    int bucket = (int)((now % DEMAND_DAY_MS) / DEMAND_BUCKET_MS);
+    age_bucket(model, bucket, now / DEMAND_DAY_MS);
+    model->counts[bucket][floor] += 1;
+    model->dirty = true;
+}
+
+int demand_model_parking_floor(demand_model_t* model, int car, int floor) {
+    if (!model->active || car < 0 || car >= N_CARS_MAX) return floor;
+    save_if_due(model, false);
+
+    int64_t now = local_now_ms(model);
+    int64_t day = now / DEMAND_DAY_MS;
+    int bucket = (int)((now % DEMAND_DAY_MS) / DEMAND_BUCKET_MS);
+    int next = (bucket + 1) % DEMAND_BUCKETS;
+
+    // Weighed as if aged to today, without touching the stored counts
+    float bucket_decay = bucket_weight(model, bucket, day);
+    float next_decay = bucket_weight(model, next, day);
+
+    float weight[N_FLOORS_MAX];
+    float total = 0;
+    int covered[N_FLOORS_MAX];
+    for (int f = 0; f < model->n_floors; f++) {
+        weight[f] = model->counts[bucket][f] * bucket_decay + model->counts[next][f] * next_decay;
+        total += weight[f];
+
+        // Distance from the nearest other parked car, which would take the call
+        covered[f] = model->n_floors;
+        for (int other = 0; other < N_CARS_MAX; other++) {
+            int claim = model->claims[other];
+            if (other != car && claim != -1 && abs(claim - f) < covered[f]) {
+                covered[f] = abs(claim - f);
+            }
+        }
+    }
+
+    int best = floor;
+    if (total > 0) {
+        float best_cost = -1;
+        for (int x = 0; x < model->n_floors; x++) {
+            float cost = 0;
+            for (int f = 0; f < model->n_floors; f++) {
+                int distance = abs(x - f);
+                cost += weight[f] * (float)(distance < covered[f] ? distance : covered[f]);
+            }
+            // Ties go to the floor nearest the car, so it moves no further than it must
+            if (best_cost < 0 || cost < best_cost ||
+                (cost == best_cost && abs(x - floor) < abs(best - floor))) {
+                best_cost = cost;
+                best = x;
+            }
+        }
+    }
+
+    model->claims[car] = best;
+    return best;
+}
+
+void demand_model_release(demand_model_t* model, int car) {
+    if (car >= 0 && car < N_CARS_MAX) model->claims[car] = -1;
+}
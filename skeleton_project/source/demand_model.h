@@ -0,0 +1,146 @@
+/**
+ * @file demand_model.h
+ * @brief Learned hall-call demand and the idle parking policy built on it.
+ *
+ * Counts hall calls per floor and time-of-day bucket as they are
+ * accepted. Counts decay from one day to the next, so the model follows
+ * changing habits. A car that has been idle for DEMAND_PARK_DELAY_MS
+ * moves to the floor that minimizes the expected travel to the next
+ * call, given the floors other idle cars are parked at. The model is
+ * saved to a file and loaded again on the next start.
+ */
+
+#ifndef DEMAND_MODEL_H
+#define DEMAND_MODEL_H
+
+#include <stdbool.h>
+#include <stdint.h>
+#include "elevator_types.h"
+
+/** @brief Default model file, relative to the working directory. */
+#define DEMAND_DEFAULT_PATH "elevator.demand"
+
+/** @brief Appended to an elevio trace's path for the model the traced run started with. */
+#define DEMAND_TRACE_SUFFIX ".demand"
+
+/** @brief Number of time-of-day buckets; each spans half an hour. */
+#define DEMAND_BUCKETS 48
+
+/** @brief Weight left on a bucket's counts after each day. */
+#define DEMAND_DAY_DECAY 0.8f
+
+/** @brief How long a car stays idle without orders before it parks. */
+#define DEMAND_PARK_DELAY_MS 10000
+
+/** @brief Shortest time between two saves of the model. */
+#define DEMAND_SAVE_PERIOD_MS 60000
+
+/** @brief Passed to demand_model_init() to take the time of day from the system clock. */
+#define DEMAND_WALL_CLOCK INT64_MIN
+
+/**
+ * @brief Header at the start of a model file, followed by DEMAND_BUCKETS
+ *        day numbers (int64_t) and DEMAND_BUCKETS rows of floors counts (float).
+ */
+typedef struct {
+    char magic[4];
+    uint32_t version;
+    uint32_t buckets;
+    uint32_t floors;
+} demand_file_header_t;
+
+#define DEMAND_FILE_MAGIC "EDMD"
+#define DEMAND_FILE_VERSION 1
+
+/**
+ * @brief Hall-call demand of one group of cars, and where its idle cars park.
+ *
+ * A zeroed model is inactive: it learns nothing and its cars stay where
+ * they are.
+ */
+typedef struct {
+    bool active;
+    bool persist;
+    char path[256];
+
+    /** @brief Floors of the group's building. */
+    int n_floors;
+
+    /** @brief Local time at origin_clock_ms of the clock module. */
+    int64_t origin_local_ms;
+    uint64_t origin_clock_ms;
+
+    float counts[DEMAND_BUCKETS][N_FLOORS_MAX];
+    int64_t bucket_day[DEMAND_BUCKETS];
+
+    /** @brief Floor each car is parked at or heading for, or -1. */
+    int claims[N_CARS_MAX];
+
+    bool dirty;
+    uint64_t last_save_ms;
+} demand_model_t;
+
+/**
+ * @brief Resets a model, loads it from a file and starts parking.
+ *
+ * A missing file is not an error; the model then starts empty.
+ *
+ * @param model The model.
+ * @param building The building of the model's group, as read from the hardware.
+ * @param path The model file, or NULL to neither load nor save.
+ * @param local_ms Local time in milliseconds since the epoch at this
+ *                 moment of the clock module, or DEMAND_WALL_CLOCK.
+ * @return false if the file exists but could not be used.
+ */
+bool demand_model_init(demand_model_t* model, const building_t* building, const char* path,
+                       int64_t local_ms);
+
+/**
+ * @brief Like demand_model_init(), but never writes the file back, and a
+ *        missing file is an error.
+ *
+ * For replaying a run from the model it started with.
+ */
+bool demand_model_load(demand_model_t* model, const building_t* building, const char* path,
+                       int64_t local_ms);
+
+/**
+ * @brief Writes a model to a file other than its own.
+ *
+ * @return true on success, false otherwise.
+ */
+bool demand_model_save_as(const demand_model_t* model, const char* path);
+
+/**
+ * @brief Saves a model if it changed and stops parking.
+ */
+void demand_model_shutdown(demand_model_t* model);
+
+/**
+ * @brief Records a newly accepted hall call.
+ *
+ * @param model The model of the group the call was made in.
+ * @param floor The floor the call was made at.
+ */
+void demand_model_record_call(demand_model_t* model, int floor);
+
+/**
+ * @brief Chooses where an idle car should park and claims that floor for it.
+ *
+ * Also saves the model if it changed and DEMAND_SAVE_PERIOD_MS passed.
+ * Without an initialized model, or before any call was seen, the car
+ * stays where it is.
+ *
+ * @param model The model of the car's group.
+ * @param car The car index.
+ * @param floor The car's floor.
+ * @return The floor to park at.
+ */
+int demand_model_parking_floor(demand_model_t* model, int car, int floor);
+
+/**
+ * @brief Gives up a car's parking claim once it takes on orders.
+ */
+void demand_model_release(demand_model_t* model, int car);
+
+#endif
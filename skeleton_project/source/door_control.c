@@ -6,91 +6,95 @@
  * The door stays open for a configurable duration before closing.
  */
 
-#include "elevator_types.h"
+#include "door_control.h"
 #include <stdbool.h>
-#include <time.h>
-
-// Forward declaration
-void hardware_interface_set_door_light(bool on);
-
-/** @brief Current door state. */
-static DoorState door_state = DOOR_CLOSED;
-
-/** @brief Timestamp when door was opened. */
-static time_t door_open_time = 0;
-
-/** @brief Flag to keep door open indefinitely (emergency stop). */
-static bool keep_open = false;
-
-/** @brief Duration in seconds the door stays open. */
-#define DOOR_OPEN_DURATION 3
 
 /**
- * @brief Initializes the door control module.
+ * @brief Initializes a door.
  *
  * Sets door to closed state and turns off the door light.
+ *
+ * @param door The door to initialize.
+ * @param hw Hardware driving the door light.
+ * @param wheel Timer wheel for the door timer.
+ * @param fsm FSM that receives EVENT_DOOR_TIMEOUT.
  */
-void door_control_init(void) {
-    door_state = DOOR_CLOSED;
-    door_open_time = 0;
-    keep_open = false;
-    hardware_interface_set_door_light(false);
+void door_control_init(door_t* door, hardware_t* hw, timer_wheel_t* wheel, fsm_t* fsm) {
+    *door = (door_t){
+        .state = DOOR_CLOSED,
+        .keep_open = false,
+        .wheel = wheel,
+        .fsm = fsm,
+        .hw = hw,
+    };
+    hardware_interface_set_door_light(hw, false);
 }
 
 /**
  * @brief Opens the door.
  *
- * Sets state to open, starts the timer, and turns on the door light.
+ * Sets state to open, arms the door timer, and turns on the door light.
+ * EVENT_DOOR_TIMEOUT is dispatched when the timer expires.
+ *
+ * @param door The door.
  */
-void door_control_open_door(void) {
-    door_state = DOOR_OPEN;
-    door_open_time = time(NULL);
-    keep_open = false;
-    hardware_interface_set_door_light(true);
+void door_control_open_door(door_t* door) {
+    door->state = DOOR_OPEN;
+    door->keep_open = false;
+    timer_wheel_arm(door->wheel, &door->timer, DOOR_OPEN_DURATION_MS, door->fsm, EVENT_DOOR_TIMEOUT);
+    hardware_interface_set_door_light(door->hw, true);
 }
 
 /**
  * @brief Closes the door.
  *
  * Sets state to closed and turns off the door light.
+ *
+ * @param door The door.
  */
-void door_control_close_door(void) {
-    door_state = DOOR_CLOSED;
-    keep_open = false;
-    hardware_interface_set_door_light(false);
+void door_control_close_door(door_t* door) {
+    door->state = DOOR_CLOSED;
+    door->keep_open = false;
+    timer_wheel_cancel(door->wheel, &door->timer);
+    hardware_interface_set_door_light(door->hw, false);
 }
 
 /**
  * @brief Resets the door open timer.
  *
  * Called when obstruction is detected to extend door open time.
+ *
+ * @param door The door.
  */
-void door_control_reset_timer(void) {
-    door_open_time = time(NULL);
+void door_control_reset_timer(door_t* door) {
+    if (door->state == DOOR_OPEN && !door->keep_open) {
+        timer_wheel_arm(door->wheel, &door->timer, DOOR_OPEN_DURATION_MS, door->fsm, EVENT_DOOR_TIMEOUT);
+    }
 }
 
 /**
  * @brief Keeps the door open indefinitely.
  *
  * Used during emergency stop to prevent door from closing.
+ *
+ * @param door The door.
  */
-void door_control_keep_open(void) {
-    keep_open = true;
+void door_control_keep_open(door_t* door) {
+    door->keep_open = true;
+    timer_wheel_cancel(door->wheel, &door->timer);
 }
 
 /**
  * @brief Updates door state based on timer.
  *
- * Checks if the door open duration has elapsed.
+ * Checks if the door timer has expired.
  *
+ * @param door The door.
  * @return DOOR_CLOSED if timer expired, otherwise current door state.
  */
-DoorState door_control_update(void) {
-    if (door_state == DOOR_OPEN && !keep_open) {
-        time_t now = time(NULL);
-        if (difftime(now, door_open_time) >= DOOR_OPEN_DURATION) {
-            return DOOR_CLOSED;
-        }
+DoorState door_control_update(const door_t* door) {
+    if (door->state == DOOR_OPEN && !door->keep_open && !timer_wheel_is_armed(&door->timer)) {
+        return DOOR_CLOSED;
     }
-    return door_state;
+    return door->state;
 }
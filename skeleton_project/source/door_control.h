@@ -0,0 +1,51 @@
+/**
+ * @file door_control.h
+ * @brief Door control module for the elevator.
+ *
+ * Each car owns a door_t. Its timer lives on the timer wheel of the
+ * thread running the car and delivers EVENT_DOOR_TIMEOUT to the car's FSM.
+ */
+
+#ifndef DOOR_CONTROL_H
+#define DOOR_CONTROL_H
+
+#include <stdbool.h>
+#include "elevator_types.h"
+#include "fsm.h"
+#include "hardware_interface.h"
+#include "timer_wheel.h"
+
+/** @brief Duration in milliseconds the door stays open. */
+#define DOOR_OPEN_DURATION_MS 3000
+
+/**
+ * @brief Door state of one car.
+ */
+typedef struct {
+    /** @brief Current door state. */
+    DoorState state;
+
+    /** @brief Flag to keep door open indefinitely (emergency stop). */
+    bool keep_open;
+
+    /** @brief Door open timer. */
+    wheel_timer_t timer;
+
+    /** @brief Wheel the timer runs on. */
+    timer_wheel_t* wheel;
+
+    /** @brief FSM that receives EVENT_DOOR_TIMEOUT. */
+    fsm_t* fsm;
+
+    /** @brief Hardware driving the door light. */
+    hardware_t* hw;
+} door_t;
+
+void door_control_init(door_t* door, hardware_t* hw, timer_wheel_t* wheel, fsm_t* fsm);
+void door_control_open_door(door_t* door);
+void door_control_close_door(door_t* door);
+void door_control_reset_timer(door_t* door);
+void door_control_keep_open(door_t* door);
+DoorState door_control_update(const door_t* door);
+
+#endif
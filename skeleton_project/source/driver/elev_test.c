@@ -7,6 +7,6 @@ int main(void){
         elevio_motorDirection(DIRN_DOWN);
         while(elevio_floorSensor() != 0){}
         elevio_motorDirection(DIRN_UP);
-        while(elevio_floorSensor() != 3){}
+        while(elevio_floorSensor() != elevio_numFloors() - 1){}
     }
 }
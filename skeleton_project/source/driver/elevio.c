@@ -1,44 +1,279 @@
 #include <assert.h>
+#include <errno.h>
+#include <fcntl.h>
 #include <stdlib.h>
 #include <sys/types.h>
 #include <sys/socket.h>
 #include <netdb.h>
+#include <netinet/in.h>
+#include <netinet/tcp.h>
+#include <poll.h>
 #include <stdio.h>
 #include <pthread.h>
+#include <string.h>
+#include <time.h>
+#include <unistd.h>
 
 #include "elevio.h"
+#include "elevio_trace.h"
 #include "con_load.h"
 
-static int sockfd;
+// Selected car; per thread, so threads driving different cars do not race
+static __thread int sockfd;
+static __thread int selectedCar;
+static int sockfds[ELEVIO_MAX_CARS];
 static pthread_mutex_t sockmtx;
+static int numFloors = 4;
+static int numCars = 1;
+static int subscribeEnabled = 0;
 
-void elevio_init(void){
-    char ip[16] = "localhost";
-    char port[8] = "15657";
-    con_load("source/driver/elevio.con",
-        con_val("com_ip",   ip,   "%s")
-        con_val("com_port", port, "%s")
-    )
-    
-    pthread_mutex_init(&sockmtx, NULL);
-    
-    sockfd = socket(AF_INET, SOCK_STREAM, 0);
-    assert(sockfd != -1 && "Unable to set up socket");
-    
+// Server address, and the bound on connecting and on every blocking call
+static char serverIp[64] = "localhost";
+static int serverPort = 15657;
+static int timeoutMs = 500;
+
+// Car motion, as travelTimeBetweenFloors_ms and travelTimePassingFloor_ms
+// in simulator.con
+static int floorTravelMs = 2000;
+static int floorPassingMs = 500;
+
+// Bytes of a partly received event record, per car
+static unsigned char eventPartial[ELEVIO_MAX_CARS][4];
+static int eventPartialLen[ELEVIO_MAX_CARS];
+
+// Capture of every request and reply, if elevio.con names a trace file
+static FILE* traceFile;
+static char tracePath[64];
+static uint64_t traceStartNs;
+static char traceScheduler[ELEVIO_TRACE_SCHEDULER_LEN];
+
+static void elevio_buildPollQuery(void);
+
+static uint64_t elevio_monotonicNs(void){
+    struct timespec ts;
+    clock_gettime(CLOCK_MONOTONIC, &ts);
+    return (uint64_t)ts.tv_sec*1000000000u + (uint64_t)ts.tv_nsec;
+}
+
+static void elevio_traceOpen(const char* path){
+    traceFile = fopen(path, "wb");
+    if(!traceFile){
+        printf("Unable to open trace file %s\n", path);
+        return;
+    }
+    traceStartNs = elevio_monotonicNs()/1000000*1000000;
+
+    struct timespec now;
+    struct tm local;
+    clock_gettime(CLOCK_REALTIME, &now);
+    localtime_r(&now.tv_sec, &local);
+
+    ElevioTraceHeader header = {
+        .magic      = ELEVIO_TRACE_MAGIC,
+        .version    = ELEVIO_TRACE_VERSION,
+        .recordSize = sizeof(ElevioTraceRecord),
+        .numFloors  = numFloors,
+        .numCars    = numCars,
+        .startNs    = traceStartNs,
+        .startLocalMs = ((int64_t)now.tv_sec + local.tm_gmtoff)*1000 + now.tv_nsec/1000000,
+        .floorTravelMs  = floorTravelMs,
+        .floorPassingMs = floorPassingMs,
+    };
+    memcpy(header.scheduler, traceScheduler, sizeof(header.scheduler));
+    fwrite(&header, sizeof(header), 1, traceFile);
+}
+
+// Appends the 4-byte messages in buf to the trace, tagged with the car
+static void elevio_traceAs(int car, const void* buf, int len, int reply){
+    if(!traceFile) return;
+
+    ElevioTraceRecord r = {
+        .timeMs = (uint32_t)((elevio_monotonicNs() - traceStartNs)/1000000),
+    };
+    for(int i = 0; i + 4 <= len; i += 4){
+        memcpy(r.bytes, (const char*)buf + i, 4);
+        r.bytes[0] = (r.bytes[0] & ELEVIO_TRACE_OP_MASK)
+                   | (car << ELEVIO_TRACE_CAR_SHIFT)
+                   | (reply ? ELEVIO_TRACE_REPLY : 0);
+        fwrite(&r, sizeof(r), 1, traceFile);
+    }
+}
+
+static void elevio_trace(const void* buf, int len, int reply){
+    elevio_traceAs(selectedCar, buf, len, reply);
+}
+
+void elevio_traceTraffic(int car, const void* buf, int len, int reply){
+    if(!traceFile) return;
+    elevio_traceAs(car, buf, len, reply);
+    fflush(traceFile);
+}
+
+static void elevio_send(const void* buf, int len){
+    // A dead server shows up as a failed reply, not as SIGPIPE
+    send(sockfd, buf, len, MSG_NOSIGNAL);
+    elevio_trace(buf, len, 0);
+}
+
+static ssize_t elevio_recv(void* buf, int len, int flags){
+    ssize_t got = recv(sockfd, buf, len, flags);
+    elevio_trace(buf, got > 0 ? got : 0, 1);
+    return got;
+}
+
+// Connects to the server of a car within timeoutMs. Returns the socket, or
+// -1 with the reason printed.
+static int elevio_connect(int car){
     struct addrinfo hints = {
         .ai_family      = AF_INET, 
         .ai_socktype    = SOCK_STREAM, 
         .ai_protocol    = IPPROTO_TCP,
     };
+    char portstr[8];
+    snprintf(portstr, sizeof(portstr), "%d", serverPort + car);
     struct addrinfo* res;
-    getaddrinfo(ip, port, &hints, &res);
-    
-    int fail = connect(sockfd, res->ai_addr, res->ai_addrlen);
-    assert(fail == 0 && "Unable to connect to elevator server");
-    
+    int err = getaddrinfo(serverIp, portstr, &hints, &res);
+    if(err != 0){
+        printf("Unable to resolve %s: %s\n", serverIp, gai_strerror(err));
+        return -1;
+    }
+
+    int fd = socket(AF_INET, SOCK_STREAM | SOCK_NONBLOCK | SOCK_CLOEXEC, 0);
+    if(fd == -1){
+        freeaddrinfo(res);
+        return -1;
+    }
+
+    int fail = connect(fd, res->ai_addr, res->ai_addrlen);
     freeaddrinfo(res);
+    if(fail && errno == EINPROGRESS){
+        struct pollfd pfd = { .fd = fd, .events = POLLOUT };
+        socklen_t len = sizeof(err);
+        fail = poll(&pfd, 1, timeoutMs) != 1
+            || getsockopt(fd, SOL_SOCKET, SO_ERROR, &err, &len) != 0
+            || err != 0;
+    }
+    if(fail){
+        printf("Unable to connect to elevator server on %s:%d\n", serverIp, serverPort + car);
+        close(fd);
+        return -1;
+    }
+
+    // Blocking again, but no call waits longer than timeoutMs
+    fcntl(fd, F_SETFL, fcntl(fd, F_GETFL) & ~O_NONBLOCK);
+    struct timeval tv = { timeoutMs/1000, (timeoutMs%1000)*1000 };
+    setsockopt(fd, SOL_SOCKET, SO_RCVTIMEO, &tv, sizeof(tv));
+    setsockopt(fd, SOL_SOCKET, SO_SNDTIMEO, &tv, sizeof(tv));
+
+    // Writes are batched by the caller; Nagle would only delay the
+    // poll query that follows a batch until the batch is acked
+    int one = 1;
+    setsockopt(fd, IPPROTO_TCP, TCP_NODELAY, &one, sizeof(one));
+
+    // A subscribed car may be silent for long, so probe the link to notice
+    // a server that vanished without closing the connection
+    int idle = 1, interval = 1, count = 3;
+    setsockopt(fd, SOL_SOCKET, SO_KEEPALIVE, &one, sizeof(one));
+    setsockopt(fd, IPPROTO_TCP, TCP_KEEPIDLE, &idle, sizeof(idle));
+    setsockopt(fd, IPPROTO_TCP, TCP_KEEPINTVL, &interval, sizeof(interval));
+    setsockopt(fd, IPPROTO_TCP, TCP_KEEPCNT, &count, sizeof(count));
+    return fd;
+}
+
+int elevio_reconnect(void){
+    elevio_disconnect();
+
+    int fd = elevio_connect(selectedCar);
+    if(fd == -1){
+        return 0;
+    }
+    sockfd = sockfds[selectedCar] = fd;
+    eventPartialLen[selectedCar] = 0;
+    pthread_mutex_lock(&sockmtx);
+    elevio_send((char[4]){0}, 4);
+    pthread_mutex_unlock(&sockmtx);
+    return 1;
+}
+
+void elevio_disconnect(void){
+    if(sockfds[selectedCar] != -1){
+        close(sockfds[selectedCar]);
+    }
+    sockfd = sockfds[selectedCar] = -1;
+}
+
+int elevio_timeoutMs(void){
+    return timeoutMs;
+}
+
+int elevio_floorTravelMs(void){
+    return floorTravelMs;
+}
+
+int elevio_floorPassingMs(void){
+    return floorPassingMs;
+}
+
+const char* elevio_tracePath(void){
+    return traceFile ? tracePath : NULL;
+}
+
+void elevio_traceSetScheduler(const char* name){
+    // NUL-padded, without a terminator if the name fills the field
+    memset(traceScheduler, 0, sizeof(traceScheduler));
+    memcpy(traceScheduler, name, strnlen(name, sizeof(traceScheduler)));
+}
+
+int elevio_init(void){
+    con_load("source/driver/elevio.con",
+        con_val("com_ip",   serverIp,   "%63s")
+        con_val("com_port", &serverPort, "%d")
+        con_val("num_floors", &numFloors, "%d")
+        con_val("num_cars", &numCars, "%d")
+        con_val("trace_file", tracePath, "%63s")
+        con_val("subscribe", &subscribeEnabled, "%d")
+        con_val("timeout_ms", &timeoutMs, "%d")
+        con_val("floor_travel_ms", &floorTravelMs, "%d")
+        con_val("floor_passing_ms", &floorPassingMs, "%d")
+    )
+    assert(numFloors >= 2 && numFloors <= ELEVIO_MAX_FLOORS && "Invalid num_floors");
+    assert(numCars >= 1 && numCars <= ELEVIO_MAX_CARS && "Invalid num_cars");
+    assert(floorPassingMs > 0 && floorPassingMs < floorTravelMs && "Invalid floor_travel_ms or floor_passing_ms");
+    elevio_buildPollQuery();
+    if(tracePath[0]){
+        elevio_traceOpen(tracePath);
+    }
+    
+    pthread_mutex_init(&sockmtx, NULL);
     
-    send(sockfd, (char[4]){0}, 4, 0);
+    // Car i is served by the elevator server on com_port + i
+    int connected = 1;
+    for(int car = 0; car < numCars; car++){
+        sockfds[car] = -1;
+        selectedCar = car;
+        connected &= elevio_reconnect();
+    }
+    sockfd = sockfds[0];
+    selectedCar = 0;
+    return connected;
+}
+
+
+void elevio_selectCar(int car){
+    assert(car >= 0);
+    assert(car < numCars);
+    sockfd = sockfds[car];
+    selectedCar = car;
+}
+
+
+int elevio_numCars(void){
+    return numCars;
+}
+
+
+int elevio_numFloors(void){
+    return numFloors;
 }
 
 
@@ -46,44 +281,90 @@ void elevio_init(void){
 
 void elevio_motorDirection(MotorDirection dirn){
     pthread_mutex_lock(&sockmtx);
-    send(sockfd, (char[4]){1, dirn}, 4, 0);
+    elevio_send((char[4]){1, dirn}, 4);
     pthread_mutex_unlock(&sockmtx);
 }
 
 
 void elevio_buttonLamp(int floor, ButtonType button, int value){
     assert(floor >= 0);
-    assert(floor < N_FLOORS);
+    assert(floor < numFloors);
     assert(button >= 0);
     assert(button < N_BUTTONS);
 
     pthread_mutex_lock(&sockmtx);
-    send(sockfd, (char[4]){2, button, floor, value}, 4, 0);
+    elevio_send((char[4]){2, button, floor, value}, 4);
     pthread_mutex_unlock(&sockmtx);
 }
 
 
 void elevio_floorIndicator(int floor){
     assert(floor >= 0);
-    assert(floor < N_FLOORS);
+    assert(floor < numFloors);
 
     pthread_mutex_lock(&sockmtx);
-    send(sockfd, (char[4]){3, floor}, 4, 0);
+    elevio_send((char[4]){3, floor}, 4);
     pthread_mutex_unlock(&sockmtx);
 }
 
 
 void elevio_doorOpenLamp(int value){
     pthread_mutex_lock(&sockmtx);
-    send(sockfd, (char[4]){4, value}, 4, 0);
+    elevio_send((char[4]){4, value}, 4);
     pthread_mutex_unlock(&sockmtx);
 }
 
 
 void elevio_stopLamp(int value){
     pthread_mutex_lock(&sockmtx);
-    send(sockfd, (char[4]){5, value}, 4, 0);
+    elevio_send((char[4]){5, value}, 4);
+    pthread_mutex_unlock(&sockmtx);
+}
+
+
+
+ElevioOutput elevio_motorDirectionOutput(MotorDirection dirn){
+    return (ElevioOutput){{1, dirn}};
+}
+
+
+// The encoders check against the capacity rather than numFloors, so they
+// can serve backends other than the TCP connection
+ElevioOutput elevio_buttonLampOutput(int floor, ButtonType button, int value){
+    assert(floor >= 0);
+    assert(floor < ELEVIO_MAX_FLOORS);
+    assert(button >= 0);
+    assert(button < N_BUTTONS);
+    return (ElevioOutput){{2, button, floor, value}};
+}
+
+
+ElevioOutput elevio_floorIndicatorOutput(int floor){
+    assert(floor >= 0);
+    assert(floor < ELEVIO_MAX_FLOORS);
+    return (ElevioOutput){{3, floor}};
+}
+
+
+ElevioOutput elevio_doorOpenLampOutput(int value){
+    return (ElevioOutput){{4, value}};
+}
+
+
+ElevioOutput elevio_stopLampOutput(int value){
+    return (ElevioOutput){{5, value}};
+}
+
+
+void elevio_writeOutputs(const ElevioOutput* outputs, int count){
+    pthread_mutex_lock(&sockmtx);
+    elevio_send(outputs, count*sizeof(ElevioOutput));
     pthread_mutex_unlock(&sockmtx);
+
+    // A subscribed car may not be read again for a long time
+    if(traceFile){
+        fflush(traceFile);
+    }
 }
 
 
@@ -91,9 +372,9 @@ void elevio_stopLamp(int value){
 
 int elevio_callButton(int floor, ButtonType button){
     pthread_mutex_lock(&sockmtx);
-    send(sockfd, (char[4]){6, button, floor}, 4, 0);
-    char buf[4];
-    recv(sockfd, buf, 4, 0);
+    elevio_send((char[4]){6, button, floor}, 4);
+    char buf[4] = {0};
+    elevio_recv(buf, 4, 0);
     pthread_mutex_unlock(&sockmtx);
     return buf[1];
 }
@@ -101,9 +382,9 @@ int elevio_callButton(int floor, ButtonType button){
 
 int elevio_floorSensor(void){
     pthread_mutex_lock(&sockmtx);
-    send(sockfd, (char[4]){7}, 4, 0);
-    char buf[4];
-    recv(sockfd, buf, 4, 0);
+    elevio_send((char[4]){7}, 4);
+    char buf[4] = {0};
+    elevio_recv(buf, 4, 0);
     pthread_mutex_unlock(&sockmtx);
     return buf[1] ? buf[2] : -1;
 }
@@ -111,9 +392,9 @@ int elevio_floorSensor(void){
 
 int elevio_stopButton(void){
     pthread_mutex_lock(&sockmtx);
-    send(sockfd, (char[4]){8}, 4, 0);
-    char buf[4];
-    recv(sockfd, buf, 4, 0);
+    elevio_send((char[4]){8}, 4);
+    char buf[4] = {0};
+    elevio_recv(buf, 4, 0);
     pthread_mutex_unlock(&sockmtx);
     return buf[1];
 }
@@ -121,9 +402,199 @@ int elevio_stopButton(void){
 
 int elevio_obstruction(void){
     pthread_mutex_lock(&sockmtx);
-    send(sockfd, (char[4]){9}, 4, 0);
-    char buf[4];
-    recv(sockfd, buf, 4, 0);
+    elevio_send((char[4]){9}, 4);
+    char buf[4] = {0};
+    elevio_recv(buf, 4, 0);
     pthread_mutex_unlock(&sockmtx);
     return buf[1];
 }
+
+
+
+
+#define MAX_POLL_QUERIES (ELEVIO_MAX_FLOORS*N_BUTTONS - 2 + 3)
+
+// The poll batch only depends on the floor count, so it is built once.
+// pollIndex maps each button to its reply slot, or -1 if it does not exist.
+static char pollQuery[MAX_POLL_QUERIES*4];
+static int pollQueryLen;
+static int pollIndex[ELEVIO_MAX_FLOORS][N_BUTTONS];
+
+static int elevio_buttonExists(int floor, ButtonType button){
+    return !(button == BUTTON_HALL_UP && floor == numFloors - 1)
+        && !(button == BUTTON_HALL_DOWN && floor == 0);
+}
+
+static void elevio_buildPollQuery(void){
+    int n = 0;
+    memset(pollQuery, 0, sizeof(pollQuery));
+
+    for(int f = 0; f < numFloors; f++){
+        for(int b = 0; b < N_BUTTONS; b++){
+            if(elevio_buttonExists(f, b)){
+                pollIndex[f][b] = n;
+                pollQuery[n*4 + 0] = 6;
+                pollQuery[n*4 + 1] = b;
+                pollQuery[n*4 + 2] = f;
+                n++;
+            } else {
+                pollIndex[f][b] = -1;
+            }
+        }
+    }
+    pollQuery[n++*4] = 7;
+    pollQuery[n++*4] = 8;
+    pollQuery[n++*4] = 9;
+    pollQueryLen = n*4;
+}
+
+int elevio_socket(void){
+    return sockfd;
+}
+
+const char* elevio_pollQuery(int* len){
+    *len = pollQueryLen;
+    return pollQuery;
+}
+
+static void elevio_sendPollQuery(void){
+    elevio_send(pollQuery, pollQueryLen);
+}
+
+void elevio_decodePollReply(const char* reply, ElevioInputs* inputs){
+
+    for(int f = 0; f < numFloors; f++){
+        for(int b = 0; b < N_BUTTONS; b++){
+            int i = pollIndex[f][b];
+            inputs->callButton[f][b] = i >= 0 ? reply[i*4 + 1] : 0;
+        }
+    }
+    int n = pollQueryLen/4 - 3;
+    inputs->floorSensor = reply[n*4 + 1] ? reply[n*4 + 2] : -1;
+    n++;
+    inputs->stopButton  = reply[n++*4 + 1];
+    inputs->obstruction = reply[n++*4 + 1];
+}
+
+static int elevio_recvPollReply(ElevioInputs* inputs){
+    char reply[MAX_POLL_QUERIES*4];
+
+    ssize_t got = elevio_recv(reply, pollQueryLen, MSG_WAITALL);
+    if(traceFile){
+        fflush(traceFile);
+    }
+
+    int ok = got == pollQueryLen;
+    if(!ok){
+        memset(reply, 0, pollQueryLen);
+    }
+    elevio_decodePollReply(reply, inputs);
+    return ok;
+}
+
+int elevio_pollInputs(ElevioInputs* inputs){
+    pthread_mutex_lock(&sockmtx);
+    elevio_sendPollQuery();
+    int ok = elevio_recvPollReply(inputs);
+    pthread_mutex_unlock(&sockmtx);
+    return ok;
+}
+
+void elevio_pollInputsRequest(void){
+    pthread_mutex_lock(&sockmtx);
+    elevio_sendPollQuery();
+    pthread_mutex_unlock(&sockmtx);
+}
+
+int elevio_pollInputsCollect(ElevioInputs* inputs){
+    pthread_mutex_lock(&sockmtx);
+    int ok = elevio_recvPollReply(inputs);
+    pthread_mutex_unlock(&sockmtx);
+    return ok;
+}
+
+
+
+
+static const ElevioInputs restInputs = { .floorSensor = -1 };
+
+int elevio_subscribe(ElevioInputs* inputs, int ackTimeoutMs){
+    if(!subscribeEnabled) return 0;
+
+    pthread_mutex_lock(&sockmtx);
+    elevio_send((char[4]){ELEVIO_OP_SUBSCRIBE}, 4);
+
+    // A server without push mode ignores the request and never replies
+    int ok = 0;
+    struct pollfd pfd = { .fd = sockfd, .events = POLLIN };
+    char ack[4];
+    if(poll(&pfd, 1, ackTimeoutMs) > 0 && elevio_recv(ack, 4, MSG_WAITALL) == 4){
+        ok = ack[0] == ELEVIO_OP_SUBSCRIBE && ack[1] == 1;
+    }
+    pthread_mutex_unlock(&sockmtx);
+
+    if(ok){
+        *inputs = restInputs;
+        eventPartialLen[selectedCar] = 0;
+        return 1;
+    }
+
+    // A late acknowledgement, or events after it, would land in front of
+    // the poll replies; only a fresh connection is sure to carry neither
+    return elevio_reconnect() ? 0 : -1;
+}
+
+void elevio_applyEvent(ElevioInputs* inputs, const unsigned char record[4]){
+    int input = record[1];
+    int floor = record[2];
+    int value = record[3];
+    if(record[0] != ELEVIO_OP_EVENT || floor >= ELEVIO_MAX_FLOORS) return;
+
+    if(input < N_BUTTONS){
+        inputs->callButton[floor][input] = value;
+    } else if(input == ELEVIO_EVENT_FLOOR_SENSOR){
+        if(value){
+            inputs->floorSensor = floor;
+        } else if(inputs->floorSensor == floor){
+            inputs->floorSensor = -1;
+        }
+    } else if(input == ELEVIO_EVENT_STOP){
+        inputs->stopButton = value;
+    } else if(input == ELEVIO_EVENT_OBSTRUCTION){
+        inputs->obstruction = value;
+    }
+}
+
+int elevio_readEvents(ElevioInputs* inputs){
+    unsigned char* partial = eventPartial[selectedCar];
+    int* partialLen = &eventPartialLen[selectedCar];
+    unsigned char buf[256];
+    int applied = 0;
+
+    pthread_mutex_lock(&sockmtx);
+    while(1){
+        memcpy(buf, partial, *partialLen);
+        ssize_t got = recv(sockfd, buf + *partialLen, sizeof(buf) - *partialLen, MSG_DONTWAIT);
+        if(got == 0 || (got < 0 && errno != EAGAIN && errno != EWOULDBLOCK && errno != EINTR)){
+            applied = -1;
+            break;
+        }
+        if(got < 0) break;
+
+        int len = *partialLen + got;
+        int whole = len/4*4;
+        elevio_trace(buf, whole, 1);
+        for(int i = 0; i < whole; i += 4){
+            elevio_applyEvent(inputs, &buf[i]);
+            applied++;
+        }
+        *partialLen = len - whole;
+        memcpy(partial, buf + whole, *partialLen);
+    }
+    pthread_mutex_unlock(&sockmtx);
+
+    if(traceFile){
+        fflush(traceFile);
+    }
+    return applied;
+}
@@ -1,7 +1,9 @@
 #pragma once
 
 
-#define N_FLOORS 4
+// Capacity limit; the actual floor count is read from elevio.con
+#define ELEVIO_MAX_FLOORS 64
+#define ELEVIO_MAX_CARS 8
 
 typedef enum { 
     DIRN_DOWN   = -1,
@@ -19,7 +21,41 @@ typedef enum {
 } ButtonType;
 
 
-void elevio_init(void);
+// If elevio.con sets --trace_file, every request and reply is also appended
+// to that file; see elevio_trace.h for the format.
+//
+// Connecting and every blocking call give up after --timeout_ms from
+// elevio.con (500 by default), so a lost server shows up as a failed call.
+// Returns 1 if every car is connected; a car that is not has no socket and
+// needs elevio_reconnect.
+int elevio_init(void);
+int elevio_numFloors(void);
+
+// With num_cars > 1 in elevio.con, car i is served by the server on
+// com_port + i. All other calls act on the car selected by the calling thread
+// (car 0 in the thread that ran elevio_init).
+int elevio_numCars(void);
+void elevio_selectCar(int car);
+
+// Closes the selected car's connection, if any, and connects it anew.
+// Returns 1 on success; on failure the car is left without a socket.
+int elevio_reconnect(void);
+void elevio_disconnect(void);
+
+// The bound on connecting and on every blocking call, from elevio.con.
+int elevio_timeoutMs(void);
+
+// How long a car takes from one floor to the next, and how long the floor
+// sensor stays on as it passes a floor, from elevio.con.
+int elevio_floorTravelMs(void);
+int elevio_floorPassingMs(void);
+
+// The trace file being written, or NULL if there is none.
+const char* elevio_tracePath(void);
+
+// Names the controller's scheduler in the trace header, so that a replay
+// can select it; call before elevio_init.
+void elevio_traceSetScheduler(const char* name);
 
 void elevio_motorDirection(MotorDirection dirn);
 void elevio_buttonLamp(int floor, ButtonType button, int value);
@@ -27,8 +63,80 @@ void elevio_floorIndicator(int floor);
 void elevio_doorOpenLamp(int value);
 void elevio_stopLamp(int value);
 
+// An output write in wire format. The encoders below build one without
+// sending it; elevio_writeOutputs sends a whole batch with a single send.
+typedef struct {
+    char bytes[4];
+} ElevioOutput;
+
+ElevioOutput elevio_motorDirectionOutput(MotorDirection dirn);
+ElevioOutput elevio_buttonLampOutput(int floor, ButtonType button, int value);
+ElevioOutput elevio_floorIndicatorOutput(int floor);
+ElevioOutput elevio_doorOpenLampOutput(int value);
+ElevioOutput elevio_stopLampOutput(int value);
+void elevio_writeOutputs(const ElevioOutput* outputs, int count);
+
 int elevio_callButton(int floor, ButtonType button);
 int elevio_floorSensor(void);
 int elevio_stopButton(void);
 int elevio_obstruction(void);
 
+
+typedef struct {
+    int callButton[ELEVIO_MAX_FLOORS][N_BUTTONS];
+    int floorSensor;
+    int stopButton;
+    int obstruction;
+} ElevioInputs;
+
+// Reads every input in one round-trip: all queries are written with a single
+// send and all replies are collected with a single recv. Buttons that do not
+// exist (hall up on the top floor, hall down on the bottom floor) read as 0.
+// Returns 0 if the reply was cut short, i.e. the connection was lost.
+int elevio_pollInputs(ElevioInputs* inputs);
+
+// Split form of elevio_pollInputs for event-driven callers: send the query
+// batch, wait for elevio_socket() to become readable, then collect.
+void elevio_pollInputsRequest(void);
+int elevio_pollInputsCollect(ElevioInputs* inputs);
+int elevio_socket(void);
+
+// For transports that do their own I/O on the connections (elevio_uring.h):
+// the poll batch in wire format, the decoding of a whole reply to it, and
+// the capture of traffic to the trace file, if any.
+const char* elevio_pollQuery(int* len);
+void elevio_decodePollReply(const char* reply, ElevioInputs* inputs);
+void elevio_traceTraffic(int car, const void* buf, int len, int reply);
+
+
+// Push mode. A server that supports it answers a subscribe request with
+// {ELEVIO_OP_SUBSCRIBE, 1} and from then on sends an event record
+// {ELEVIO_OP_EVENT, input, floor, value} on every input edge, starting
+// with one for each input that is not at rest. Inputs at rest are all 0
+// with floorSensor -1. input is a ButtonType or an ElevioEventInput; a
+// floor sensor event with value 0 means the car left that floor.
+#define ELEVIO_OP_SUBSCRIBE 10
+#define ELEVIO_OP_EVENT     11
+
+typedef enum {
+    ELEVIO_EVENT_FLOOR_SENSOR   = 3,
+    ELEVIO_EVENT_STOP           = 4,
+    ELEVIO_EVENT_OBSTRUCTION    = 5
+} ElevioEventInput;
+
+// Subscribes the selected car if elevio.con sets --subscribe 1; the original
+// servers do not know the request. Returns 1 if the server acknowledged
+// within ackTimeoutMs; inputs is then at rest and the events that follow bring
+// it up to date. Returns 0 if push mode is off or the server did not
+// acknowledge in time, in which case the car must keep being polled. The
+// car is then reconnected, so that a late acknowledgement cannot reach the
+// poll replies; -1 means that failed and the car has no socket.
+int elevio_subscribe(ElevioInputs* inputs, int ackTimeoutMs);
+
+// Applies the event records available on the selected car's socket without
+// blocking. Returns how many were applied, or -1 if the connection was lost.
+int elevio_readEvents(ElevioInputs* inputs);
+
+// Applies one event record; out of range records are ignored.
+void elevio_applyEvent(ElevioInputs* inputs, const unsigned char record[4]);
+
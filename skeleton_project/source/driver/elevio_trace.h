@@ -0,0 +1,64 @@
+#pragma once
+
+#include <stdint.h>
+
+// Binary capture of the elevio socket traffic, written by elevio.c when
+// elevio.con sets --trace_file. The file is a fixed header followed by
+// fixed-size records in the order the messages went over the wire, so a
+// reader can mmap it and walk it without parsing.
+//
+// Each record holds one 4-byte request or reply. The opcode only needs
+// the low nibble of the first byte; the upper bits carry the car index and
+// whether the message was a reply.
+
+#define ELEVIO_TRACE_MAGIC "EIOT"
+#define ELEVIO_TRACE_VERSION 3
+#define ELEVIO_TRACE_SCHEDULER_LEN 16
+
+typedef struct {
+    char magic[4];
+    uint32_t version;
+    uint32_t recordSize;
+    uint32_t numFloors;
+    uint32_t numCars;
+    uint32_t reserved;
+    // CLOCK_MONOTONIC at the start of the capture, a whole millisecond
+    uint64_t startNs;
+    // Local wall-clock time at startNs in milliseconds since the epoch, for
+    // controller decisions that depend on the time of day. Not in version 1
+    // headers, which end before it.
+    int64_t startLocalMs;
+    // Car motion from elevio.con, which the controller's time estimates
+    // use. Not in version 1 or 2 headers.
+    uint32_t floorTravelMs;
+    uint32_t floorPassingMs;
+    // Name of the controller's scheduler, NUL-padded; empty if the
+    // controller did not give one. Not in version 1 or 2 headers.
+    char scheduler[ELEVIO_TRACE_SCHEDULER_LEN];
+} ElevioTraceHeader;
+
+#define ELEVIO_TRACE_HEADER_SIZE_V1 32
+#define ELEVIO_TRACE_HEADER_SIZE_V2 40
+
+typedef struct {
+    // Milliseconds since startNs
+    uint32_t timeMs;
+    uint8_t bytes[4];
+} ElevioTraceRecord;
+
+#define ELEVIO_TRACE_REPLY      0x80
+#define ELEVIO_TRACE_CAR_SHIFT  4
+#define ELEVIO_TRACE_CAR_MASK   0x70
+#define ELEVIO_TRACE_OP_MASK    0x0f
+
+static inline int elevio_traceOpcode(const ElevioTraceRecord* r){
+    return r->bytes[0] & ELEVIO_TRACE_OP_MASK;
+}
+
+static inline int elevio_traceCar(const ElevioTraceRecord* r){
+    return (r->bytes[0] & ELEVIO_TRACE_CAR_MASK) >> ELEVIO_TRACE_CAR_SHIFT;
+}
+
+static inline int elevio_traceIsReply(const ElevioTraceRecord* r){
+    return (r->bytes[0] & ELEVIO_TRACE_REPLY) != 0;
+}
@@ -0,0 +1,361 @@
+#include <errno.h>
+#include <linux/io_uring.h>
+#include <stdint.h>
+#include <stdlib.h>
+#include <string.h>
+#include <sys/mman.h>
+#include <sys/socket.h>
+#include <sys/syscall.h>
+#include <time.h>
+#include <unistd.h>
+
+#include "elevio_uring.h"
+
+// Two submissions per request (the request and its linked timeout), and a
+// send and a receive per car. The completion ring is twice as large, which
+// leaves room for a cancel per request when a round has to be abandoned.
+#define URING_ENTRIES (ELEVIO_MAX_CARS*4)
+
+// Room for a full batch of writes and a poll query on top of what a
+// previous exchange could not send
+#define URING_TX_CAPACITY 4096
+#define URING_RX_CAPACITY ((ELEVIO_MAX_FLOORS*N_BUTTONS + 1)*4)
+
+enum { URING_SEND, URING_RECV, URING_TIMEOUT, URING_CANCEL };
+
+// One car's connection: bytes waiting to be sent, in stream order, and the
+// reply owed to the last poll query
+typedef struct {
+    int fd;
+    char tx[URING_TX_CAPACITY];
+    int txLen;
+    char rx[URING_RX_CAPACITY];
+    int rxHave;
+    int rxNeed;
+    uint64_t owedSinceMs;
+    int lost;
+} UringCar;
+
+static int ringFd = -1;
+static int timeoutMs;
+
+// The mappings, kept so that a broken ring can be torn down and set up again
+static char* sqRing;
+static size_t sqRingSize;
+static char* cqRing;
+static size_t cqRingSize;
+static size_t sqesSize;
+static int numCars;
+static UringCar cars[ELEVIO_MAX_CARS];
+
+static unsigned* sqHead;
+static unsigned* sqTail;
+static unsigned* sqMask;
+static unsigned* sqArray;
+static struct io_uring_sqe* sqes;
+static unsigned sqPending;
+
+static unsigned* cqHead;
+static unsigned* cqTail;
+static unsigned* cqMask;
+static struct io_uring_cqe* cqes;
+
+// Linked timeouts are read when submitted, so one per car and direction
+static struct __kernel_timespec timeouts[ELEVIO_MAX_CARS][2];
+
+static uint64_t uring_nowMs(void){
+    struct timespec ts;
+    clock_gettime(CLOCK_MONOTONIC, &ts);
+    return (uint64_t)ts.tv_sec*1000u + (uint64_t)ts.tv_nsec/1000000u;
+}
+
+static int uring_supports(int fd){
+    size_t size = sizeof(struct io_uring_probe) + 256*sizeof(struct io_uring_probe_op);
+    struct io_uring_probe* probe = calloc(1, size);
+    if(!probe) return 0;
+
+    int ok = syscall(__NR_io_uring_register, fd, IORING_REGISTER_PROBE, probe, 256) == 0;
+    const int needed[] = { IORING_OP_SEND, IORING_OP_RECV, IORING_OP_LINK_TIMEOUT,
+                           IORING_OP_ASYNC_CANCEL };
+    for(int i = 0; ok && i < 4; i++){
+        ok = needed[i] <= probe->last_op && (probe->ops[needed[i]].flags & IO_URING_OP_SUPPORTED);
+    }
+    free(probe);
+    return ok;
+}
+
+static int uring_map(const struct io_uring_params* p){
+    size_t sqSize = p->sq_off.array + p->sq_entries*sizeof(unsigned);
+    size_t cqSize = p->cq_off.cqes + p->cq_entries*sizeof(struct io_uring_cqe);
+    int single = p->features & IORING_FEAT_SINGLE_MMAP;
+    if(single){
+        sqSize = cqSize = sqSize > cqSize ? sqSize : cqSize;
+    }
+
+    char* sq = mmap(NULL, sqSize, PROT_READ | PROT_WRITE, MAP_SHARED | MAP_POPULATE,
+                    ringFd, IORING_OFF_SQ_RING);
+    if(sq == MAP_FAILED) return 0;
+    sqRing = sq;
+    sqRingSize = sqSize;
+    char* cq = single ? sq : mmap(NULL, cqSize, PROT_READ | PROT_WRITE, MAP_SHARED | MAP_POPULATE,
+                                  ringFd, IORING_OFF_CQ_RING);
+    if(cq == MAP_FAILED) return 0;
+    cqRing = cq;
+    cqRingSize = cqSize;
+    sqesSize = p->sq_entries*sizeof(struct io_uring_sqe);
+    void* s = mmap(NULL, sqesSize, PROT_READ | PROT_WRITE, MAP_SHARED | MAP_POPULATE,
+                   ringFd, IORING_OFF_SQES);
+    if(s == MAP_FAILED) return 0;
+    sqes = s;
+
+    sqHead  = (unsigned*)(sq + p->sq_off.head);
+    sqTail  = (unsigned*)(sq + p->sq_off.tail);
+    sqMask  = (unsigned*)(sq + p->sq_off.ring_mask);
+    sqArray = (unsigned*)(sq + p->sq_off.array);
+    cqHead  = (unsigned*)(cq + p->cq_off.head);
+    cqTail  = (unsigned*)(cq + p->cq_off.tail);
+    cqMask  = (unsigned*)(cq + p->cq_off.ring_mask);
+    cqes    = (struct io_uring_cqe*)(cq + p->cq_off.cqes);
+    return 1;
+}
+
+// Closing the ring cancels whatever is still in flight on it
+static void uring_close(void){
+    if(sqes) munmap(sqes, sqesSize);
+    if(cqRing && cqRing != sqRing) munmap(cqRing, cqRingSize);
+    if(sqRing) munmap(sqRing, sqRingSize);
+    sqes = NULL;
+    sqRing = cqRing = NULL;
+    sqPending = 0;
+    if(ringFd >= 0) close(ringFd);
+    ringFd = -1;
+}
+
+static int uring_open(void){
+    struct io_uring_params p;
+    memset(&p, 0, sizeof(p));
+    ringFd = syscall(__NR_io_uring_setup, URING_ENTRIES, &p);
+    if(ringFd < 0) return 0;
+
+    if(!uring_supports(ringFd) || !uring_map(&p)){
+        uring_close();
+        return 0;
+    }
+    return 1;
+}
+
+int elevio_uringInit(int timeout){
+    if(!uring_open()) return 0;
+
+    timeoutMs = timeout;
+    numCars = elevio_numCars();
+    for(int car = 0; car < numCars; car++){
+        elevio_uringReset(car);
+    }
+    return 1;
+}
+
+void elevio_uringReset(int car){
+    elevio_selectCar(car);
+    memset(&cars[car], 0, sizeof(cars[car]));
+    cars[car].fd = elevio_socket();
+}
+
+static void uring_append(int car, const void* bytes, int len){
+    UringCar* c = &cars[car];
+    if(c->fd < 0) return;
+    // The server has not taken anything for a whole timeout
+    if(c->txLen + len > URING_TX_CAPACITY){
+        c->lost = 1;
+        return;
+    }
+    memcpy(c->tx + c->txLen, bytes, len);
+    c->txLen += len;
+    // Traced when queued: the stream order is what a replay matches against
+    elevio_traceTraffic(car, bytes, len, 0);
+}
+
+void elevio_uringQueue(int car, const ElevioOutput* outputs, int count){
+    uring_append(car, outputs, count*sizeof(ElevioOutput));
+}
+
+static struct io_uring_sqe* uring_sqe(uint8_t opcode, int fd, uint64_t userData){
+    unsigned tail = *sqTail + sqPending++;
+    unsigned index = tail & *sqMask;
+    struct io_uring_sqe* sqe = &sqes[index];
+    memset(sqe, 0, sizeof(*sqe));
+    sqe->opcode = opcode;
+    sqe->fd = fd;
+    sqe->user_data = userData;
+    sqArray[index] = index;
+    return sqe;
+}
+
+// Queues a send or receive followed by its timeout
+static void uring_prepare(int car, int kind, void* buf, int len, uint64_t remainingMs){
+    struct io_uring_sqe* sqe = uring_sqe(kind == URING_SEND ? IORING_OP_SEND : IORING_OP_RECV,
+                                         cars[car].fd, (uint64_t)car << 2 | kind);
+    sqe->addr = (uint64_t)(uintptr_t)buf;
+    sqe->len = len;
+    sqe->msg_flags = kind == URING_SEND ? MSG_NOSIGNAL : 0;
+    sqe->flags = IOSQE_IO_LINK;
+
+    struct __kernel_timespec* ts = &timeouts[car][kind];
+    ts->tv_sec = remainingMs/1000;
+    ts->tv_nsec = (remainingMs%1000)*1000000;
+    sqe = uring_sqe(IORING_OP_LINK_TIMEOUT, -1, (uint64_t)car << 2 | URING_TIMEOUT);
+    sqe->addr = (uint64_t)(uintptr_t)ts;
+    sqe->len = 1;
+}
+
+// Applies one completion
+static void uring_complete(const struct io_uring_cqe* cqe){
+    UringCar* c = &cars[cqe->user_data >> 2];
+    int res = cqe->res;
+
+    switch(cqe->user_data & 3){
+    case URING_SEND:
+        if(res > 0){
+            memmove(c->tx, c->tx + res, c->txLen - res);
+            c->txLen -= res;
+        }
+        break;
+    case URING_RECV:
+        if(res == 0) c->lost = 1;
+        if(res > 0) c->rxHave += res;
+        break;
+    default:
+        return;
+    }
+    // Anything but being cut short by the timeout, or retried by the next round
+    if(res < 0 && res != -ECANCELED && res != -EINTR && res != -EAGAIN){
+        c->lost = 1;
+    }
+}
+
+// Publishes the prepared requests; returns how many there are
+static unsigned uring_publish(void){
+    unsigned count = sqPending;
+    __atomic_store_n(sqTail, *sqTail + sqPending, __ATOMIC_RELEASE);
+    sqPending = 0;
+    return count;
+}
+
+// Submits toSubmit published requests and reaps completions until
+// *reaped reaches expected. Returns 0 if io_uring_enter failed.
+static int uring_wait(unsigned toSubmit, unsigned expected, unsigned* reaped){
+    while(*reaped < expected){
+        int r = syscall(__NR_io_uring_enter, ringFd, toSubmit, expected - *reaped,
+                        IORING_ENTER_GETEVENTS, NULL, 0);
+        if(r < 0 && errno != EINTR) return 0;
+        if(r > 0) toSubmit -= r < (int)toSubmit ? (unsigned)r : toSubmit;
+
+        unsigned head = *cqHead;
+        unsigned tail = __atomic_load_n(cqTail, __ATOMIC_ACQUIRE);
+        for(; head != tail; head++, (*reaped)++){
+            uring_complete(&cqes[head & *cqMask]);
+        }
+        __atomic_store_n(cqHead, head, __ATOMIC_RELEASE);
+    }
+    return 1;
+}
+
+// Abandons a round that io_uring_enter failed on, owing the given number
+// of completions: takes back what the kernel has not consumed, cancels the
+// sends and receives it has and reaps every completion, so that nothing is
+// still writing into a car's buffers after the exchange. If that fails as
+// well the ring is closed and set up afresh. Either way the callers count
+// every car as lost, and their buffers are reset before they are used again.
+static void uring_abort(unsigned owed){
+    unsigned head = __atomic_load_n(sqHead, __ATOMIC_ACQUIRE);
+    owed -= *sqTail - head;
+    __atomic_store_n(sqTail, head, __ATOMIC_RELEASE);
+
+    if(owed > 0){
+        for(int car = 0; car < numCars; car++){
+            if(cars[car].fd < 0) continue;
+            for(int kind = URING_SEND; kind <= URING_RECV; kind++){
+                struct io_uring_sqe* sqe = uring_sqe(IORING_OP_ASYNC_CANCEL, -1,
+                                                     (uint64_t)car << 2 | URING_CANCEL);
+                sqe->addr = (uint64_t)car << 2 | kind;
+            }
+        }
+    }
+    // A cancel that finds nothing completes with -ENOENT, so each one adds
+    // a completion; the linked timeouts bound the wait regardless
+    unsigned cancels = uring_publish();
+    unsigned reaped = 0;
+    if(!uring_wait(cancels, owed + cancels, &reaped)){
+        uring_close();
+        uring_open();
+    }
+}
+
+// Submits the prepared requests and reaps all their completions
+static int uring_run(void){
+    unsigned expected = uring_publish();
+    unsigned reaped = 0;
+    if(uring_wait(expected, expected, &reaped)) return 1;
+    uring_abort(expected - reaped);
+    return 0;
+}
+
+void elevio_uringExchange(unsigned pollMask, ElevioInputs inputs[], int updated[]){
+    int queryLen;
+    const char* query = elevio_pollQuery(&queryLen);
+
+    // The ring could not be set up again after a failure; try once more
+    // per exchange, and count the cars as lost until it is back
+    if(ringFd < 0 && !uring_open()){
+        for(int car = 0; car < numCars; car++){
+            updated[car] = cars[car].fd >= 0 ? -1 : 0;
+        }
+        return;
+    }
+
+    for(int car = 0; car < numCars; car++){
+        updated[car] = 0;
+        if((pollMask >> car & 1) && cars[car].fd >= 0 && cars[car].rxNeed == 0){
+            uring_append(car, query, queryLen);
+            cars[car].rxHave = 0;
+            cars[car].rxNeed = queryLen;
+            cars[car].owedSinceMs = uring_nowMs();
+        }
+    }
+
+    // Rounds until everything is through; only partial sends and replies
+    // need more than one, and no round outlasts the deadline
+    uint64_t deadline = uring_nowMs() + timeoutMs;
+    int ok = 1;
+    while(ok){
+        uint64_t now = uring_nowMs();
+        if(now >= deadline) break;
+
+        for(int car = 0; car < numCars; car++){
+            UringCar* c = &cars[car];
+            if(c->fd < 0 || c->lost) continue;
+            if(c->txLen > 0){
+                uring_prepare(car, URING_SEND, c->tx, c->txLen, deadline - now);
+            }
+            if(c->rxHave < c->rxNeed){
+                uring_prepare(car, URING_RECV, c->rx + c->rxHave, c->rxNeed - c->rxHave, deadline - now);
+            }
+        }
+        if(sqPending == 0) break;
+        ok = uring_run();
+    }
+
+    for(int car = 0; car < numCars; car++){
+        UringCar* c = &cars[car];
+        if(c->lost || !ok){
+            updated[car] = -1;
+        } else if(c->rxNeed > 0 && c->rxHave == c->rxNeed){
+            elevio_traceTraffic(car, c->rx, c->rxNeed, 1);
+            elevio_decodePollReply(c->rx, &inputs[car]);
+            updated[car] = 1;
+            c->rxNeed = 0;
+        } else if(c->rxNeed > 0 && uring_nowMs() - c->owedSinceMs > (uint64_t)elevio_timeoutMs()){
+            updated[car] = -1;
+        }
+    }
+}
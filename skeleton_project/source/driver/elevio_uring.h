@@ -0,0 +1,34 @@
+#pragma once
+
+#include "elevio.h"
+
+
+// io_uring transport for the connections elevio_init() opened, using the
+// raw syscalls so that liburing is not needed.
+//
+// elevio_uringExchange() submits every car's queued output writes and poll
+// queries as one batch and reaps the completions as they come in. Each
+// request carries a linked timeout, so a car that does not answer costs at
+// most the timeout and never holds up the others. Its reply stays owed and
+// is collected by a later exchange before the car is queried again, so the
+// request/reply stream stays in step. A reply owed for longer than
+// elevio_timeoutMs() counts as a lost connection, as with the blocking calls.
+
+#define ELEVIO_URING_MAX_OUTPUTS 256
+
+// Sets up the ring with the given per-request timeout. Returns 0 if the
+// kernel has no usable io_uring; the blocking calls must then be used.
+int elevio_uringInit(int timeoutMs);
+
+// Drops whatever is queued or owed for a car and takes up its current
+// socket; call after elevio_reconnect or elevio_disconnect.
+void elevio_uringReset(int car);
+
+// Queues output writes for a car, to go out with the next exchange.
+void elevio_uringQueue(int car, const ElevioOutput* outputs, int count);
+
+// Sends everything queued and a poll query to each car in pollMask whose
+// last reply is in, and waits until every request completed or timed out.
+// Cars without a socket are skipped. updated[car] is 1 if the car's inputs
+// were refreshed and -1 if its connection was lost.
+void elevio_uringExchange(unsigned pollMask, ElevioInputs inputs[], int updated[]);
@@ -7,59 +7,50 @@
  */
 
 #include "elevator_fsm.h"
+#include "demand_model.h"
 #include "fsm.h"
-#include <stdio.h>
-
-// Order manager forward declarations
-void order_manager_clear_orders_at_floor(int floor, Direction direction);
-bool order_manager_has_orders(void);
-bool order_manager_should_stop(int floor, Direction direction);
-Direction order_manager_get_next_direction(int current_floor, Direction current_direction);
-void order_manager_clear_all_orders(void);
-
-// Hardware interface forward declarations
-void hardware_interface_set_motor_direction(Direction direction);
-int hardware_interface_read_floor_sensor(void);
-
-// Door control forward declarations
-void door_control_open_door(void);
-void door_control_close_door(void);
-DoorState door_control_update(void);
-void door_control_reset_timer(void);
-void door_control_keep_open(void);
-
-/** @brief Current state identifier. */
-state_id_t current_state_id = STATE_INIT;
-
-/** @brief Current floor (-1 if between floors). */
-int current_floor = -1;
-
-/** @brief Current movement direction. */
-Direction current_direction = DIR_STOP;
-
-void elevator_fsm_init(void) {
-    elevator_fsm.state = state_init;
-    fsm_dispatch(EVENT_ENTRY);
+#include "logger.h"
+
+void elevator_fsm_init(elevator_t* e, const building_t* building, hardware_t* hw,
+                       timer_wheel_t* wheel, demand_model_t* demand) {
+    e->state_id = STATE_INIT;
+    e->floor = -1;
+    e->direction = DIR_STOP;
+    e->hw = hw;
+    e->wheel = wheel;
+    e->park_timer = (wheel_timer_t){0};
+    e->park_floor = -1;
+    e->demand = demand;
+    e->building = building;
+    order_manager_init(&e->orders);
+    e->orders.stamps = &e->stamps;
+    e->orders.demand = demand;
+    door_control_init(&e->door, hw, wheel, &e->fsm);
+
+    e->fsm = (fsm_t){ .ctx = e };
+    fsm_transition(&e->fsm, state_init);
 }
 
-void state_init(fsm_events_t event) {
+void state_init(void* ctx, fsm_events_t event) {
+    elevator_t* e = ctx;
+
     switch (event) {
         case EVENT_ENTRY:
-            current_state_id = STATE_INIT;
-            current_floor = hardware_interface_read_floor_sensor();
+            e->state_id = STATE_INIT;
+            e->floor = hardware_interface_read_floor_sensor(e->hw);
 
-            if (current_floor != -1) {
-                fsm_transition(state_idle);
+            if (e->floor != -1) {
+                fsm_transition(&e->fsm, state_idle);
             } else {
-                hardware_interface_set_motor_direction(DIR_DOWN);
+                hardware_interface_set_motor_direction(e->hw, DIR_DOWN);
             }
             return;
 
         case EVENT_TICK:
-            current_floor = hardware_interface_read_floor_sensor();
-            if (current_floor != -1) {
-                hardware_interface_set_motor_direction(DIR_STOP);
-                fsm_transition(state_idle);
+            e->floor = hardware_interface_read_floor_sensor(e->hw);
+            if (e->floor != -1) {
+                hardware_interface_set_motor_direction(e->hw, DIR_STOP);
+                fsm_transition(&e->fsm, state_idle);
             }
             return;
 
@@ -71,36 +62,67 @@ void state_init(fsm_events_t event) {
     }
 }
 
-void state_idle(fsm_events_t event) {
+void state_idle(void* ctx, fsm_events_t event) {
+    elevator_t* e = ctx;
+
     switch (event) {
         case EVENT_ENTRY:
-            current_state_id = STATE_IDLE;
-            hardware_interface_set_motor_direction(DIR_STOP);
-            current_direction = DIR_STOP;
+            e->state_id = STATE_IDLE;
+            hardware_interface_set_motor_direction(e->hw, DIR_STOP);
+            e->direction = DIR_STOP;
+            e->park_floor = -1;
+            if (!order_manager_has_orders(&e->orders) && e->floor != -1) {
+                timer_wheel_arm(e->wheel, &e->park_timer, DEMAND_PARK_DELAY_MS, &e->fsm,
+                                EVENT_PARK_TIMEOUT);
+            }
             return;
 
         case EVENT_TICK:
-            if (order_manager_has_orders()) {
+            if (order_manager_has_orders(&e->orders)) {
                 Direction next_dir = order_manager_get_next_direction(
-                    current_floor,
-                    current_direction
+                    e->building,
+                    &e->orders,
+                    e->floor,
+                    e->direction
                 );
 
                 if (next_dir == DIR_UP) {
-                    fsm_transition(state_moving_up);
+                    fsm_transition(&e->fsm, state_moving_up);
                 } else if (next_dir == DIR_DOWN) {
-                    fsm_transition(state_moving_down);
-                } else if (order_manager_should_stop(current_floor, DIR_STOP)) {
-                    fsm_transition(state_door_open);
+                    fsm_transition(&e->fsm, state_moving_down);
+                } else if (order_manager_should_stop(e->building, &e->orders, e->floor, DIR_UP)) {
+                    // Serve a hall call at this floor, not just a cab order
+                    e->direction = DIR_UP;
+                    fsm_transition(&e->fsm, state_door_open);
+                } else if (order_manager_should_stop(e->building, &e->orders, e->floor, DIR_DOWN)) {
+                    e->direction = DIR_DOWN;
+                    fsm_transition(&e->fsm, state_door_open);
                 }
             }
             return;
 
+        case EVENT_PARK_TIMEOUT: {
+            if (order_manager_has_orders(&e->orders)) return;
+
+            int park = demand_model_parking_floor(e->demand, e->hw->car, e->floor);
+            if (park == e->floor) return;
+
+            LOG(LOG_FSM_PARK, e->hw->car, e->floor, park);
+            e->park_floor = park;
+            fsm_transition(&e->fsm, park > e->floor ? state_moving_up : state_moving_down);
+            return;
+        }
+
         case EVENT_STOP_PRESSED:
-            fsm_transition(state_emergency_stop);
+            fsm_transition(&e->fsm, state_emergency_stop);
             return;
 
         case EVENT_EXIT:
+            timer_wheel_cancel(e->wheel, &e->park_timer);
+            // Moving off to serve orders gives up the parking spot
+            if (e->park_floor == -1) {
+                demand_model_release(e->demand, e->hw->car);
+            }
             return;
 
         default:
@@ -108,40 +130,49 @@ void state_idle(fsm_events_t event) {
     }
 }
 
-void state_moving_up(fsm_events_t event) {
+void state_moving_up(void* ctx, fsm_events_t event) {
+    elevator_t* e = ctx;
+
     switch (event) {
         case EVENT_ENTRY:
-            current_state_id = STATE_MOVING_UP;
-            current_direction = DIR_UP;
-            hardware_interface_set_motor_direction(DIR_UP);
+            e->state_id = STATE_MOVING_UP;
+            e->direction = DIR_UP;
+            hardware_interface_set_motor_direction(e->hw, DIR_UP);
             return;
 
         case EVENT_TICK: {
-            int floor = hardware_interface_read_floor_sensor();
+            int floor = hardware_interface_read_floor_sensor(e->hw);
             if (floor != -1) {
-                current_floor = floor;
+                if (floor != e->floor) {
+                    order_manager_note_arrival(&e->orders);
+                }
+                e->floor = floor;
 
                 // Stop at top floor regardless of orders
-                if (current_floor >= N_FLOORS - 1) {
-                    printf("[FSM] Reached top floor %d, stopping\n", current_floor);
-                    fsm_transition(state_idle);
+                if (e->floor >= e->building->n_floors - 1) {
+                    LOG(LOG_FSM_TOP_FLOOR, e->hw->car, e->floor);
+                    fsm_transition(&e->fsm, state_idle);
                     return;
                 }
 
-                if (order_manager_should_stop(current_floor, DIR_UP)) {
-                    fsm_transition(state_door_open);
+                if (order_manager_should_stop(e->building, &e->orders, e->floor, DIR_UP)) {
+                    fsm_transition(&e->fsm, state_door_open);
+                } else if (e->park_floor != -1 &&
+                           (e->floor == e->park_floor || order_manager_has_orders(&e->orders))) {
+                    // Parked, or an order came in on the way: idle plans from here
+                    fsm_transition(&e->fsm, state_idle);
                 }
             }
             return;
         }
 
         case EVENT_STOP_PRESSED:
-            fsm_transition(state_emergency_stop);
+            fsm_transition(&e->fsm, state_emergency_stop);
             return;
 
         case EVENT_EXIT:
-            printf("[FSM] STATE: MOVING_UP -> Exiting\n");
-            hardware_interface_set_motor_direction(DIR_STOP);
+            LOG(LOG_FSM_EXIT_MOVING_UP, e->hw->car);
+            hardware_interface_set_motor_direction(e->hw, DIR_STOP);
             return;
 
         default:
@@ -149,40 +180,49 @@ void state_moving_up(fsm_events_t event) {
     }
 }
 
-void state_moving_down(fsm_events_t event) {
+void state_moving_down(void* ctx, fsm_events_t event) {
+    elevator_t* e = ctx;
+
     switch (event) {
         case EVENT_ENTRY:
-            current_state_id = STATE_MOVING_DOWN;
-            current_direction = DIR_DOWN;
-            hardware_interface_set_motor_direction(DIR_DOWN);
+            e->state_id = STATE_MOVING_DOWN;
+            e->direction = DIR_DOWN;
+            hardware_interface_set_motor_direction(e->hw, DIR_DOWN);
             return;
 
         case EVENT_TICK: {
-            int floor = hardware_interface_read_floor_sensor();
+            int floor = hardware_interface_read_floor_sensor(e->hw);
             if (floor != -1) {
-                current_floor = floor;
+                if (floor != e->floor) {
+                    order_manager_note_arrival(&e->orders);
+                }
+                e->floor = floor;
 
                 // Stop at bottom floor regardless of orders
-                if (current_floor <= 0) {
-                    printf("[FSM] Reached bottom floor %d, stopping\n", current_floor);
-                    fsm_transition(state_idle);
+                if (e->floor <= 0) {
+                    LOG(LOG_FSM_BOTTOM_FLOOR, e->hw->car, e->floor);
+                    fsm_transition(&e->fsm, state_idle);
                     return;
                 }
 
-                if (order_manager_should_stop(current_floor, DIR_DOWN)) {
-                    fsm_transition(state_door_open);
+                if (order_manager_should_stop(e->building, &e->orders, e->floor, DIR_DOWN)) {
+                    fsm_transition(&e->fsm, state_door_open);
+                } else if (e->park_floor != -1 &&
+                           (e->floor == e->park_floor || order_manager_has_orders(&e->orders))) {
+                    // Parked, or an order came in on the way: idle plans from here
+                    fsm_transition(&e->fsm, state_idle);
                 }
             }
             return;
         }
 
         case EVENT_STOP_PRESSED:
-            fsm_transition(state_emergency_stop);
+            fsm_transition(&e->fsm, state_emergency_stop);
             return;
 
         case EVENT_EXIT:
-            printf("[FSM] STATE: MOVING_DOWN -> Exiting\n");
-            hardware_interface_set_motor_direction(DIR_STOP);
+            LOG(LOG_FSM_EXIT_MOVING_DOWN, e->hw->car);
+            hardware_interface_set_motor_direction(e->hw, DIR_STOP);
             return;
 
         default:
@@ -190,33 +230,40 @@ void state_moving_down(fsm_events_t event) {
     }
 }
 
-void state_door_open(fsm_events_t event) {
+void state_door_open(void* ctx, fsm_events_t event) {
+    elevator_t* e = ctx;
+
     switch (event) {
         case EVENT_ENTRY:
-            current_state_id = STATE_DOOR_OPEN;
-            hardware_interface_set_motor_direction(DIR_STOP);
-            order_manager_clear_orders_at_floor(current_floor, current_direction);
-            door_control_open_door();
+            e->state_id = STATE_DOOR_OPEN;
+            hardware_interface_set_motor_direction(e->hw, DIR_STOP);
+            order_manager_clear_orders_at_floor(e->building, &e->orders, e->floor, e->direction);
+            door_control_open_door(&e->door);
             return;
 
-        case EVENT_TICK: {
-            DoorState door_state = door_control_update();
-            if (door_state == DOOR_CLOSED) {
-                fsm_transition(state_idle);
+        case EVENT_TICK:
+            // Take on calls made here while the door is open instead of cycling it
+            if (order_manager_should_stop(e->building, &e->orders, e->floor, e->direction)) {
+                order_manager_clear_orders_at_floor(e->building, &e->orders, e->floor, e->direction);
+                door_control_reset_timer(&e->door);
             }
             return;
-        }
+
+        case EVENT_DOOR_TIMEOUT:
+            fsm_transition(&e->fsm, state_idle);
+            return;
 
         case EVENT_OBSTRUCTION:
-            door_control_reset_timer();
+        case EVENT_OBSTRUCTION_CLEAR:
+            door_control_reset_timer(&e->door);
             return;
 
         case EVENT_STOP_PRESSED:
-            fsm_transition(state_emergency_stop);
+            fsm_transition(&e->fsm, state_emergency_stop);
             return;
 
         case EVENT_EXIT:
-            door_control_close_door();
+            door_control_close_door(&e->door);
             return;
 
         default:
@@ -224,32 +271,35 @@ void state_door_open(fsm_events_t event) {
     }
 }
 
-void state_emergency_stop(fsm_events_t event) {
+void state_emergency_stop(void* ctx, fsm_events_t event) {
+    elevator_t* e = ctx;
+
     switch (event) {
         case EVENT_ENTRY:
-            current_state_id = STATE_EMERGENCY_STOP;
-            hardware_interface_set_motor_direction(DIR_STOP);
+            e->state_id = STATE_EMERGENCY_STOP;
+            hardware_interface_set_motor_direction(e->hw, DIR_STOP);
 
-            if (current_floor != -1) {
-                door_control_open_door();
+            if (e->floor != -1) {
+                door_control_open_door(&e->door);
+                door_control_keep_open(&e->door);
             }
 
-            order_manager_clear_all_orders();
+            order_manager_clear_all_orders(&e->orders);
             return;
 
         case EVENT_TICK:
-            if (current_floor != -1) {
-                door_control_keep_open();
+            if (e->floor != -1) {
+                door_control_keep_open(&e->door);
             }
             return;
 
         case EVENT_STOP_RELEASED:
-            fsm_transition(state_idle);
+            fsm_transition(&e->fsm, state_idle);
             return;
 
         case EVENT_EXIT:
-            if (current_floor != -1) {
-                door_control_close_door();
+            if (e->floor != -1) {
+                door_control_close_door(&e->door);
             }
             return;
 
@@ -4,6 +4,8 @@
  *
  * Defines the states and state functions for the elevator control system.
  * The FSM handles initialization, idle, movement, door control, and emergency stop.
+ * All state of one elevator lives in an elevator_t, which is the context
+ * pointer its state functions receive.
  */
 
 #ifndef ELEVATOR_FSM_H
@@ -11,6 +13,10 @@
 
 #include "fsm.h"
 #include "elevator_types.h"
+#include "order_manager.h"
+#include "door_control.h"
+#include "hardware_interface.h"
+#include "timer_wheel.h"
 
 /**
  * @brief Enumeration of elevator states.
@@ -24,74 +30,142 @@ typedef enum {
     STATE_EMERGENCY_STOP 
 } state_id_t;
 
-/** @brief Current state identifier for external access. */
-extern state_id_t current_state_id;
+/** @brief Number of states; state_id_t values are 0 to N_STATES-1. */
+#define N_STATES 6
 
-/** @brief Current floor position (-1 if between floors). */
-extern int current_floor;
+/**
+ * @brief Converts state_id_t to string for debugging
+ */
+static inline const char* state_id_to_string(state_id_t state) {
+    switch (state) {
+        case STATE_INIT: return "INIT";
+        case STATE_IDLE: return "IDLE";
+        case STATE_MOVING_UP: return "MOVING_UP";
+        case STATE_MOVING_DOWN: return "MOVING_DOWN";
+        case STATE_DOOR_OPEN: return "DOOR_OPEN";
+        case STATE_EMERGENCY_STOP: return "EMERGENCY_STOP";
+        default: return "UNKNOWN";
+    }
+}
+
+/**
+ * @brief One elevator: its state machine and everything the states act on.
+ */
+typedef struct {
+    /** @brief State machine; its context points back at this elevator. */
+    fsm_t fsm;
+
+    /** @brief Current state identifier for external access. */
+    state_id_t state_id;
+
+    /** @brief Current floor position (-1 if between floors). */
+    int floor;
+
+    /** @brief Current movement direction. */
+    Direction direction;
 
-/** @brief Current movement direction. */
-extern Direction current_direction;
+    /** @brief Pending orders. */
+    order_table_t orders;
+
+    /** @brief Acceptance and arrival times behind orders.stamps. */
+    order_stamps_t stamps;
+
+    /** @brief Door state and timer. */
+    door_t door;
+
+    /** @brief Fires EVENT_PARK_TIMEOUT once the car has idled without orders. */
+    wheel_timer_t park_timer;
+    timer_wheel_t* wheel;
+
+    /** @brief Floor the car is moving to park at, or -1. */
+    int park_floor;
+
+    /** @brief Demand model of the car's group, choosing where it parks. */
+    demand_model_t* demand;
+
+    /** @brief Building of the car's group, with the scheduler its orders are served by. */
+    const building_t* building;
+
+    /** @brief Hardware connection. */
+    hardware_t* hw;
+} elevator_t;
 
 /**
- * @brief Initializes the elevator FSM.
+ * @brief Initializes an elevator and starts its FSM.
+ *
+ * Clears the orders, closes the door and enters the initial state.
  *
- * Sets the initial state and dispatches the entry event.
+ * @param e The elevator.
+ * @param building The building of the car's group.
+ * @param hw The car's hardware connection.
+ * @param wheel Timer wheel for the door and parking timers.
+ * @param demand Demand model of the car's group.
  */
-void elevator_fsm_init(void);
+void elevator_fsm_init(elevator_t* e, const building_t* building, hardware_t* hw,
+                       timer_wheel_t* wheel, demand_model_t* demand);
 
 /**
  * @brief Initial state handler.
  *
  * Moves elevator down until a valid floor is reached.
  *
+ * @param ctx The elevator_t.
  * @param event The event to process.
  */
-void state_init(fsm_events_t event);
+void state_init(void* ctx, fsm_events_t event);
 
 /**
  * @brief Idle state handler.
  *
  * Waits for orders and transitions to movement or door open states.
+ * After DEMAND_PARK_DELAY_MS without orders the car moves to the
+ * parking floor chosen by the demand model.
  *
+ * @param ctx The elevator_t.
  * @param event The event to process.
  */
-void state_idle(fsm_events_t event);
+void state_idle(void* ctx, fsm_events_t event);
 
 /**
  * @brief Moving up state handler.
  *
- * Controls upward movement and stops at floors with orders.
+ * Controls upward movement and stops at floors with orders, or at the
+ * parking floor.
  *
+ * @param ctx The elevator_t.
  * @param event The event to process.
  */
-void state_moving_up(fsm_events_t event);
+void state_moving_up(void* ctx, fsm_events_t event);
 
 /**
  * @brief Moving down state handler.
  *
- * Controls downward movement and stops at floors with orders.
+ * Controls downward movement and stops at floors with orders, or at the
+ * parking floor.
  *
+ * @param ctx The elevator_t.
  * @param event The event to process.
  */
-void state_moving_down(fsm_events_t event);
+void state_moving_down(void* ctx, fsm_events_t event);
 
 /**
  * @brief Door open state handler.
  *
  * Manages door timing and transitions back to idle when done.
  *
+ * @param ctx The elevator_t.
  * @param event The event to process.
  */
-void state_door_open(fsm_events_t event);
+void state_door_open(void* ctx, fsm_events_t event);
 
 /**
  * @brief Emergency stop state handler.
  *
  * Stops the elevator, clears orders, and opens door if at a floor.
  *
+ * @param ctx The elevator_t.
  * @param event The event to process.
  */
-void state_emergency_stop(fsm_events_t event);
+void state_emergency_stop(void* ctx, fsm_events_t event);
 
 #endif
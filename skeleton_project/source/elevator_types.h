@@ -3,7 +3,56 @@
 
 #include <stdbool.h>
 
-#define N_FLOORS 4
+/** @brief Largest supported floor count (one bit per floor in the order masks). */
+#define N_FLOORS_MAX 64
+
+/** @brief Largest supported number of cars in a group. */
+#define N_CARS_MAX 8
+
+/**
+ * @brief Strategy choosing each car's direction and stops.
+ */
+typedef enum {
+    /** @brief Nearest order ahead, else behind; stops only for same-direction calls. */
+    ORDER_SCHEDULER_BASELINE,
+
+    /** @brief Sweep minimizing the sum of estimated service times. */
+    ORDER_SCHEDULER_ETA_TOTAL,
+
+    /** @brief Sweep minimizing the longest estimated service time. */
+    ORDER_SCHEDULER_ETA_WORST
+} order_scheduler_t;
+
+/**
+ * @brief The building a group of cars serves, and how it schedules them.
+ *
+ * Every group has its own, which the FSM and the order queries are given,
+ * so groups of different buildings can run side by side.
+ */
+typedef struct {
+    /** @brief Number of floors, read from the hardware config at startup. */
+    int n_floors;
+
+    /** @brief Number of cars in the group, read from the hardware config at startup. */
+    int n_cars;
+
+    /** @brief Travel time between adjacent floors, read from the hardware config at startup. */
+    int floor_travel_ms;
+
+    /** @brief Span the floor sensor is on as a car passes a floor, read from the hardware config at startup. */
+    int floor_passing_ms;
+
+    /** @brief Scheduler for all cars of the group. */
+    order_scheduler_t scheduler;
+} building_t;
+
+/**
+ * @brief Defaults until the hardware config is read: the layout and car
+ *        motion of simulator.con, scheduled by ORDER_SCHEDULER_ETA_TOTAL.
+ */
+#define BUILDING_DEFAULT { \
+    .n_floors = 4, .n_cars = 1, .floor_travel_ms = 2000, .floor_passing_ms = 500, \
+    .scheduler = ORDER_SCHEDULER_ETA_TOTAL }
 
 typedef enum {
     DIR_DOWN = -1,
@@ -17,6 +66,18 @@ typedef enum {
     ORDER_TYPE_CAB
 } OrderType;
 
+/** @brief Number of order types; OrderType values are 0 to N_ORDER_TYPES-1. */
+#define N_ORDER_TYPES 3
+
+/**
+ * @brief A destination call: a passenger at the origin keyed in the floor
+ *        they are going to, instead of pressing a hall button.
+ */
+typedef struct {
+    int origin;
+    int destination;
+} destination_call_t;
+
 typedef enum {
     DOOR_CLOSED,
     DOOR_OPEN,
@@ -48,10 +109,10 @@ static inline const char* door_state_to_string(DoorState state) {
 }
 
 /**
- * @brief Checks if a floor is valid
+ * @brief Checks if a floor is valid in a building
  */
-static inline bool is_valid_floor(int floor) {
-    return floor >= 0 && floor < N_FLOORS;
+static inline bool is_valid_floor(const building_t* building, int floor) {
+    return floor >= 0 && floor < building->n_floors;
 }
 
 /**
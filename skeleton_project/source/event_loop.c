@@ -0,0 +1,284 @@
+/**
+ * @file event_loop.c
+ * @brief Event-driven main loop built on epoll and timerfd.
+ *
+ * Replaces the fixed-period polling loop. Inputs are sampled by the I/O
+ * thread, which signals an eventfd whenever a snapshot changed. The FSMs
+ * are only dispatched when an input changed or a timer wheel deadline
+ * (such as the door timeout) fired, and never wait on the network.
+ *
+ * The steps of an iteration are public so that elevator_sim can drive
+ * them from its own virtual-time scheduler instead of epoll. They keep
+ * all of their state in the group they are given; only the epoll loop
+ * itself, of which a process runs one, has descriptors of its own.
+ */
+
+#include "event_loop.h"
+#include "fsm.h"
+#include "elevator_fsm.h"
+#include "group_controller.h"
+#include "hardware_interface.h"
+#include "clock.h"
+#include "logger.h"
+#include "sample_scheduler.h"
+#include "stats.h"
+#include "timer_wheel.h"
+#include <stdbool.h>
+#include <stdint.h>
+#include <pthread.h>
+#include <signal.h>
+#include <stdio.h>
+#include <sys/epoll.h>
+#include <sys/signalfd.h>
+#include <sys/timerfd.h>
+#include <unistd.h>
+
+/** @brief Upper bound on follow-up ticks after a state change. */
+#define EVENT_LOOP_MAX_SETTLE_TICKS 8
+
+/** @brief epoll tags for the event sources. */
+#define EVENT_SOURCE_INPUTS 0
+#define EVENT_SOURCE_DEADLINE 1
+#define EVENT_SOURCE_SIGNAL 2
+
+static int epoll_fd = -1;
+static int deadline_timer_fd = -1;
+static int signal_fd = -1;
+
+static void set_timer_ms(int fd, int delay_ms) {
+    struct itimerspec spec = {
+        .it_value = { delay_ms / 1000, (delay_ms % 1000) * 1000000L },
+    };
+    // A zero it_value disarms the timer; round tiny delays up to 1 ns
+    if (delay_ms <= 0) spec.it_value.tv_nsec = 1;
+    timerfd_settime(fd, 0, &spec, NULL);
+}
+
+static bool watch_fd(int fd, uint32_t tag) {
+    struct epoll_event ev = { .events = EPOLLIN, .data.u32 = tag };
+    return epoll_ctl(epoll_fd, EPOLL_CTL_ADD, fd, &ev) == 0;
+}
+
+/**
+ * @brief Dispatches EVENT_TICK to every car until each settles in one state.
+ *
+ * States such as idle only act on a tick, so a transition into them must
+ * be followed by another tick instead of waiting for the next input change.
+ * Every car is ticked because a hall call made at one car may have been
+ * assigned to another.
+ */
+static void dispatch_tick(group_controller_t* group) {
+    for (int car = 0; car < group->building.n_cars; car++) {
+        elevator_t* e = group_controller_car(group, car);
+        for (int i = 0; i < EVENT_LOOP_MAX_SETTLE_TICKS; i++) {
+            state_id_t before = e->state_id;
+            uint64_t start_ns = clock_wall_ns();
+            fsm_dispatch(&e->fsm, EVENT_TICK);
+            stats_tick(clock_wall_ns() - start_ns);
+            if (e->state_id == before) break;
+        }
+    }
+}
+
+/**
+ * @brief Runs the FSM of a car on its current input snapshot.
+ *
+ * The snapshot's events are queued together and processed by the ticks
+ * that follow, so a stop press is handled ahead of everything else that
+ * changed in the same sample.
+ */
+static void handle_inputs(group_controller_t* group, int car) {
+    elevator_t* e = group_controller_car(group, car);
+    hardware_interface_poll_buttons(e->hw, group, &e->orders);
+
+    bool stop_pressed = hardware_interface_read_stop_button(e->hw);
+    if (stop_pressed && !group->prev_stop_state[car]) {
+        fsm_post(&e->fsm, EVENT_STOP_PRESSED);
+    } else if (!stop_pressed && group->prev_stop_state[car]) {
+        fsm_post(&e->fsm, EVENT_STOP_RELEASED);
+    }
+    group->prev_stop_state[car] = stop_pressed;
+
+    bool obstructed = hardware_interface_read_obstruction(e->hw);
+    if (obstructed) {
+        fsm_post(&e->fsm, EVENT_OBSTRUCTION);
+    } else if (group->prev_obstruction_state[car]) {
+        fsm_post(&e->fsm, EVENT_OBSTRUCTION_CLEAR);
+    }
+    group->prev_obstruction_state[car] = obstructed;
+
+    dispatch_tick(group);
+}
+
+/**
+ * @brief Collects every car's input snapshot and runs the FSMs on the
+ *        cars whose inputs changed.
+ */
+void event_loop_handle_inputs(group_controller_t* group) {
+    for (int car = 0; car < group->building.n_cars; car++) {
+        if (hardware_interface_collect_inputs(group_controller_car(group, car)->hw)) {
+            handle_inputs(group, car);
+        }
+    }
+}
+
+/**
+ * @brief Runs the FSMs after orders were added without an input change.
+ */
+void event_loop_handle_orders(group_controller_t* group) {
+    dispatch_tick(group);
+}
+
+/**
+ * @brief Fires every timer wheel deadline that has passed.
+ *
+ * An obstruction still present pushes the door timer back before the
+ * wheel advances.
+ */
+void event_loop_handle_deadline(group_controller_t* group) {
+    for (int car = 0; car < group->building.n_cars; car++) {
+        elevator_t* e = group_controller_car(group, car);
+        if (hardware_interface_read_obstruction(e->hw)) {
+            fsm_dispatch(&e->fsm, EVENT_OBSTRUCTION);
+        }
+    }
+    timer_wheel_advance(group_controller_wheel(group));
+    dispatch_tick(group);
+}
+
+/**
+ * @brief Sets every car's input sampling period, brings its lamps up to
+ *        date and writes what changed.
+ *
+ * The period follows the state the FSMs just left the car in.
+ */
+void event_loop_commit_outputs(group_controller_t* group) {
+    for (int car = 0; car < group->building.n_cars; car++) {
+        sample_scheduler_update(group, car);
+        elevator_t* e = group_controller_car(group, car);
+        order_table_t lamps = group_controller_lamp_orders(group, car);
+        hardware_interface_update_lights(e->hw, e->floor, &lamps);
+        hardware_interface_commit(e->hw);
+    }
+    hardware_interface_flush(group->backend);
+}
+
+/**
+ * @brief Points the deadline timerfd at the earliest timer wheel expiry.
+ */
+static void rearm_deadline(group_controller_t* group) {
+    int64_t delay_ms = timer_wheel_ms_until_next(group_controller_wheel(group));
+    if (delay_ms < 0) {
+        struct itimerspec off = {0};
+        timerfd_settime(deadline_timer_fd, 0, &off, NULL);
+    } else {
+        set_timer_ms(deadline_timer_fd, (int)delay_ms);
+    }
+}
+
+static void stop_signals(sigset_t* set) {
+    sigemptyset(set);
+    sigaddset(set, SIGINT);
+    sigaddset(set, SIGTERM);
+}
+
+/**
+ * @brief Blocks SIGINT and SIGTERM in the calling thread and those it creates.
+ *
+ * @return true on success, false otherwise.
+ */
+bool event_loop_block_signals(void) {
+    sigset_t set;
+    stop_signals(&set);
+    return pthread_sigmask(SIG_BLOCK, &set, NULL) == 0;
+}
+
+/**
+ * @brief Creates the epoll instance, deadline timer and signal descriptor
+ *        for running a group.
+ *
+ * @return true on success, false otherwise.
+ */
+bool event_loop_init(group_controller_t* group) {
+    sigset_t set;
+    stop_signals(&set);
+
+    epoll_fd = epoll_create1(0);
+    deadline_timer_fd = timerfd_create(CLOCK_MONOTONIC, 0);
+    signal_fd = signalfd(-1, &set, SFD_CLOEXEC);
+    if (epoll_fd == -1 || deadline_timer_fd == -1 || signal_fd == -1) {
+        return false;
+    }
+
+    if (!watch_fd(hardware_interface_fd(group->backend), EVENT_SOURCE_INPUTS) ||
+        !watch_fd(deadline_timer_fd, EVENT_SOURCE_DEADLINE) ||
+        !watch_fd(signal_fd, EVENT_SOURCE_SIGNAL)) {
+        return false;
+    }
+
+    event_loop_commit_outputs(group);
+    rearm_deadline(group);
+    return true;
+}
+
+/**
+ * @brief Reports connection changes, and resyncs outputs after a reconnect.
+ */
+static void check_connection(group_controller_t* group) {
+    static bool was_connected = true;
+    static unsigned seen_reconnects = 0;
+
+    bool is_connected = hardware_interface_connected(group->backend);
+    if (was_connected && !is_connected) {
+        printf("WARNING: Lost connection to elevator server; reconnecting\n");
+        LOG(LOG_CONNECTION_LOST);
+    }
+    was_connected = is_connected;
+
+    unsigned reconnects = hardware_interface_reconnects(group->backend);
+    if (reconnects != seen_reconnects) {
+        seen_reconnects = reconnects;
+        for (int car = 0; car < group->building.n_cars; car++) {
+            hardware_interface_resync(group_controller_car(group, car)->hw);
+        }
+        printf("Reconnected to elevator server\n");
+        LOG(LOG_CONNECTION_RESTORED, reconnects);
+    }
+}
+
+/**
+ * @brief Runs the event loop on a group until SIGINT or SIGTERM arrives.
+ */
+void event_loop_run(group_controller_t* group) {
+    struct epoll_event events[3];
+
+    while (1) {
+        int n = epoll_wait(epoll_fd, events, 3, -1);
+
+        for (int i = 0; i < n; i++) {
+            uint64_t expirations;
+
+            if (events[i].data.u32 == EVENT_SOURCE_INPUTS) {
+                if (read(hardware_interface_fd(group->backend), &expirations, sizeof(expirations)) <= 0) {
+                    continue;
+                }
+                check_connection(group);
+                event_loop_handle_inputs(group);
+            } else if (events[i].data.u32 == EVENT_SOURCE_DEADLINE) {
+                if (read(deadline_timer_fd, &expirations, sizeof(expirations)) > 0) {
+                    event_loop_handle_deadline(group);
+                }
+            } else if (events[i].data.u32 == EVENT_SOURCE_SIGNAL) {
+                struct signalfd_siginfo info;
+                if (read(signal_fd, &info, sizeof(info)) == sizeof(info)) {
+                    printf("Stopping on signal %u\n", info.ssi_signo);
+                    return;
+                }
+            }
+        }
+
+        // Committing may arm a sampling timer, so the deadline follows it
+        event_loop_commit_outputs(group);
+        rearm_deadline(group);
+    }
+}
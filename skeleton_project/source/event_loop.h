@@ -0,0 +1,60 @@
+/**
+ * @file event_loop.h
+ * @brief Event-driven main loop built on epoll and timerfd.
+ */
+
+#ifndef EVENT_LOOP_H
+#define EVENT_LOOP_H
+
+#include <stdbool.h>
+#include "group_controller.h"
+
+/**
+ * @brief Blocks SIGINT and SIGTERM, so that they end event_loop_run()
+ *        instead of the process.
+ *
+ * Call before any other thread is created; threads inherit the mask.
+ *
+ * @return true on success, false otherwise.
+ */
+bool event_loop_block_signals(void);
+
+/**
+ * @brief Creates the epoll instance, deadline timer and signal descriptor
+ *        for running a group.
+ *
+ * @return true on success, false otherwise.
+ */
+bool event_loop_init(group_controller_t* group);
+
+/**
+ * @brief Runs the event loop on a group until SIGINT or SIGTERM arrives.
+ *
+ * Timers keep being serviced while the hardware is unreachable, and every
+ * output is written again after a reconnection.
+ */
+void event_loop_run(group_controller_t* group);
+
+/**
+ * @brief Runs the FSMs on every car of a group whose inputs changed.
+ */
+void event_loop_handle_inputs(group_controller_t* group);
+
+/**
+ * @brief Runs the FSMs after orders were added without an input change,
+ *        such as destination calls keyed in at a hall.
+ */
+void event_loop_handle_orders(group_controller_t* group);
+
+/**
+ * @brief Fires every timer wheel deadline of a group that has passed.
+ */
+void event_loop_handle_deadline(group_controller_t* group);
+
+/**
+ * @brief Sets every car's input sampling period, brings its lamps up to
+ *        date and writes what changed.
+ */
+void event_loop_commit_outputs(group_controller_t* group);
+
+#endif
@@ -7,19 +7,97 @@
 
 #include "fsm.h"
 
-/** @brief Global elevator FSM instance. */
-fsm_t elevator_fsm;
+/** @brief Events for which a second queued copy carries no information. */
+#define FSM_COALESCED_EVENTS ((1u << EVENT_TICK) | (1u << EVENT_OBSTRUCTION))
 
-void fsm_dispatch(fsm_events_t event) {
-    if (elevator_fsm.state != NULL) {
-        elevator_fsm.state(event);
+static fsm_lane_t fsm_lane(fsm_events_t event) {
+    switch (event) {
+        case EVENT_STOP_PRESSED:
+        case EVENT_STOP_RELEASED:
+            return FSM_LANE_URGENT;
+        default:
+            return FSM_LANE_NORMAL;
     }
 }
 
-void fsm_transition(p_state_f new_state) {
-    if (elevator_fsm.state != NULL) {
-        fsm_dispatch(EVENT_EXIT);
+static bool fsm_pop(fsm_t* fsm, fsm_events_t* event) {
+    for (int lane = 0; lane < FSM_LANE_COUNT; lane++) {
+        fsm_queue_t* q = &fsm->lanes[lane];
+        if (q->count == 0) continue;
+
+        *event = q->events[q->head];
+        q->head = (q->head + 1) & (FSM_QUEUE_CAPACITY - 1);
+        q->count--;
+        fsm->queued_mask &= ~(1u << *event);
+        return true;
+    }
+    return false;
+}
+
+/**
+ * @brief Carries out requested transitions until none is pending.
+ *
+ * An ENTRY handler may request a further transition; it is handled by the
+ * next iteration rather than by recursion.
+ */
+static void fsm_apply_transitions(fsm_t* fsm) {
+    while (fsm->next_state != NULL) {
+        p_state_f next = fsm->next_state;
+        fsm->next_state = NULL;
+
+        if (fsm->state != NULL) {
+            fsm->state(fsm->ctx, EVENT_EXIT);
+        }
+        fsm->state = next;
+        fsm->state(fsm->ctx, EVENT_ENTRY);
+    }
+}
+
+bool fsm_post(fsm_t* fsm, fsm_events_t event) {
+    uint32_t bit = 1u << event;
+    if ((FSM_COALESCED_EVENTS & bit) && (fsm->queued_mask & bit)) {
+        return true;
+    }
+
+    fsm_queue_t* q = &fsm->lanes[fsm_lane(event)];
+    if (q->count == FSM_QUEUE_CAPACITY) {
+        fsm->dropped++;
+        return false;
+    }
+
+    q->events[(q->head + q->count) & (FSM_QUEUE_CAPACITY - 1)] = event;
+    q->count++;
+    fsm->queued_mask |= bit;
+    return true;
+}
+
+void fsm_run(fsm_t* fsm) {
+    if (fsm->running) return;
+    fsm->running = true;
+
+    fsm_events_t event;
+    while (fsm_pop(fsm, &event)) {
+        if (fsm->state != NULL) {
+            fsm->state(fsm->ctx, event);
+        }
+        fsm_apply_transitions(fsm);
     }
-    elevator_fsm.state = new_state;
-    fsm_dispatch(EVENT_ENTRY);
+
+    fsm->running = false;
+}
+
+bool fsm_dispatch(fsm_t* fsm, fsm_events_t event) {
+    bool queued = fsm_post(fsm, event);
+    fsm_run(fsm);
+    return queued;
+}
+
+void fsm_transition(fsm_t* fsm, p_state_f new_state) {
+    fsm->next_state = new_state;
+    if (fsm->running) return;
+
+    fsm->running = true;
+    fsm_apply_transitions(fsm);
+    fsm->running = false;
+    fsm_run(fsm);
 }
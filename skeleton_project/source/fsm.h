@@ -3,12 +3,21 @@
  * @brief Generic finite state machine framework.
  *
  * Provides a simple state machine infrastructure with support for
- * state transitions and event dispatching.
+ * state transitions and event dispatching. Each fsm_t carries its own
+ * context pointer, so any number of machines can run side by side.
+ *
+ * Events are queued and processed run-to-completion: a handler always
+ * returns before the next event is delivered, and a transition requested
+ * by a handler is carried out after it returns. Nothing recurses, so the
+ * latency of an event is bounded by the handler in progress plus the
+ * events ahead of it in its lane.
  */
 
 #ifndef FSM_H
 #define FSM_H
 
+#include <stdbool.h>
+#include <stdint.h>
 #include <stdlib.h>
 
 /**
@@ -24,40 +33,108 @@ typedef enum {
     EVENT_STOP_PRESSED,      
     EVENT_STOP_RELEASED,     
     EVENT_OBSTRUCTION,       
-    EVENT_OBSTRUCTION_CLEAR 
+    EVENT_OBSTRUCTION_CLEAR,
+    EVENT_PARK_TIMEOUT
 } fsm_events_t;
 
 /**
  * @brief State function pointer type.
  *
- * Each state is implemented as a function that handles events.
+ * Each state is implemented as a function that handles events. It
+ * receives the context pointer of the FSM it belongs to.
  */
-typedef void (*p_state_f)(fsm_events_t event);
+typedef void (*p_state_f)(void* ctx, fsm_events_t event);
+
+/** @brief Capacity of each event lane; a power of two. */
+#define FSM_QUEUE_CAPACITY 8
+
+/**
+ * @brief Event priority lanes, served in this order.
+ *
+ * The stop button events share the urgent lane so that a press and a
+ * release keep their relative order.
+ */
+typedef enum {
+    FSM_LANE_URGENT,
+    FSM_LANE_NORMAL,
+    FSM_LANE_COUNT
+} fsm_lane_t;
 
 /**
- * @brief FSM structure containing current state.
+ * @brief Fixed-capacity ring of pending events.
+ */
+typedef struct {
+    fsm_events_t events[FSM_QUEUE_CAPACITY];
+    uint8_t head;
+    uint8_t count;
+} fsm_queue_t;
+
+/**
+ * @brief FSM structure containing current state and its context.
+ *
+ * Zero-initialize everything but ctx, then enter the first state with
+ * fsm_transition().
  */
 typedef struct {
     p_state_f state;  
+    void* ctx;
+
+    /** @brief Transition requested by the running handler, if any. */
+    p_state_f next_state;
+
+    fsm_queue_t lanes[FSM_LANE_COUNT];
+
+    /** @brief Coalescable events currently queued, one bit per event. */
+    uint32_t queued_mask;
+
+    /** @brief Set while events are being processed. */
+    bool running;
+
+    /** @brief Events dropped because their lane was full. */
+    uint32_t dropped;
 } fsm_t;
 
-/** @brief Global elevator FSM instance. */
-extern fsm_t elevator_fsm;
+/**
+ * @brief Queues an event without processing it.
+ *
+ * EVENT_TICK and EVENT_OBSTRUCTION are coalesced: posting one that is
+ * already queued has no effect.
+ *
+ * @param fsm The state machine.
+ * @param event The event to queue.
+ * @return false if the event's lane was full and the event was dropped.
+ */
+bool fsm_post(fsm_t* fsm, fsm_events_t event);
+
+/**
+ * @brief Processes queued events until the queue is empty.
+ *
+ * Does nothing when called from inside a handler of the same FSM; the
+ * outer call picks up whatever was queued.
+ *
+ * @param fsm The state machine.
+ */
+void fsm_run(fsm_t* fsm);
 
 /**
- * @brief Dispatches an event to the current state.
+ * @brief Queues an event and processes the queue.
  *
+ * @param fsm The state machine.
  * @param event The event to dispatch.
+ * @return false if the event was dropped.
  */
-void fsm_dispatch(fsm_events_t event);
+bool fsm_dispatch(fsm_t* fsm, fsm_events_t event);
 
 /**
  * @brief Transitions to a new state.
  *
  * Sends EXIT event to current state, changes state, then sends ENTRY event.
+ * Called from a handler, the transition takes place once the handler
+ * returns; the last request wins.
  *
+ * @param fsm The state machine.
  * @param new_state Pointer to the new state function.
  */
-void fsm_transition(p_state_f new_state);
+void fsm_transition(fsm_t* fsm, p_state_f new_state);
 
 #endif
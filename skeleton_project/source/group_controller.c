@@ -0,0 +1,291 @@
+/**
+ * @file group_controller.c
+ * @brief Multi-car group controller with cost-based hall call assignment.
+ *
+ * A group_controller_t owns the elevator contexts, hardware handles,
+ * timer wheel and demand model of all its cars. Every control call goes
+ * straight to the car it concerns, so no car has to be selected first.
+ */
+
+#include "group_controller.h"
+#include "door_control.h"
+#include "elevator_fsm.h"
+#include "hardware_interface.h"
+#include "logger.h"
+#include "order_manager.h"
+#include "timer_wheel.h"
+#include <string.h>
+
+/**
+ * @brief Weight of a passenger's wait at the hall against their ride in
+ *        the cost of a car's plan.
+ *
+ * With waits and rides weighed alike, calls pile onto cars already
+ * carrying people to the same floors and the mean wait grows past that
+ * of hall calls.
+ */
+#define GROUP_WAIT_WEIGHT 2
+
+/**
+ * @brief What an estimate waits for: an order being cleared or, for a
+ *        destination call, its passenger being picked up and set down.
+ */
+typedef struct {
+    int floor;
+    OrderType type;
+
+    /** @brief Destination of a destination call from floor, or -1. */
+    int destination;
+} estimate_goal_t;
+
+/**
+ * @brief Cost of a car's plan: when each passenger is picked up, weighted
+ *        by GROUP_WAIT_WEIGHT, and when they are set down.
+ */
+typedef struct {
+    int64_t total_ms;
+
+    /** @brief Passengers aboard bound for each floor; a pending cab order counts as one. */
+    int riders[N_FLOORS_MAX];
+} plan_cost_t;
+
+void group_controller_init(group_controller_t* group, const hardware_backend_t* backend,
+                           const building_t* building) {
+    group->building = *building;
+    group->backend = backend;
+    memset(group->prev_stop_state, 0, sizeof(group->prev_stop_state));
+    memset(group->prev_obstruction_state, 0, sizeof(group->prev_obstruction_state));
+    memset(group->sampling, 0, sizeof(group->sampling));
+    timer_wheel_init(&group->wheel);
+
+    for (int car = 0; car < group->building.n_cars; car++) {
+        hardware_interface_open(&group->hardware[car], backend, &group->building, car);
+        elevator_fsm_init(&group->cars[car], &group->building, &group->hardware[car], &group->wheel,
+                          &group->demand);
+    }
+}
+
+elevator_t* group_controller_car(group_controller_t* group, int car) {
+    return &group->cars[car];
+}
+
+timer_wheel_t* group_controller_wheel(group_controller_t* group) {
+    return &group->wheel;
+}
+
+demand_model_t* group_controller_demand(group_controller_t* group) {
+    return &group->demand;
+}
+
+order_table_t group_controller_lamp_orders(const group_controller_t* group, int car) {
+    order_table_t lamps = { .cab = group->cars[car].orders.cab };
+    for (int other = 0; other < group->building.n_cars; other++) {
+        lamps.hall_up |= group->cars[other].orders.hall_up;
+        lamps.hall_down |= group->cars[other].orders.hall_down;
+    }
+    return lamps;
+}
+
+/**
+ * @brief Checks whether a simulated table has met a goal.
+ *
+ * A destination call's goal becomes its cab order once the passenger is
+ * picked up.
+ */
+static bool goal_reached(const building_t* building, const order_table_t* table,
+                         estimate_goal_t* goal) {
+    if (goal->destination >= 0) {
+        destination_call_t call = { goal->floor, goal->destination };
+        if (order_table_has_destination(building, table, call)) return false;
+        *goal = (estimate_goal_t){ goal->destination, ORDER_TYPE_CAB, -1 };
+    }
+    return !order_table_has_order(building, table, goal->floor, goal->type);
+}
+
+/**
+ * @brief Adds the passengers a simulated stop picked up and set down to
+ *        the cost of a plan.
+ *
+ * A hall call without destination calls behind it counts as one party.
+ */
+static void account_stop(plan_cost_t* cost, const order_table_t* before, const order_table_t* after,
+                         int floor, int door_ms) {
+    uint64_t bit = (uint64_t)1 << floor;
+    if (before->cab & ~after->cab & bit) {
+        cost->total_ms += (int64_t)door_ms * cost->riders[floor];
+        cost->riders[floor] = 0;
+    }
+
+    uint64_t boarded = before->destinations[floor] & ~after->destinations[floor];
+    int parties = __builtin_popcountll(boarded);
+    for (; boarded != 0; boarded &= boarded - 1) {
+        cost->riders[__builtin_ctzll(boarded)]++;
+    }
+    int halls = !!(before->hall_up & ~after->hall_up & bit) + !!(before->hall_down & ~after->hall_down & bit);
+    if (parties < halls) parties = halls;
+    cost->total_ms += (int64_t)door_ms * GROUP_WAIT_WEIGHT * parties;
+}
+
+/**
+ * @brief Serves a stop of a simulated plan.
+ *
+ * @return true if the goal, if any, was met.
+ */
+static bool serve_stop(const building_t* building, order_table_t* table, int floor,
+                       Direction direction, int t, estimate_goal_t* goal, plan_cost_t* cost) {
+    order_table_t before = *table;
+    order_table_clear_at_floor(building, table, floor, direction);
+    if (cost != NULL) account_stop(cost, &before, table, floor, t);
+    return goal != NULL && goal_reached(building, table, goal);
+}
+
+/**
+ * @brief Simulates a car's order handling on a table until a goal is met
+ *        or, without one, until every order is served.
+ *
+ * @param goal What to wait for, or NULL for the whole table.
+ * @param cost Accumulates the plan's cost if not NULL.
+ * @return Estimated milliseconds, or GROUP_UNREACHABLE_MS.
+ */
+static int simulate_plan(const elevator_t* c, order_table_t table, estimate_goal_t* goal,
+                         plan_cost_t* cost) {
+    if (c->state_id == STATE_INIT || c->state_id == STATE_EMERGENCY_STOP || c->floor == -1) {
+        return GROUP_UNREACHABLE_MS;
+    }
+
+    const building_t* building = c->building;
+    int pos = c->floor;
+    Direction dir = DIR_STOP;
+    int t = 0;
+
+    switch (c->state_id) {
+        // A car on its way to park stops at the next floor for new orders
+        case STATE_MOVING_UP: dir = c->park_floor == -1 ? DIR_UP : DIR_STOP; break;
+        case STATE_MOVING_DOWN: dir = c->park_floor == -1 ? DIR_DOWN : DIR_STOP; break;
+        case STATE_DOOR_OPEN: t += DOOR_OPEN_DURATION_MS / 2; break;
+        default: break;
+    }
+
+    // Each pass moves one floor or serves one stop, so this bounds a full sweep
+    for (int step = 0; step < 4 * building->n_floors + 4 && order_table_has_orders(&table); step++) {
+        if (dir != DIR_STOP) {
+            pos += dir;
+            t += building->floor_travel_ms;
+
+            bool at_end = (dir == DIR_UP) ? pos >= building->n_floors - 1 : pos <= 0;
+            if (at_end) {
+                dir = DIR_STOP;
+            } else if (order_table_should_stop(building, &table, pos, dir)) {
+                bool reached = serve_stop(building, &table, pos, dir, t, goal, cost);
+                t += DOOR_OPEN_DURATION_MS;
+                if (reached) return t;
+                dir = DIR_STOP;
+            }
+            continue;
+        }
+
+        Direction next = order_table_next_direction(building, &table, pos, DIR_STOP, NULL);
+        if (next == DIR_STOP) {
+            // Mirrors the idle state: hall calls here are served going up first
+            Direction serve = order_table_should_stop(building, &table, pos, DIR_UP) ? DIR_UP
+                            : order_table_should_stop(building, &table, pos, DIR_DOWN) ? DIR_DOWN
+                            : DIR_STOP;
+            if (serve == DIR_STOP) break;
+            bool reached = serve_stop(building, &table, pos, serve, t, goal, cost);
+            t += DOOR_OPEN_DURATION_MS;
+            if (reached) return t;
+            continue;
+        }
+        dir = next;
+    }
+
+    return goal == NULL && !order_table_has_orders(&table) ? t : GROUP_UNREACHABLE_MS;
+}
+
+int group_controller_estimate_ms(const group_controller_t* group, int car, int floor, OrderType type) {
+    const elevator_t* c = &group->cars[car];
+    order_table_t table = c->orders;
+    order_table_add(&group->building, &table, floor, type);
+    estimate_goal_t goal = { floor, type, -1 };
+    return simulate_plan(c, table, &goal, NULL);
+}
+
+/**
+ * @brief Simulates a car serving a whole table and returns the plan's cost.
+ *
+ * @return The cost in milliseconds, or -1 if the plan does not finish.
+ */
+static int64_t plan_cost_ms(const elevator_t* c, order_table_t table) {
+    plan_cost_t cost = { 0 };
+    for (uint64_t cab = table.cab; cab != 0; cab &= cab - 1) {
+        cost.riders[__builtin_ctzll(cab)] = 1;
+    }
+    if (simulate_plan(c, table, NULL, &cost) == GROUP_UNREACHABLE_MS) return -1;
+    return cost.total_ms;
+}
+
+int group_controller_estimate_destination_ms(const group_controller_t* group, int car,
+                                             destination_call_t call) {
+    const elevator_t* c = &group->cars[car];
+    order_table_t table = c->orders;
+    order_table_add_destination(&group->building, &table, call);
+    if (!order_table_has_destination(&group->building, &table, call)) return GROUP_UNREACHABLE_MS;
+
+    int64_t before = plan_cost_ms(c, c->orders);
+    int64_t after = plan_cost_ms(c, table);
+    if (before >= 0 && after >= 0) {
+        return (int)(after - before);
+    }
+
+    // A plan too long to simulate is costed by the passenger's own trip
+    estimate_goal_t goal = { call.origin, ORDER_TYPE_CAB, call.destination };
+    return simulate_plan(c, table, &goal, NULL);
+}
+
+void group_controller_hall_call(group_controller_t* group, int floor, OrderType type) {
+    const building_t* building = &group->building;
+    for (int car = 0; car < building->n_cars; car++) {
+        if (order_table_has_order(building, &group->cars[car].orders, floor, type)) return;
+    }
+
+    int best_car = 0;
+    int best_ms = GROUP_UNREACHABLE_MS;
+    for (int car = 0; car < building->n_cars; car++) {
+        int ms = group_controller_estimate_ms(group, car, floor, type);
+        if (ms < best_ms) {
+            best_ms = ms;
+            best_car = car;
+        }
+    }
+
+    if (building->n_cars > 1) {
+        LOG(LOG_GROUP_ASSIGN, floor, type, best_car,
+            best_ms == GROUP_UNREACHABLE_MS ? -1 : best_ms);
+    }
+
+    order_manager_add_order(building, &group->cars[best_car].orders, floor, type);
+}
+
+int group_controller_destination_call(group_controller_t* group, destination_call_t call) {
+    const building_t* building = &group->building;
+    int best_car = -1;
+    int best_ms = GROUP_UNREACHABLE_MS;
+
+    // Passengers already keyed in for the same trip share their car
+    for (int car = 0; car < building->n_cars; car++) {
+        if (order_table_has_destination(building, &group->cars[car].orders, call)) return car;
+    }
+
+    for (int car = 0; car < building->n_cars; car++) {
+        int ms = group_controller_estimate_destination_ms(group, car, call);
+        if (ms < best_ms) {
+            best_ms = ms;
+            best_car = car;
+        }
+    }
+    if (best_car == -1) return -1;
+
+    LOG(LOG_GROUP_DESTINATION, call.origin, call.destination, best_car, best_ms);
+    order_manager_add_destination(building, &group->cars[best_car].orders, call);
+    return best_car;
+}
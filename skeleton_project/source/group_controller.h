@@ -0,0 +1,165 @@
+/**
+ * @file group_controller.h
+ * @brief Group controller running several cars from one process.
+ *
+ * Each car is an elevator_t with its own FSM, order table, door and
+ * hardware connection; all cars share the group's timer wheel. The group
+ * controller assigns every hall call to the car with the lowest
+ * estimated time-to-serve. Cab calls stay with the car they were made in.
+ *
+ * In a destination-dispatch building passengers key in their destination
+ * at the hall instead. Each destination call goes to the car whose plan
+ * it adds the least cost to, counting the delay to everyone that car
+ * already carries or is to pick up. That groups passengers bound for the
+ * same floors into the same car.
+ *
+ * A group is a group_controller_t instance holding all of its state, so
+ * any number of groups can run in one process, each on the thread that
+ * drives it.
+ */
+
+#ifndef GROUP_CONTROLLER_H
+#define GROUP_CONTROLLER_H
+
+#include "demand_model.h"
+#include "elevator_types.h"
+#include "elevator_fsm.h"
+#include "hardware_interface.h"
+#include "sample_scheduler.h"
+#include "timer_wheel.h"
+
+/**
+ * @brief One group of cars and the building they serve.
+ *
+ * The fields belong to the group controller, the event loop and the
+ * sample scheduler; everything else goes through the functions below.
+ */
+typedef struct group_controller {
+    /** @brief Layout, car motion and scheduler of the building. */
+    building_t building;
+
+    /** @brief Backend every car of the group is driven through. */
+    const hardware_backend_t* backend;
+
+    elevator_t cars[N_CARS_MAX];
+    hardware_t hardware[N_CARS_MAX];
+
+    /** @brief Timer wheel shared by all cars of the group. */
+    timer_wheel_t wheel;
+
+    /** @brief Demand model shared by all cars of the group. */
+    demand_model_t demand;
+
+    /** @brief Stop button and obstruction of each car when the event loop last saw them. */
+    bool prev_stop_state[N_CARS_MAX];
+    bool prev_obstruction_state[N_CARS_MAX];
+
+    /** @brief Input sampling of each car. */
+    car_sampling_t sampling[N_CARS_MAX];
+} group_controller_t;
+
+/**
+ * @brief Opens every car's hardware and starts its FSM.
+ *
+ * The demand model is left as it is, so it may be initialized before.
+ *
+ * @param group The group.
+ * @param backend The backend, started by hardware_interface_init().
+ * @param building The building hardware_interface_init() read, with the
+ *                 scheduler to use.
+ */
+void group_controller_init(group_controller_t* group, const hardware_backend_t* backend,
+                           const building_t* building);
+
+/**
+ * @brief Returns a car of the group.
+ *
+ * @param group The group.
+ * @param car The car index (0 to n_cars-1).
+ */
+elevator_t* group_controller_car(group_controller_t* group, int car);
+
+/**
+ * @brief Returns the timer wheel the cars' timers run on.
+ */
+timer_wheel_t* group_controller_wheel(group_controller_t* group);
+
+/**
+ * @brief Returns the demand model the cars park by.
+ *
+ * It stays inactive, and idle cars stay where they are, until
+ * demand_model_init() is called on it.
+ */
+demand_model_t* group_controller_demand(group_controller_t* group);
+
+/**
+ * @brief Returns the orders whose button lamps should be lit on a car's panel.
+ *
+ * That is the car's own cab calls and the hall calls of every car, since
+ * a hall call is shown wherever it was pressed, whichever car serves it.
+ *
+ * @param group The group.
+ * @param car The car index.
+ */
+order_table_t group_controller_lamp_orders(const group_controller_t* group, int car);
+
+/**
+ * @brief Assigns a hall call to the car that can serve it first.
+ *
+ * Calls already held by a car are left where they are.
+ *
+ * @param group The group.
+ * @param floor The floor of the hall button.
+ * @param type ORDER_TYPE_HALL_UP or ORDER_TYPE_HALL_DOWN.
+ */
+void group_controller_hall_call(group_controller_t* group, int floor, OrderType type);
+
+/**
+ * @brief Estimates how long a car needs to serve a call.
+ *
+ * Simulates the car's order handling with the call added, using
+ * order_table_next_direction() and order_table_should_stop() the same
+ * way the FSM uses their order_manager counterparts.
+ *
+ * @param group The group.
+ * @param car The car index.
+ * @param floor The floor of the call.
+ * @param type The order type.
+ * @return Estimated milliseconds until the call is cleared, or
+ *         GROUP_UNREACHABLE_MS if the car cannot serve it.
+ */
+int group_controller_estimate_ms(const group_controller_t* group, int car, int floor, OrderType type);
+
+/**
+ * @brief Estimates the cost of giving a car a destination call.
+ *
+ * A car's plan costs the sum over its passengers of when each is picked
+ * up, counted double as waiting weighs more than riding, and of when each
+ * is set down; a pending hall or cab order counts as one passenger. The
+ * cost of the call is how much it adds to that sum, so it includes the
+ * delay to everyone else the car serves.
+ *
+ * @param group The group.
+ * @param car The car index.
+ * @param call The destination call.
+ * @return Estimated cost in milliseconds, or GROUP_UNREACHABLE_MS.
+ */
+int group_controller_estimate_destination_ms(const group_controller_t* group, int car,
+                                             destination_call_t call);
+
+/**
+ * @brief Assigns a destination call to the car with the lowest cost.
+ *
+ * A call for a trip some car already holds goes to that car.
+ *
+ * @param group The group.
+ * @param call The destination call.
+ * @return The car the passenger should board, or -1 if no car can serve
+ *         the call or it is invalid.
+ */
+int group_controller_destination_call(group_controller_t* group, destination_call_t call);
+
+/** @brief Cost reported for cars that cannot serve a call. */
+#define GROUP_UNREACHABLE_MS 0x7fffffff
+
+#endif
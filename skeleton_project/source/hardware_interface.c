@@ -3,120 +3,380 @@
  * @brief Hardware abstraction layer for elevator control.
  *
  * This module provides an interface between the elevator control logic
- * and the low-level hardware driver (elevio). It handles button polling,
- * motor control, sensors, and indicator lights.
+ * and the hardware backend. It handles button polling, motor control,
+ * sensors, and indicator lights. Backends never block: with the elevio
+ * I/O thread, inputs are read from its snapshot cache and outputs are
+ * queued to it, so none of these calls wait on the network.
  */
 
-#include "elevator_types.h"
-#include "driver/elevio.h"
+#include "hardware_interface.h"
+#include "group_controller.h"
 #include <stdbool.h>
 #include <stdio.h>
-
-// Forward declarations
-void order_manager_add_order(int floor, OrderType type);
+#include <string.h>
 
 /**
  * @brief Initializes the hardware interface.
  *
- * Establishes connection to the elevator hardware/simulator.
+ * Starts the backend, which establishes the connection to the elevator
+ * hardware/simulator, and reads the building layout and car motion
+ * times from it. Motion times the backend does not know are left as the
+ * building has them; so is the scheduler.
  *
+ * @param backend The backend to use.
+ * @param building Receives the layout and motion times.
  * @return true if initialization succeeded, false otherwise.
  */
-bool hardware_interface_init(void) {
-    elevio_init();
+bool hardware_interface_init(const hardware_backend_t* backend, building_t* building) {
+    if (!backend->start()) {
+        return false;
+    }
+
+    building->n_floors = backend->num_floors();
+    if (building->n_floors < 2 || building->n_floors > N_FLOORS_MAX) {
+        printf("ERROR: Unsupported floor count %d\n", building->n_floors);
+        return false;
+    }
+
+    building->n_cars = backend->num_cars();
+    if (building->n_cars < 1 || building->n_cars > N_CARS_MAX) {
+        printf("ERROR: Unsupported car count %d\n", building->n_cars);
+        return false;
+    }
+
+    if (backend->floor_travel_ms != NULL) building->floor_travel_ms = backend->floor_travel_ms();
+    if (backend->floor_passing_ms != NULL) building->floor_passing_ms = backend->floor_passing_ms();
+    if (building->floor_passing_ms <= 0 || building->floor_passing_ms >= building->floor_travel_ms) {
+        printf("ERROR: Unsupported car motion of %d ms per floor, %d ms passing one\n",
+               building->floor_travel_ms, building->floor_passing_ms);
+        return false;
+    }
+
+    return true;
+}
+
+/**
+ * @brief Binds a hardware handle to a car and takes its first input snapshot.
+ *
+ * Every output starts out unknown, so the first commit writes them all.
+ *
+ * @param hw The handle to initialize.
+ * @param backend The backend the car is driven through, started by
+ *                hardware_interface_init().
+ * @param building The building of the car's group.
+ * @param car The car index (0 to n_cars-1).
+ */
+void hardware_interface_open(hardware_t* hw, const hardware_backend_t* backend,
+                             const building_t* building, int car) {
+    hw->backend = backend;
+    hw->building = building;
+    hw->car = car;
+    hardware_interface_poll_inputs(hw);
+
+    memset(&hw->written, (unsigned char)HARDWARE_OUTPUT_UNKNOWN, sizeof(hw->written));
+    hw->desired = (hardware_outputs_t){ .motor = DIR_STOP, .floor_indicator = -1 };
+    hw->sample_period_ms = 0;
+    memset(hw->held, 0, sizeof(hw->held));
+}
+
+/**
+ * @brief Refreshes the input snapshot from the backend.
+ *
+ * The snapshot is used by the button, sensor and switch accessors below.
+ *
+ * @param hw The car's hardware handle.
+ */
+void hardware_interface_poll_inputs(hardware_t* hw) {
+    hw->backend->read_inputs(hw->car, &hw->inputs);
+}
+
+/**
+ * @brief Refreshes the input snapshot and reports whether it changed.
+ *
+ * @param hw The car's hardware handle.
+ * @return true if any input differs from the previous snapshot.
+ */
+bool hardware_interface_collect_inputs(hardware_t* hw) {
+    ElevioInputs previous = hw->inputs;
+    hw->backend->read_inputs(hw->car, &hw->inputs);
+    return memcmp(&previous, &hw->inputs, sizeof(previous)) != 0;
+}
+
+/**
+ * @brief Returns the descriptor that becomes readable when inputs changed.
+ *
+ * Shared by all cars on the backend; read it to re-arm it.
+ */
+int hardware_interface_fd(const hardware_backend_t* backend) {
+    return backend->fd != NULL ? backend->fd() : -1;
+}
+
+/**
+ * @brief Checks whether every car is connected right now.
+ */
+bool hardware_interface_connected(const hardware_backend_t* backend) {
+    return backend->connected == NULL || backend->connected();
+}
+
+/**
+ * @brief Returns how many times the backend re-established a connection.
+ */
+unsigned hardware_interface_reconnects(const hardware_backend_t* backend) {
+    return backend->reconnects != NULL ? backend->reconnects() : 0;
+}
+
+/**
+ * @brief Forgets what was written to a car, so the next commit writes
+ *        every output from the controller's state again.
+ *
+ * @param hw The car's hardware handle.
+ */
+void hardware_interface_resync(hardware_t* hw) {
+    memset(&hw->written, (unsigned char)HARDWARE_OUTPUT_UNKNOWN, sizeof(hw->written));
+}
+
+/**
+ * @brief Asks the backend to sample a car's inputs at a new period.
+ *
+ * Only a change is passed on, so it may be called on every iteration.
+ *
+ * @param hw The car's hardware handle.
+ * @param period_ms The sampling period in milliseconds.
+ * @return false if the backend does not sample inputs periodically.
+ */
+bool hardware_interface_set_sample_period(hardware_t* hw, int period_ms) {
+    if (hw->backend->set_sample_period == NULL) return false;
+    if (period_ms != hw->sample_period_ms) {
+        hw->sample_period_ms = period_ms;
+        hw->backend->set_sample_period(hw->car, period_ms);
+    }
     return true;
 }
 
 /**
- * @brief Polls all elevator buttons and registers orders.
+ * @brief Returns how many input samples the backend took of a car, or 0
+ *        if it does not sample periodically.
+ *
+ * @param hw The car's hardware handle.
+ */
+unsigned hardware_interface_samples(const hardware_t* hw) {
+    return hw->backend->samples != NULL ? hw->backend->samples(hw->car) : 0;
+}
+
+/**
+ * @brief Hands all outputs queued since the last call to the backend.
+ *
+ * Called once per control loop iteration.
+ */
+void hardware_interface_flush(const hardware_backend_t* backend) {
+    backend->flush();
+}
+
+/**
+ * @brief Registers orders for buttons pressed since the last scan, on a
+ *        building of a given size.
+ *
+ * Always inlined so that calls with a constant floor count get fully
+ * unrolled loops.
  *
- * Checks cab buttons, hall up buttons, and hall down buttons.
- * When a button press is detected, an order is added via order_manager.
+ * @param hw The car's hardware handle.
+ * @param group The car's group, which hall presses are handed to.
+ * @param cab_orders Order table receiving cab presses.
+ * @param floors Number of floors to scan.
  */
-void hardware_interface_poll_buttons(void) {
+static inline __attribute__((always_inline)) void poll_buttons_n(hardware_t* hw,
+                                                                  group_controller_t* group,
+                                                                  order_table_t* cab_orders,
+                                                                  int floors) {
+    // A held button is one press, even when its order is served while it
+    // is still down, so it feeds the demand model and statistics once
+    uint64_t pressed[N_BUTTONS];
+    for (int button = 0; button < N_BUTTONS; button++) {
+        uint64_t down = 0;
+        for (int floor = 0; floor < floors; floor++) {
+            down |= (uint64_t)(hw->inputs.callButton[floor][button] != 0) << floor;
+        }
+        pressed[button] = down & ~hw->held[button];
+        hw->held[button] = down;
+    }
+
     // Poll cab buttons
-    for (int floor = 0; floor < N_FLOORS; floor++) {
-        if (elevio_callButton(floor, BUTTON_CAB)) {
-            order_manager_add_order(floor, ORDER_TYPE_CAB);
+    for (int floor = 0; floor < floors; floor++) {
+        if (pressed[BUTTON_CAB] >> floor & 1) {
+            order_manager_add_order(hw->building, cab_orders, floor, ORDER_TYPE_CAB);
         }
     }
 
     // Poll hall up buttons 
-    for (int floor = 0; floor < N_FLOORS - 1; floor++) {
-        if (elevio_callButton(floor, BUTTON_HALL_UP)) {
-            order_manager_add_order(floor, ORDER_TYPE_HALL_UP);
+    for (int floor = 0; floor < floors - 1; floor++) {
+        if (pressed[BUTTON_HALL_UP] >> floor & 1) {
+            group_controller_hall_call(group, floor, ORDER_TYPE_HALL_UP);
         }
     }
 
     // Poll hall down buttons
-    for (int floor = 1; floor < N_FLOORS; floor++) {
-        if (elevio_callButton(floor, BUTTON_HALL_DOWN)) {
-            order_manager_add_order(floor, ORDER_TYPE_HALL_DOWN);
+    for (int floor = 1; floor < floors; floor++) {
+        if (pressed[BUTTON_HALL_DOWN] >> floor & 1) {
+            group_controller_hall_call(group, floor, ORDER_TYPE_HALL_DOWN);
         }
     }
 }
 
 /**
- * @brief Updates the floor indicator light.
+ * @brief Registers orders for the buttons pressed since the last scan.
+ *
+ * Checks cab buttons, hall up buttons, and hall down buttons in the
+ * car's input snapshot; a button still down from the last scan is not
+ * ordered again. Cab presses become orders in the car's own
+ * table; hall presses are handed to the group controller, which assigns
+ * them to the best car. The floor counts the simulator supports get
+ * their own unrolled scan.
  *
+ * @param hw The car's hardware handle.
+ * @param group The car's group.
+ * @param cab_orders The car's order table.
+ */
+void hardware_interface_poll_buttons(hardware_t* hw, group_controller_t* group,
+                                     order_table_t* cab_orders) {
+    switch (hw->building->n_floors) {
+        case 2: poll_buttons_n(hw, group, cab_orders, 2); break;
+        case 3: poll_buttons_n(hw, group, cab_orders, 3); break;
+        case 4: poll_buttons_n(hw, group, cab_orders, 4); break;
+        case 5: poll_buttons_n(hw, group, cab_orders, 5); break;
+        case 6: poll_buttons_n(hw, group, cab_orders, 6); break;
+        case 7: poll_buttons_n(hw, group, cab_orders, 7); break;
+        case 8: poll_buttons_n(hw, group, cab_orders, 8); break;
+        case 9: poll_buttons_n(hw, group, cab_orders, 9); break;
+        default: poll_buttons_n(hw, group, cab_orders, hw->building->n_floors); break;
+    }
+}
+
+/**
+ * @brief Updates the floor indicator and button lamps.
+ *
+ * @param hw The car's hardware handle.
  * @param current_floor The floor to display on the indicator
+ * @param lamps Orders whose button lamps should be lit.
  */
-void hardware_interface_update_lights(int current_floor) {
-    if (current_floor >= 0 && current_floor < N_FLOORS) {
-        elevio_floorIndicator(current_floor);
+void hardware_interface_update_lights(hardware_t* hw, int current_floor, const order_table_t* lamps) {
+    const building_t* building = hw->building;
+    if (is_valid_floor(building, current_floor)) {
+        hw->desired.floor_indicator = (int8_t)current_floor;
+    }
+
+    // ButtonType and OrderType share their numbering
+    for (int floor = 0; floor < building->n_floors; floor++) {
+        for (int button = 0; button < N_BUTTONS; button++) {
+            hw->desired.button_lamps[floor][button] =
+                order_table_has_order(building, lamps, floor, (OrderType)button);
+        }
     }
 }
 
+/**
+ * @brief Writes every output that differs from its last written state.
+ *
+ * All changes of a car go out as one batch. Buttons that do not exist
+ * (hall up on the top floor, hall down on the bottom floor) are skipped.
+ *
+ * @param hw The car's hardware handle.
+ */
+void hardware_interface_commit(hardware_t* hw) {
+    hardware_outputs_t* want = &hw->desired;
+    hardware_outputs_t* have = &hw->written;
+    if (memcmp(want, have, sizeof(*want)) == 0) return;
+
+    const hardware_backend_t* backend = hw->backend;
+    int floors = hw->building->n_floors;
+    if (want->motor != have->motor) {
+        backend->write_output(hw->car, elevio_motorDirectionOutput((MotorDirection)want->motor));
+    }
+    if (want->floor_indicator != have->floor_indicator && want->floor_indicator != -1) {
+        backend->write_output(hw->car, elevio_floorIndicatorOutput(want->floor_indicator));
+    }
+    if (want->door_light != have->door_light && want->door_light != -1) {
+        backend->write_output(hw->car, elevio_doorOpenLampOutput(want->door_light));
+    }
+    if (want->stop_light != have->stop_light && want->stop_light != -1) {
+        backend->write_output(hw->car, elevio_stopLampOutput(want->stop_light));
+    }
+    for (int floor = 0; floor < floors; floor++) {
+        for (int button = 0; button < N_BUTTONS; button++) {
+            if (want->button_lamps[floor][button] == have->button_lamps[floor][button]) continue;
+            if ((button == BUTTON_HALL_UP && floor == floors - 1) ||
+                (button == BUTTON_HALL_DOWN && floor == 0)) {
+                continue;
+            }
+            backend->write_output(hw->car, elevio_buttonLampOutput(floor, (ButtonType)button,
+                                                                   want->button_lamps[floor][button]));
+        }
+    }
+
+    *have = *want;
+}
+
 /**
  * @brief Sets the motor direction.
  *
+ * Takes effect at the next hardware_interface_commit().
+ *
+ * @param hw The car's hardware handle.
  * @param direction The desired direction (DIR_UP, DIR_DOWN, or DIR_STOP).
  */
-void hardware_interface_set_motor_direction(Direction direction) {
-    elevio_motorDirection((MotorDirection)direction);
+void hardware_interface_set_motor_direction(hardware_t* hw, Direction direction) {
+    hw->desired.motor = (int8_t)direction;
 }
 
 /**
  * @brief Reads the floor sensor.
  *
- * @return The current floor (0 to N_FLOORS-1) if at a floor, -1 if between floors.
+ * @param hw The car's hardware handle.
+ * @return The current floor (0 to n_floors-1) if at a floor, -1 if between floors.
  */
-int hardware_interface_read_floor_sensor(void) {
-    return elevio_floorSensor();
+int hardware_interface_read_floor_sensor(const hardware_t* hw) {
+    return hw->inputs.floorSensor;
 }
 
 /**
  * @brief Reads the stop button state.
  *
+ * @param hw The car's hardware handle.
  * @return true if the stop button is pressed, false otherwise.
  */
-bool hardware_interface_read_stop_button(void) {
-    return elevio_stopButton();
+bool hardware_interface_read_stop_button(const hardware_t* hw) {
+    return hw->inputs.stopButton;
 }
 
 /**
  * @brief Reads the obstruction sensor.
  *
+ * @param hw The car's hardware handle.
  * @return true if an obstruction is detected, false otherwise.
  */
-bool hardware_interface_read_obstruction(void) {
-    return elevio_obstruction();
+bool hardware_interface_read_obstruction(const hardware_t* hw) {
+    return hw->inputs.obstruction;
 }
 
 /**
  * @brief Sets the door open indicator light.
  *
+ * Takes effect at the next hardware_interface_commit().
+ *
+ * @param hw The car's hardware handle.
  * @param on true to turn the light on, false to turn it off.
  */
-void hardware_interface_set_door_light(bool on) {
-    elevio_doorOpenLamp(on);
+void hardware_interface_set_door_light(hardware_t* hw, bool on) {
+    hw->desired.door_light = on;
 }
 
 /**
  * @brief Sets the stop button indicator light.
  *
+ * Takes effect at the next hardware_interface_commit().
+ *
+ * @param hw The car's hardware handle.
  * @param on true to turn the light on, false to turn it off.
  */
-void hardware_interface_set_stop_light(bool on) {
-    elevio_stopLamp(on);
+void hardware_interface_set_stop_light(hardware_t* hw, bool on) {
+    hw->desired.stop_light = on;
 }
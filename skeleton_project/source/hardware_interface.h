@@ -0,0 +1,148 @@
+/**
+ * @file hardware_interface.h
+ * @brief Hardware abstraction layer for elevator control.
+ *
+ * Every car is driven through its own hardware_t, which holds the car's
+ * connection index, its most recent input snapshot and a shadow register
+ * of its outputs. Output setters only change the shadow register;
+ * hardware_interface_commit() sends the fields that differ from what was
+ * last written, so socket traffic follows state changes, not tick rate.
+ *
+ * Beneath it sits the hardware_backend_t the handle was opened on, chosen
+ * at startup: the elevio I/O
+ * thread on TCP, with blocking calls or io_uring, a register file in
+ * memory or shared with a co-located simulator (register_backend.h), or a
+ * simulated building in elevator_sim.
+ */
+
+#ifndef HARDWARE_INTERFACE_H
+#define HARDWARE_INTERFACE_H
+
+#include <stdbool.h>
+#include <stdint.h>
+#include "elevator_types.h"
+#include "order_manager.h"
+#include "driver/elevio.h"
+
+/**
+ * @brief Source of inputs and sink of outputs for all cars.
+ */
+typedef struct {
+    /** @brief Connects to the hardware; called once by hardware_interface_init(). */
+    bool (*start)(void);
+    int (*num_floors)(void);
+    int (*num_cars)(void);
+
+    /** @brief Travel time between adjacent floors, or NULL to keep the default. */
+    int (*floor_travel_ms)(void);
+
+    /** @brief Span the floor sensor is on as a car passes a floor, or NULL to keep the default. */
+    int (*floor_passing_ms)(void);
+
+    /** @brief Copies the latest inputs of a car without blocking. */
+    void (*read_inputs)(int car, ElevioInputs* inputs);
+
+    /** @brief Queues one output write for a car. */
+    void (*write_output)(int car, ElevioOutput output);
+
+    /** @brief Sends everything queued since the last flush. */
+    void (*flush)(void);
+
+    /** @brief Descriptor that becomes readable when inputs changed, or NULL. */
+    int (*fd)(void);
+
+    /** @brief Whether every car is reachable right now, or NULL if always. */
+    bool (*connected)(void);
+
+    /**
+     * @brief Count of reconnections so far, or NULL if connections never drop.
+     *
+     * The hardware may have lost its outputs across a reconnection, so the
+     * controller writes them all again when the count moves.
+     */
+    unsigned (*reconnects)(void);
+
+    /**
+     * @brief Asks for a car's inputs to be sampled every period_ms, or NULL
+     *        if the backend does not sample them periodically.
+     */
+    void (*set_sample_period)(int car, int period_ms);
+
+    /** @brief Count of input samples taken of a car, or NULL. */
+    unsigned (*samples)(int car);
+} hardware_backend_t;
+
+/**
+ * @brief Value of an output whose state on the hardware is not known.
+ *
+ * Outside every valid output value; in particular -1 is DIRN_DOWN.
+ */
+#define HARDWARE_OUTPUT_UNKNOWN INT8_MIN
+
+/**
+ * @brief State of every output of one car. A floor indicator of -1 is
+ *        not set yet.
+ */
+typedef struct {
+    int8_t motor;
+    int8_t floor_indicator;
+    int8_t door_light;
+    int8_t stop_light;
+    int8_t button_lamps[ELEVIO_MAX_FLOORS][N_BUTTONS];
+} hardware_outputs_t;
+
+struct group_controller;
+
+/**
+ * @brief Hardware connection of one car.
+ */
+typedef struct {
+    /** @brief Backend the car is driven through. */
+    const hardware_backend_t* backend;
+
+    /** @brief Building of the car's group. */
+    const building_t* building;
+
+    /** @brief Car index on the backend. */
+    int car;
+
+    /** @brief Input snapshot from the most recent batched poll. */
+    ElevioInputs inputs;
+
+    /** @brief Outputs as the control logic wants them. */
+    hardware_outputs_t desired;
+
+    /** @brief Outputs as last written to the hardware. */
+    hardware_outputs_t written;
+
+    /** @brief Sampling period last asked of the backend, or 0. */
+    int sample_period_ms;
+
+    /** @brief Buttons down in the last scanned snapshot, one bit per floor. */
+    uint64_t held[N_BUTTONS];
+} hardware_t;
+
+bool hardware_interface_init(const hardware_backend_t* backend, building_t* building);
+void hardware_interface_open(hardware_t* hw, const hardware_backend_t* backend,
+                             const building_t* building, int car);
+void hardware_interface_poll_inputs(hardware_t* hw);
+bool hardware_interface_collect_inputs(hardware_t* hw);
+int hardware_interface_fd(const hardware_backend_t* backend);
+bool hardware_interface_connected(const hardware_backend_t* backend);
+unsigned hardware_interface_reconnects(const hardware_backend_t* backend);
+void hardware_interface_resync(hardware_t* hw);
+bool hardware_interface_set_sample_period(hardware_t* hw, int period_ms);
+unsigned hardware_interface_samples(const hardware_t* hw);
+void hardware_interface_flush(const hardware_backend_t* backend);
+void hardware_interface_poll_buttons(hardware_t* hw, struct group_controller* group,
+                                     order_table_t* cab_orders);
+void hardware_interface_update_lights(hardware_t* hw, int current_floor, const order_table_t* lamps);
+void hardware_interface_commit(hardware_t* hw);
+void hardware_interface_set_motor_direction(hardware_t* hw, Direction direction);
+int hardware_interface_read_floor_sensor(const hardware_t* hw);
+bool hardware_interface_read_stop_button(const hardware_t* hw);
+bool hardware_interface_read_obstruction(const hardware_t* hw);
+void hardware_interface_set_door_light(hardware_t* hw, bool on);
+void hardware_interface_set_stop_light(hardware_t* hw, bool on);
+
+#endif
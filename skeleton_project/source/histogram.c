@@ -0,0 +1,47 @@
+/**
+ * @file histogram.c
+ * @brief Log-linear latency histogram in the style of HdrHistogram.
+ */
+
+#include "histogram.h"
+
+/**
+ * @brief Returns the highest value that falls into a bucket.
+ */
+static uint64_t bucket_high(int index) {
+    if (index < 2 * HISTOGRAM_SUB_COUNT) return (uint64_t)index;
+
+    int shift = index / HISTOGRAM_SUB_COUNT - 1;
+    uint64_t mantissa = HISTOGRAM_SUB_COUNT + index % HISTOGRAM_SUB_COUNT;
+    return ((mantissa + 1) << shift) - 1;
+}
+
+histogram_summary_t histogram_summarize(const histogram_t* h) {
+    uint32_t counts[HISTOGRAM_BUCKETS];
+    histogram_summary_t summary = {0};
+
+    for (int i = 0; i < HISTOGRAM_BUCKETS; i++) {
+        counts[i] = atomic_load_explicit(&h->counts[i], memory_order_relaxed);
+        summary.count += counts[i];
+    }
+    if (summary.count == 0) return summary;
+
+    summary.mean = atomic_load_explicit(&h->sum, memory_order_relaxed) / summary.count;
+    summary.max = atomic_load_explicit(&h->max, memory_order_relaxed);
+
+    struct { double fraction; uint64_t* value; } targets[] = {
+        { 0.50, &summary.p50 }, { 0.90, &summary.p90 },
+        { 0.99, &summary.p99 }, { 0.999, &summary.p999 },
+    };
+    int next = 0;
+    uint64_t seen = 0;
+    for (int i = 0; i < HISTOGRAM_BUCKETS && next < 4; i++) {
+        seen += counts[i];
+        while (next < 4 && seen >= targets[next].fraction * summary.count) {
+            uint64_t high = bucket_high(i);
+            *targets[next].value = high < summary.max ? high : summary.max;
+            next++;
+        }
+    }
+    return summary;
+}
@@ -0,0 +1,81 @@
+/**
+ * @file histogram.h
+ * @brief Log-linear latency histogram in the style of HdrHistogram.
+ *
+ * Values are bucketed by their top HISTOGRAM_SUB_BITS + 1 significant
+ * bits, so every bucket is within 1 / 2^HISTOGRAM_SUB_BITS (about 3%) of
+ * the values it holds, at any magnitude. Recording is a few shifts and
+ * relaxed atomic adds, with no allocation, locking or search.
+ *
+ * Any number of threads may record into a histogram at once, and another
+ * can take a snapshot meanwhile; the snapshot may be off by the values
+ * recorded while it was being read.
+ */
+
+#ifndef HISTOGRAM_H
+#define HISTOGRAM_H
+
+#include <stdatomic.h>
+#include <stdint.h>
+
+/** @brief Sub-buckets per power of two, as a bit count. */
+#define HISTOGRAM_SUB_BITS 5
+#define HISTOGRAM_SUB_COUNT (1 << HISTOGRAM_SUB_BITS)
+
+/** @brief Values from 2^HISTOGRAM_MAX_BITS up land in the top bucket. */
+#define HISTOGRAM_MAX_BITS 36
+
+#define HISTOGRAM_BUCKETS ((HISTOGRAM_MAX_BITS - HISTOGRAM_SUB_BITS + 1) * HISTOGRAM_SUB_COUNT)
+
+typedef struct {
+    _Atomic uint32_t counts[HISTOGRAM_BUCKETS];
+    _Atomic uint64_t sum;
+    _Atomic uint64_t max;
+} histogram_t;
+
+/**
+ * @brief Summary of a histogram at one point in time.
+ */
+typedef struct {
+    uint64_t count;
+    uint64_t mean;
+    uint64_t p50;
+    uint64_t p90;
+    uint64_t p99;
+    uint64_t p999;
+    uint64_t max;
+} histogram_summary_t;
+
+/**
+ * @brief Returns the bucket a value falls into.
+ */
+static inline int histogram_index(uint64_t value) {
+    if (value >= (uint64_t)1 << HISTOGRAM_MAX_BITS) return HISTOGRAM_BUCKETS - 1;
+    if (value < 2 * HISTOGRAM_SUB_COUNT) return (int)value;
+
+    int shift = 63 - __builtin_clzll(value) - HISTOGRAM_SUB_BITS;
+    return (shift + 1) * HISTOGRAM_SUB_COUNT + (int)(value >> shift) - HISTOGRAM_SUB_COUNT;
+}
+
+/**
+ * @brief Records one value; safe to call from several threads at once.
+ */
+static inline void histogram_record(histogram_t* h, uint64_t value) {
+    atomic_fetch_add_explicit(&h->counts[histogram_index(value)], 1, memory_order_relaxed);
+    atomic_fetch_add_explicit(&h->sum, value, memory_order_relaxed);
+
+    uint64_t max = atomic_load_explicit(&h->max, memory_order_relaxed);
+    while (value > max && !atomic_compare_exchange_weak_explicit(&h->max, &max, value,
+                                                                 memory_order_relaxed,
+                                                                 memory_order_relaxed)) {
+    }
+}
+
+/**
+ * @brief Summarizes a histogram; safe to call while it is being written.
+ *
+ * Percentiles are reported as the highest value of their bucket.
+ */
+histogram_summary_t histogram_summarize(const histogram_t* h);
+
+#endif
@@ -0,0 +1,454 @@
+/**
+ * @file io_thread.c
+ * @brief Background thread that owns all elevio socket traffic.
+ *
+ * Inputs are published per car through a seqlock: the writer makes the
+ * sequence odd, copies the snapshot and makes it even again; a reader
+ * retries until it sees the same even sequence before and after its
+ * copy. Outputs use one SPSC ring per car with the controller thread as
+ * producer and the I/O thread as consumer.
+ *
+ * Subscribed cars cost nothing while idle: the I/O thread sleeps on
+ * their sockets and applies the pushed events to a private snapshot,
+ * which is published like a poll result.
+ *
+ * With io_uring_backend each pass hands all queued writes and due poll
+ * queries to elevio_uringExchange() instead of the blocking calls: one
+ * syscall per pass for every car together, and a car that does not
+ * answer only delays the pass by the request timeout.
+ */
+
+#include "io_thread.h"
+#include "elevator_types.h"
+#include "driver/elevio_uring.h"
+#include <poll.h>
+#include <pthread.h>
+#include <sched.h>
+#include <stdatomic.h>
+#include <stdio.h>
+#include <string.h>
+#include <sys/eventfd.h>
+#include <time.h>
+#include <unistd.h>
+
+/** @brief Seqlock-protected input snapshot of one car. */
+typedef struct {
+    _Alignas(64) atomic_uint seq;
+    ElevioInputs inputs;
+} input_cache_t;
+
+/** @brief SPSC output ring of one car; head and tail on their own lines. */
+typedef struct {
+    ElevioOutput slots[IO_RING_CAPACITY];
+    _Alignas(64) atomic_uint head;
+    _Alignas(64) atomic_uint tail;
+} output_ring_t;
+
+static input_cache_t caches[N_CARS_MAX];
+static output_ring_t rings[N_CARS_MAX];
+
+/** @brief Whether each car pushes its input changes, and the result so far. */
+static bool subscribed[N_CARS_MAX];
+static ElevioInputs pushed[N_CARS_MAX];
+
+/** @brief Signals the controller that inputs changed or a car was lost. */
+static int notify_fd = -1;
+
+/** @brief Wakes the I/O thread when outputs are queued. */
+static int wake_fd = -1;
+
+/** @brief Set by the controller thread on push, cleared on flush. */
+static bool outputs_pending = false;
+
+static atomic_bool connected = true;
+
+/** @brief Link state of each car; touched by the I/O thread only. */
+static bool online[N_CARS_MAX];
+static int backoff_ms[N_CARS_MAX];
+static uint64_t retry_at[N_CARS_MAX];
+
+/** @brief Bumped each time a car's connection was re-established. */
+static atomic_uint reconnects = 0;
+
+/** @brief Sampling period the controller asked for, and samples taken, per car. */
+static atomic_int sample_period_ms[N_CARS_MAX];
+static atomic_uint samples[N_CARS_MAX];
+
+/** @brief Whether socket traffic goes through io_uring. */
+static bool use_uring = false;
+
+static pthread_t thread;
+
+static uint64_t now_ms(void) {
+    struct timespec ts;
+    clock_gettime(CLOCK_MONOTONIC, &ts);
+    return (uint64_t)ts.tv_sec * 1000u + (uint64_t)ts.tv_nsec / 1000000u;
+}
+
+static void signal_fd(int fd) {
+    uint64_t one = 1;
+    ssize_t written = write(fd, &one, sizeof(one));
+    (void)written;
+}
+
+static void publish_inputs(int car, const ElevioInputs* inputs) {
+    input_cache_t* cache = &caches[car];
+    unsigned seq = atomic_load_explicit(&cache->seq, memory_order_relaxed);
+
+    atomic_store_explicit(&cache->seq, seq + 1, memory_order_relaxed);
+    atomic_thread_fence(memory_order_release);
+    cache->inputs = *inputs;
+    atomic_store_explicit(&cache->seq, seq + 2, memory_order_release);
+}
+
+void io_thread_read_inputs(int car, ElevioInputs* inputs) {
+    input_cache_t* cache = &caches[car];
+    unsigned before, after = 0;
+
+    do {
+        before = atomic_load_explicit(&cache->seq, memory_order_acquire);
+        if (before & 1u) {
+            continue;
+        }
+        *inputs = cache->inputs;
+        atomic_thread_fence(memory_order_acquire);
+        after = atomic_load_explicit(&cache->seq, memory_order_relaxed);
+    } while ((before & 1u) || before != after);
+}
+
+void io_thread_push(int car, ElevioOutput output) {
+    output_ring_t* ring = &rings[car];
+    unsigned tail = atomic_load_explicit(&ring->tail, memory_order_relaxed);
+
+    // Full: hand the backlog to the I/O thread and wait for room
+    while (tail - atomic_load_explicit(&ring->head, memory_order_acquire) == IO_RING_CAPACITY) {
+        signal_fd(wake_fd);
+        sched_yield();
+    }
+
+    ring->slots[tail & (IO_RING_CAPACITY - 1)] = output;
+    atomic_store_explicit(&ring->tail, tail + 1, memory_order_release);
+    outputs_pending = true;
+}
+
+void io_thread_flush(void) {
+    if (!outputs_pending) return;
+    outputs_pending = false;
+    signal_fd(wake_fd);
+}
+
+int io_thread_fd(void) {
+    return notify_fd;
+}
+
+bool io_thread_connected(void) {
+    return atomic_load(&connected);
+}
+
+unsigned io_thread_reconnects(void) {
+    return atomic_load(&reconnects);
+}
+
+void io_thread_set_sample_period(int car, int period_ms) {
+    if (period_ms < 1) period_ms = 1;
+    int before = atomic_exchange(&sample_period_ms[car], period_ms);
+    // The thread may be asleep for the old period
+    if (period_ms < before) signal_fd(wake_fd);
+}
+
+unsigned io_thread_samples(int car) {
+    return atomic_load_explicit(&samples[car], memory_order_relaxed);
+}
+
+static void update_connected(int cars) {
+    bool all = true;
+    for (int car = 0; car < cars; car++) all &= online[car];
+    atomic_store(&connected, all);
+}
+
+/**
+ * @brief Takes a car out of service until a reconnect succeeds.
+ */
+static void car_lost(int car, int cars) {
+    elevio_selectCar(car);
+    elevio_disconnect();
+    if (use_uring) elevio_uringReset(car);
+
+    online[car] = false;
+    subscribed[car] = false;
+    backoff_ms[car] = IO_THREAD_RECONNECT_MIN_MS;
+    retry_at[car] = now_ms() + backoff_ms[car];
+    update_connected(cars);
+    signal_fd(notify_fd);
+}
+
+/**
+ * @brief Takes a connected car into service with a fresh snapshot.
+ *
+ * @return false if the car did not answer.
+ */
+static bool bring_up(int car) {
+    ElevioInputs inputs;
+    elevio_selectCar(car);
+    if (!elevio_pollInputs(&inputs)) {
+        return false;
+    }
+    publish_inputs(car, &inputs);
+    int subscribe = elevio_subscribe(&pushed[car], IO_THREAD_SUBSCRIBE_TIMEOUT_MS);
+    if (subscribe < 0) {
+        return false;
+    }
+    subscribed[car] = subscribe == 1;
+    if (use_uring) elevio_uringReset(car);
+    online[car] = true;
+    return true;
+}
+
+/**
+ * @brief Tries to reconnect a car, backing off exponentially on failure.
+ */
+static void try_reconnect(int car, int cars) {
+    elevio_selectCar(car);
+    if (elevio_reconnect() && bring_up(car)) {
+        atomic_fetch_add(&reconnects, 1);
+        update_connected(cars);
+        signal_fd(notify_fd);
+        return;
+    }
+    elevio_disconnect();
+    backoff_ms[car] *= 2;
+    if (backoff_ms[car] > IO_THREAD_RECONNECT_MAX_MS) backoff_ms[car] = IO_THREAD_RECONNECT_MAX_MS;
+    retry_at[car] = now_ms() + backoff_ms[car];
+}
+
+/**
+ * @brief Sends the outputs queued for every car; a disconnected car's are
+ *        dropped, as they are rewritten in full after the reconnect.
+ */
+static void drain_outputs(int cars) {
+    for (int car = 0; car < cars; car++) {
+        output_ring_t* ring = &rings[car];
+        unsigned head = atomic_load_explicit(&ring->head, memory_order_relaxed);
+        unsigned tail = atomic_load_explicit(&ring->tail, memory_order_acquire);
+        if (head == tail) continue;
+
+        ElevioOutput batch[IO_RING_CAPACITY];
+        int count = 0;
+        for (; head != tail; head++) {
+            batch[count++] = ring->slots[head & (IO_RING_CAPACITY - 1)];
+        }
+        atomic_store_explicit(&ring->head, head, memory_order_release);
+
+        if (!online[car]) {
+            continue;
+        } else if (use_uring) {
+            elevio_uringQueue(car, batch, count);
+        } else {
+            elevio_selectCar(car);
+            elevio_writeOutputs(batch, count);
+        }
+    }
+}
+
+/**
+ * @brief Polls the cars in poll_mask and publishes the snapshots.
+ *
+ * @param changed Set to true if any snapshot differs from the last one.
+ */
+static void poll_cars(int cars, unsigned poll_mask, bool* changed) {
+    for (int car = 0; car < cars; car++) {
+        if (!(poll_mask >> car & 1)) continue;
+
+        ElevioInputs inputs;
+        elevio_selectCar(car);
+        if (!elevio_pollInputs(&inputs)) {
+            car_lost(car, cars);
+            continue;
+        }
+        atomic_fetch_add_explicit(&samples[car], 1, memory_order_relaxed);
+        if (memcmp(&inputs, &caches[car].inputs, sizeof(inputs)) != 0) {
+            publish_inputs(car, &inputs);
+            *changed = true;
+        }
+    }
+}
+
+/**
+ * @brief Sends the queued outputs through io_uring, polling the cars in
+ *        poll_mask, and publishes the snapshots.
+ */
+static void exchange(int cars, unsigned poll_mask, bool* changed) {
+    ElevioInputs inputs[N_CARS_MAX];
+    int updated[N_CARS_MAX];
+    elevio_uringExchange(poll_mask, inputs, updated);
+    for (int car = 0; car < cars; car++) {
+        if (updated[car] < 0 && online[car]) {
+            car_lost(car, cars);
+        } else if (updated[car] > 0) {
+            atomic_fetch_add_explicit(&samples[car], 1, memory_order_relaxed);
+            if (memcmp(&inputs[car], &caches[car].inputs, sizeof(inputs[car])) != 0) {
+                publish_inputs(car, &inputs[car]);
+                *changed = true;
+            }
+        }
+    }
+}
+
+/**
+ * @brief Applies the events of a subscribed car and publishes the result.
+ */
+static void read_events(int car, int cars, bool* changed) {
+    elevio_selectCar(car);
+    if (elevio_readEvents(&pushed[car]) < 0) {
+        car_lost(car, cars);
+        return;
+    }
+    if (memcmp(&pushed[car], &caches[car].inputs, sizeof(pushed[car])) != 0) {
+        publish_inputs(car, &pushed[car]);
+        *changed = true;
+    }
+}
+
+static void* io_thread_main(void* arg) {
+    (void)arg;
+    int cars = elevio_numCars();
+    uint64_t next_poll[N_CARS_MAX];
+    for (int car = 0; car < cars; car++) next_poll[car] = now_ms();
+    struct pollfd pfds[1 + N_CARS_MAX] = { { .fd = wake_fd, .events = POLLIN } };
+
+    while (1) {
+        drain_outputs(cars);
+
+        bool changed = false;
+        for (int car = 0; car < cars; car++) {
+            if (pfds[1 + car].revents) read_events(car, cars, &changed);
+        }
+
+        // Each car is polled at its own period; a period shortened since
+        // the last poll takes effect at once
+        unsigned polling = 0, due = 0;
+        uint64_t now = now_ms();
+        for (int car = 0; car < cars; car++) {
+            if (!online[car] || subscribed[car]) continue;
+            polling |= 1u << car;
+            uint64_t period = (uint64_t)atomic_load(&sample_period_ms[car]);
+            if (next_poll[car] > now + period) next_poll[car] = now + period;
+            if (now >= next_poll[car]) due |= 1u << car;
+        }
+
+        if (use_uring) {
+            exchange(cars, due, &changed);
+        } else if (due) {
+            poll_cars(cars, due, &changed);
+        }
+        for (int car = 0; car < cars; car++) {
+            if (!(due >> car & 1)) continue;
+            // Skip missed periods instead of polling back-to-back to catch up
+            next_poll[car] += (uint64_t)atomic_load(&sample_period_ms[car]);
+            if (next_poll[car] < now_ms()) next_poll[car] = now_ms();
+        }
+        if (changed) {
+            signal_fd(notify_fd);
+        }
+
+        // Sleep until the next poll or reconnect attempt, or until woken
+        uint64_t wake_at = UINT64_MAX;
+        for (int car = 0; car < cars; car++) {
+            if ((polling >> car & 1) && next_poll[car] < wake_at) wake_at = next_poll[car];
+        }
+        for (int car = 0; car < cars; car++) {
+            if (!online[car] && now_ms() >= retry_at[car]) try_reconnect(car, cars);
+            if (!online[car] && retry_at[car] < wake_at) wake_at = retry_at[car];
+
+            elevio_selectCar(car);
+            pfds[1 + car] = (struct pollfd){
+                .fd = online[car] && subscribed[car] ? elevio_socket() : -1,
+                .events = POLLIN,
+            };
+        }
+
+        now = now_ms();
+        int timeout = wake_at == UINT64_MAX ? -1 : wake_at > now ? (int)(wake_at - now) : 0;
+        if (poll(pfds, 1 + cars, timeout) <= 0) {
+            for (int i = 0; i <= cars; i++) pfds[i].revents = 0;
+        } else if (pfds[0].revents) {
+            uint64_t count;
+            ssize_t got = read(wake_fd, &count, sizeof(count));
+            (void)got;
+        }
+    }
+    return NULL;
+}
+
+bool io_thread_start(void) {
+    notify_fd = eventfd(0, EFD_NONBLOCK | EFD_CLOEXEC);
+    wake_fd = eventfd(0, EFD_NONBLOCK | EFD_CLOEXEC);
+    if (notify_fd == -1 || wake_fd == -1) {
+        return false;
+    }
+
+    int cars = elevio_numCars();
+    for (int car = 0; car < cars; car++) {
+        atomic_store(&sample_period_ms[car], IO_THREAD_POLL_PERIOD_MS);
+        elevio_selectCar(car);
+        if (elevio_socket() != -1 && bring_up(car)) continue;
+
+        // Starts at rest and is brought up by the I/O thread once reachable
+        printf("WARNING: Car %d is not connected; retrying in the background\n", car);
+        publish_inputs(car, &(ElevioInputs){ .floorSensor = -1 });
+        elevio_disconnect();
+        online[car] = false;
+        backoff_ms[car] = IO_THREAD_RECONNECT_MIN_MS;
+        retry_at[car] = now_ms();
+    }
+    elevio_selectCar(0);
+    update_connected(cars);
+
+    return pthread_create(&thread, NULL, io_thread_main, NULL) == 0;
+}
+
+static bool io_thread_backend_start(void) {
+    elevio_init();
+    return io_thread_start();
+}
+
+static bool io_uring_backend_start(void) {
+    elevio_init();
+    use_uring = elevio_uringInit(IO_THREAD_REQUEST_TIMEOUT_MS);
+    if (!use_uring) {
+        printf("WARNING: No usable io_uring; using blocking socket calls\n");
+    }
+    return io_thread_start();
+}
+
+const hardware_backend_t io_thread_backend = {
+    .start = io_thread_backend_start,
+    .num_floors = elevio_numFloors,
+    .num_cars = elevio_numCars,
+    .floor_travel_ms = elevio_floorTravelMs,
+    .floor_passing_ms = elevio_floorPassingMs,
+    .read_inputs = io_thread_read_inputs,
+    .write_output = io_thread_push,
+    .flush = io_thread_flush,
+    .fd = io_thread_fd,
+    .connected = io_thread_connected,
+    .reconnects = io_thread_reconnects,
+    .set_sample_period = io_thread_set_sample_period,
+    .samples = io_thread_samples,
+};
+
+const hardware_backend_t io_uring_backend = {
+    .start = io_uring_backend_start,
+    .num_floors = elevio_numFloors,
+    .num_cars = elevio_numCars,
+    .floor_travel_ms = elevio_floorTravelMs,
+    .floor_passing_ms = elevio_floorPassingMs,
+    .read_inputs = io_thread_read_inputs,
+    .write_output = io_thread_push,
+    .flush = io_thread_flush,
+    .fd = io_thread_fd,
+    .connected = io_thread_connected,
+    .reconnects = io_thread_reconnects,
+    .set_sample_period = io_thread_set_sample_period,
+    .samples = io_thread_samples,
+};
@@ -0,0 +1,126 @@
+/**
+ * @file io_thread.h
+ * @brief Background thread that owns all elevio socket traffic.
+ *
+ * The I/O thread keeps the inputs of every car up to date and publishes
+ * them through a seqlock, so the controller thread reads inputs without
+ * a syscall. With --subscribe 1 in elevio.con, a car whose server
+ * supports push mode is subscribed and only sends event records on input
+ * edges; any other car is polled at the period the controller last set
+ * for it. Outputs travel the other way through a single-producer,
+ * single-consumer ring per car. Network latency therefore never stalls
+ * the control loop.
+ *
+ * A car whose connection fails is reconnected in the background with
+ * exponential backoff while the others carry on. Its outputs are dropped
+ * meanwhile; io_thread_reconnects() tells the controller to write them
+ * all again once it is back.
+ */
+
+#ifndef IO_THREAD_H
+#define IO_THREAD_H
+
+#include <stdbool.h>
+#include <stdint.h>
+#include "driver/elevio.h"
+#include "hardware_interface.h"
+
+/** @brief Period in milliseconds at which a car is polled until the controller sets one. */
+#define IO_THREAD_POLL_PERIOD_MS 10
+
+/** @brief How long to wait for a server to acknowledge a subscription. */
+#define IO_THREAD_SUBSCRIBE_TIMEOUT_MS 200
+
+/** @brief First and longest wait before trying to reconnect a lost car. */
+#define IO_THREAD_RECONNECT_MIN_MS 100
+#define IO_THREAD_RECONNECT_MAX_MS 5000
+
+/** @brief Longest wait for one request to a car with io_uring_backend. */
+#define IO_THREAD_REQUEST_TIMEOUT_MS 50
+
+/** @brief Capacity of each car's output ring; a power of two. */
+#define IO_RING_CAPACITY 256
+
+/**
+ * @brief Hardware backend that connects with elevio_init() and then runs
+ *        all traffic on the I/O thread.
+ */
+extern const hardware_backend_t io_thread_backend;
+
+/**
+ * @brief Like io_thread_backend, with each pass of the I/O thread submitted
+ *        as one io_uring batch with a timeout on every request.
+ *
+ * Falls back to the blocking calls on kernels without io_uring.
+ */
+extern const hardware_backend_t io_uring_backend;
+
+/**
+ * @brief Takes a first snapshot of every car and starts the I/O thread.
+ *
+ * Requires elevio_init() to have run. A car that is not reachable yet
+ * starts with all inputs at rest and is connected by the I/O thread.
+ *
+ * @return true on success, false otherwise.
+ */
+bool io_thread_start(void);
+
+/**
+ * @brief Copies the latest input snapshot of a car. Never blocks on I/O.
+ *
+ * @param car The car index.
+ * @param inputs Receives the snapshot.
+ */
+void io_thread_read_inputs(int car, ElevioInputs* inputs);
+
+/**
+ * @brief Queues an output write for a car.
+ *
+ * Must only be called from the controller thread. The write is sent
+ * after the next io_thread_flush() at the latest, together with all
+ * other writes queued for the car, in a single send.
+ *
+ * @param car The car index.
+ * @param output The write to queue.
+ */
+void io_thread_push(int car, ElevioOutput output);
+
+/**
+ * @brief Wakes the I/O thread if outputs were queued since the last flush.
+ */
+void io_thread_flush(void);
+
+/**
+ * @brief Returns a descriptor that becomes readable when inputs changed.
+ *
+ * Read it (an eventfd counter) to re-arm it.
+ */
+int io_thread_fd(void);
+
+/**
+ * @brief Checks whether all cars are currently connected.
+ */
+bool io_thread_connected(void);
+
+/**
+ * @brief Returns how many times a car's connection was re-established.
+ */
+unsigned io_thread_reconnects(void);
+
+/**
+ * @brief Sets the period at which a polled car's inputs are sampled.
+ *
+ * A shorter period than before applies from now on, not from the next
+ * poll. Subscribed cars are not polled and ignore it.
+ *
+ * @param car The car index.
+ * @param period_ms The period, at least 1 ms.
+ */
+void io_thread_set_sample_period(int car, int period_ms);
+
+/**
+ * @brief Returns how many input samples of a car were taken so far.
+ */
+unsigned io_thread_samples(int car);
+
+#endif
@@ -0,0 +1,147 @@
+/**
+ * @file logger.c
+ * @brief Binary event logger for the control path.
+ *
+ * The ring is a bounded multi-producer queue: each slot carries a
+ * sequence number telling producers whether it is free and the drainer
+ * whether it holds a finished record. Producers claim slots with a
+ * compare-and-swap on the enqueue position; the drainer is the only
+ * consumer.
+ */
+
+#include "logger.h"
+#include "clock.h"
+#include <pthread.h>
+#include <stdatomic.h>
+#include <stdio.h>
+#include <string.h>
+#include <time.h>
+
+/** @brief Number of ring slots; a power of two. */
+#define LOGGER_RING_CAPACITY 4096
+
+/** @brief How often the drainer empties the ring. */
+#define LOGGER_DRAIN_PERIOD_MS 20
+
+typedef struct {
+    atomic_size_t seq;
+    log_record_t record;
+} log_slot_t;
+
+static log_slot_t ring[LOGGER_RING_CAPACITY];
+
+static _Alignas(64) atomic_size_t enqueue_pos;
+static _Alignas(64) size_t dequeue_pos;
+
+static atomic_uint dropped;
+
+/** @brief Set once logger_init() has numbered the slots. */
+static atomic_bool ring_ready = false;
+
+static FILE* file = NULL;
+static pthread_t drainer;
+static atomic_bool running = false;
+
+static void logger_reset_ring(void) {
+    for (size_t i = 0; i < LOGGER_RING_CAPACITY; i++) {
+        atomic_store_explicit(&ring[i].seq, i, memory_order_relaxed);
+    }
+    atomic_store(&enqueue_pos, 0);
+    dequeue_pos = 0;
+    atomic_store(&ring_ready, true);
+}
+
+void logger_write(log_event_t event, const int64_t args[LOG_MAX_ARGS]) {
+    if (!atomic_load_explicit(&ring_ready, memory_order_acquire)) return;
+
+    size_t pos = atomic_load_explicit(&enqueue_pos, memory_order_relaxed);
+    log_slot_t* slot;
+
+    while (1) {
+        slot = &ring[pos & (LOGGER_RING_CAPACITY - 1)];
+        size_t seq = atomic_load_explicit(&slot->seq, memory_order_acquire);
+        intptr_t diff = (intptr_t)seq - (intptr_t)pos;
+
+        if (diff == 0) {
+            if (atomic_compare_exchange_weak_explicit(&enqueue_pos, &pos, pos + 1,
+                                                      memory_order_relaxed, memory_order_relaxed)) {
+                break;
+            }
+        } else if (diff < 0) {
+            atomic_fetch_add_explicit(&dropped, 1, memory_order_relaxed);
+            return;
+        } else {
+            pos = atomic_load_explicit(&enqueue_pos, memory_order_relaxed);
+        }
+    }
+
+    slot->record.time_ns = clock_now_ns();
+    slot->record.event = event;
+    slot->record.reserved = 0;
+    memcpy(slot->record.args, args, sizeof(slot->record.args));
+    atomic_store_explicit(&slot->seq, pos + 1, memory_order_release);
+}
+
+/**
+ * @brief Moves every finished record from the ring to the file.
+ */
+static void logger_drain(void) {
+    unsigned lost = atomic_exchange_explicit(&dropped, 0, memory_order_relaxed);
+    if (lost > 0) {
+        log_record_t note = { .time_ns = clock_now_ns(), .event = LOG_RECORDS_DROPPED, .args = { lost } };
+        fwrite(&note, sizeof(note), 1, file);
+    }
+
+    while (1) {
+        log_slot_t* slot = &ring[dequeue_pos & (LOGGER_RING_CAPACITY - 1)];
+        size_t seq = atomic_load_explicit(&slot->seq, memory_order_acquire);
+        if (seq != dequeue_pos + 1) break;
+
+        fwrite(&slot->record, sizeof(slot->record), 1, file);
+        atomic_store_explicit(&slot->seq, dequeue_pos + LOGGER_RING_CAPACITY, memory_order_release);
+        dequeue_pos++;
+    }
+    fflush(file);
+}
+
+static void* logger_main(void* arg) {
+    (void)arg;
+    struct timespec period = { 0, LOGGER_DRAIN_PERIOD_MS * 1000000L };
+
+    while (atomic_load(&running)) {
+        logger_drain();
+        nanosleep(&period, NULL);
+    }
+    logger_drain();
+    return NULL;
+}
+
+bool logger_init(const char* path) {
+    file = fopen(path, "wb");
+    if (file == NULL) {
+        return false;
+    }
+
+    log_file_header_t header = {
+        .magic = LOG_FILE_MAGIC,
+        .version = LOG_FILE_VERSION,
+        .record_size = sizeof(log_record_t),
+    };
+    fwrite(&header, sizeof(header), 1, file);
+
+    logger_reset_ring();
+    atomic_store(&running, true);
+    if (pthread_create(&drainer, NULL, logger_main, NULL) != 0) {
+        atomic_store(&running, false);
+        return false;
+    }
+    return true;
+}
+
+void logger_shutdown(void) {
+    if (!atomic_exchange(&running, false)) return;
+
+    pthread_join(drainer, NULL);
+    fclose(file);
+    file = NULL;
+}
@@ -0,0 +1,119 @@
+/**
+ * @file logger.h
+ * @brief Binary event logger for the control path.
+ *
+ * LOG() stores a fixed-size record (timestamp, event id, arguments) in a
+ * preallocated lock-free ring and returns; it never blocks and makes no
+ * syscall. A background thread drains the ring to a file, which the
+ * log_decode tool turns into text. If the ring is full the record is
+ * dropped and counted rather than stalling the caller.
+ */
+
+#ifndef LOGGER_H
+#define LOGGER_H
+
+#include <stdbool.h>
+#include <stddef.h>
+#include <stdint.h>
+
+/**
+ * @brief Log events and their text form.
+ *
+ * Besides the printf conversion %d, formats may use %T (OrderType name),
+ * %D (Direction name) and %M (floor mask as a list of floors). Every
+ * conversion consumes one argument.
+ */
+#define LOG_EVENTS(X) \
+    X(LOG_ORDER_ADDED,         "[ORDERS] New order: floor %d, type %T") \
+    X(LOG_ORDER_STATUS,        "[ORDERS] Status: CAB %M HALL_UP %M HALL_DOWN %M") \
+    X(LOG_ORDERS_CLEARED,      "[ORDERS] Cleared orders at floor %d (direction: %D)") \
+    X(LOG_DECISION,            "[DECISION] Floor %d, direction %D -> choosing %D (order on floor %d)") \
+    X(LOG_FSM_TOP_FLOOR,       "[FSM] Car %d reached top floor %d, stopping") \
+    X(LOG_FSM_BOTTOM_FLOOR,    "[FSM] Car %d reached bottom floor %d, stopping") \
+    X(LOG_FSM_EXIT_MOVING_UP,  "[FSM] Car %d STATE: MOVING_UP -> Exiting") \
+    X(LOG_FSM_EXIT_MOVING_DOWN,"[FSM] Car %d STATE: MOVING_DOWN -> Exiting") \
+    X(LOG_GROUP_ASSIGN,        "[GROUP] Hall call floor %d, type %T -> car %d (estimate %d ms)") \
+    X(LOG_CONNECTION_LOST,     "[HW] Lost connection to elevator server") \
+    X(LOG_RECORDS_DROPPED,     "[LOG] %d records dropped, ring full") \
+    X(LOG_DESTINATION_ADDED,   "[ORDERS] New destination call: floor %d to floor %d") \
+    X(LOG_GROUP_DESTINATION,   "[GROUP] Destination call floor %d to floor %d -> car %d (estimate %d ms)") \
+    X(LOG_FSM_PARK,            "[FSM] Car %d idle at floor %d, parking at floor %d") \
+    X(LOG_CONNECTION_RESTORED, "[HW] Reconnected to elevator server, outputs resynced (reconnect %d)")
+
+#define LOG_EVENT_ID(id, format) id,
+typedef enum {
+    LOG_EVENTS(LOG_EVENT_ID)
+    LOG_EVENT_COUNT
+} log_event_t;
+#undef LOG_EVENT_ID
+
+/** @brief Most arguments a record carries. */
+#define LOG_MAX_ARGS 4
+
+/**
+ * @brief One log record, as stored in the ring and in the file.
+ */
+typedef struct {
+    uint64_t time_ns;
+    uint32_t event;
+    uint32_t reserved;
+    int64_t args[LOG_MAX_ARGS];
+} log_record_t;
+
+/**
+ * @brief Header at the start of a log file.
+ */
+typedef struct {
+    char magic[4];
+    uint32_t version;
+    uint32_t record_size;
+    uint32_t reserved;
+} log_file_header_t;
+
+#define LOG_FILE_MAGIC "ELOG"
+#define LOG_FILE_VERSION 1
+
+/** @brief Default log file, relative to the working directory. */
+#define LOG_DEFAULT_PATH "elevator.elog"
+
+/**
+ * @brief Opens the log file and starts the drainer thread.
+ *
+ * @param path The file to write, truncated if it exists.
+ * @return true on success, false otherwise.
+ */
+bool logger_init(const char* path);
+
+/**
+ * @brief Stops the drainer thread after writing out everything logged.
+ */
+void logger_shutdown(void);
+
+/**
+ * @brief Stores one record. Safe to call from any thread.
+ *
+ * Records written before logger_init() are discarded.
+ *
+ * @param event The event id.
+ * @param args LOG_MAX_ARGS arguments; unused ones are ignored.
+ */
+void logger_write(log_event_t event, const int64_t args[LOG_MAX_ARGS]);
+
+/**
+ * @brief Logs an event with up to LOG_MAX_ARGS integer arguments.
+ */
+#define LOG(event, ...) logger_write((event), (const int64_t[LOG_MAX_ARGS]){ __VA_ARGS__ })
+
+/**
+ * @brief Returns the text format of an event, or NULL for an unknown id.
+ */
+static inline const char* logger_format(uint32_t event) {
+#define LOG_EVENT_FORMAT(id, format) case id: return format;
+    switch (event) {
+        LOG_EVENTS(LOG_EVENT_FORMAT)
+        default: return NULL;
+    }
+#undef LOG_EVENT_FORMAT
+}
+
+#endif
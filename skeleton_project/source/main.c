@@ -1,53 +1,106 @@
 #include <stdio.h>
-#include <unistd.h>
 #include <stdbool.h>
 #include "fsm.h"
 #include "elevator_fsm.h"
+#include "group_controller.h"
+#include "hardware_interface.h"
+#include "event_loop.h"
+#include "io_thread.h"
+#include "demand_model.h"
+#include "logger.h"
+#include "order_manager.h"
+#include "register_backend.h"
+#include "stats.h"
+#include <string.h>
 
-// Forward declarations of functions from .c-modules
-bool hardware_interface_init(void);
-void hardware_interface_poll_buttons(void);
-void hardware_interface_update_lights(int current_floor);
-bool hardware_interface_read_stop_button(void);
-bool hardware_interface_read_obstruction(void);
+/**
+ * @brief Hardware backends selectable with --backend.
+ */
+static const struct {
+    const char* name;
+    const hardware_backend_t* backend;
+} backends[] = {
+    { "tcp", &io_thread_backend },
+    { "uring", &io_uring_backend },
+    { "shm", &shm_backend },
+};
 
-void order_manager_init(void);
-void door_control_init(void);
+static const hardware_backend_t* find_backend(const char* name) {
+    for (size_t i = 0; i < sizeof(backends) / sizeof(backends[0]); i++) {
+        if (!strcmp(name, backends[i].name)) return backends[i].backend;
+    }
+    return NULL;
+}
+
+/** @brief The group of cars this process controls. */
+static group_controller_t group;
 
-int main() {
+int main(int argc, char** argv) {
     
-    if (!hardware_interface_init()) {
-        printf("ERROR: Failed to initialize hardware\n");
+    const hardware_backend_t* backend = &io_thread_backend;
+    building_t building = BUILDING_DEFAULT;
+    for (int i = 1; i < argc; i++) {
+        if (!strcmp(argv[i], "--scheduler") && i + 1 < argc &&
+            order_scheduler_parse(argv[i + 1], &building.scheduler)) {
+            i++;
+        } else if (!strcmp(argv[i], "--backend") && i + 1 < argc && find_backend(argv[i + 1])) {
+            backend = find_backend(argv[++i]);
+        } else if (!strcmp(argv[i], "--shm") && i + 1 < argc) {
+            shm_backend_set_name(argv[++i]);
+        } else {
+            printf("Usage: %s [--scheduler baseline|eta-total|eta-worst] "
+                   "[--backend tcp|uring|shm] [--shm name]\n", argv[0]);
+            return 1;
+        }
+    }
+    
+    // First, so that no other thread can receive SIGINT or SIGTERM; stats_init()
+    // blocks SIGUSR1 the same way before it starts its writer
+    if (!event_loop_block_signals()) {
+        printf("ERROR: Failed to block signals\n");
+        return 1;
+    }
+    if (!stats_init(STATS_DEFAULT_PATH, STATS_DEFAULT_PERIOD_MS)) {
+        printf("ERROR: Failed to start statistics\n");
         return 1;
     }
     
-    order_manager_init();
-    door_control_init();
-    elevator_fsm_init();
+    if (!logger_init(LOG_DEFAULT_PATH)) {
+        printf("ERROR: Failed to open log file %s\n", LOG_DEFAULT_PATH);
+        return 1;
+    }
     
-    bool prev_stop_state = false;
+    elevio_traceSetScheduler(order_scheduler_name(building.scheduler));
+    if (!hardware_interface_init(backend, &building)) {
+        printf("ERROR: Failed to initialize hardware\n");
+        return 1;
+    }
     
-    while (1) {
-        hardware_interface_poll_buttons();
-        
-        bool stop_pressed = hardware_interface_read_stop_button();
-        if (stop_pressed && !prev_stop_state) {
-            fsm_dispatch(EVENT_STOP_PRESSED);
-        } else if (!stop_pressed && prev_stop_state) {
-            fsm_dispatch(EVENT_STOP_RELEASED);
-        }
-        prev_stop_state = stop_pressed;
-        
-        if (hardware_interface_read_obstruction()) {
-            fsm_dispatch(EVENT_OBSTRUCTION);
+    if (!demand_model_init(group_controller_demand(&group), &building, DEMAND_DEFAULT_PATH,
+                           DEMAND_WALL_CLOCK)) {
+        printf("WARNING: Ignoring unusable demand model %s\n", DEMAND_DEFAULT_PATH);
+    }
+    
+    // Where idle cars park depends on the model, so a replay needs it as it was
+    if (elevio_tracePath() != NULL) {
+        char snapshot[256];
+        snprintf(snapshot, sizeof(snapshot), "%s%s", elevio_tracePath(), DEMAND_TRACE_SUFFIX);
+        if (!demand_model_save_as(group_controller_demand(&group), snapshot)) {
+            printf("WARNING: Failed to save demand model snapshot %s\n", snapshot);
         }
-        
-        fsm_dispatch(EVENT_TICK);
-        
-        hardware_interface_update_lights(current_floor);
-        
-        usleep(100000); // 100ms delay
     }
     
+    group_controller_init(&group, backend, &building);
+    
+    if (!event_loop_init(&group)) {
+        printf("ERROR: Failed to initialize event loop\n");
+        return 1;
+    }
+    
+    event_loop_run(&group);
+    
+    demand_model_shutdown(group_controller_demand(&group));
+    stats_shutdown();
+    logger_shutdown();
     return 0;
-}
\ No newline at end of file
+}
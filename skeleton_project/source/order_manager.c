@@ -6,90 +6,356 @@
  * adding, clearing, and querying orders to determine elevator behavior.
  */
 
-#include "elevator_types.h"
+#include "order_manager.h"
+#include "clock.h"
+#include "demand_model.h"
+#include "door_control.h"
+#include "logger.h"
+#include "stats.h"
 #include <stdbool.h>
-#include <stdio.h>
+#include <stdint.h>
+#include <string.h>
 
-/** @brief Cab button orders for each floor. */
-static bool cab_orders[N_FLOORS];
+_Static_assert(N_FLOORS_MAX <= 64, "order masks hold at most 64 floors");
 
-/** @brief Hall up button orders (floors 0 to N_FLOORS-2). */
-static bool hall_up_orders[N_FLOORS - 1];
+/** @brief Bit for a single floor. */
+static inline uint64_t floor_bit(int floor) {
+    return (uint64_t)1 << floor;
+}
 
-/** @brief Hall down button orders (floors 1 to N_FLOORS-1, indexed as 0 to N_FLOORS-2). */
-static bool hall_down_orders[N_FLOORS - 1];
+/** @brief Mask of all floors strictly above the given floor. */
+static inline uint64_t floors_above(int floor) {
+    if (floor < 0) return ~(uint64_t)0;
+    if (floor >= 63) return 0;
+    return ~(uint64_t)0 << (floor + 1);
+}
 
-/**
- * @brief Prints current order status to console.
- *
- * Displays all active orders for debugging purposes.
- */
-static void order_manager_print_status(void) {
-    printf("\n[ORDERS] --------- ORDER STATUS --------\n");
-    printf("[ORDERS] CAB:       ");
-    for (int i = 0; i < N_FLOORS; i++) {
-        printf("%d:%s ", i, cab_orders[i] ? "X" : "-");
-    }
-    printf("\n[ORDERS] HALL_UP:   ");
-    for (int i = 0; i < N_FLOORS - 1; i++) {
-        printf("%d:%s ", i, hall_up_orders[i] ? "X" : "-");
-    }
-    printf("\n[ORDERS] HALL_DOWN: ");
-    for (int i = 0; i < N_FLOORS - 1; i++) {
-        printf("%d:%s ", i + 1, hall_down_orders[i] ? "X" : "-");
-    }
-    printf("\n");
+/** @brief Mask of all floors strictly below the given floor. */
+static inline uint64_t floors_below(int floor) {
+    if (floor <= 0) return 0;
+    if (floor >= 64) return ~(uint64_t)0;
+    return floor_bit(floor) - 1;
 }
 
-/**
- * @brief Initializes the order manager.
- *
- * Clears all orders from all floors.
- */
-void order_manager_init(void) {
-    for (int i = 0; i < N_FLOORS; i++) {
-        cab_orders[i] = false;
-    }
-    for (int i = 0; i < N_FLOORS - 1; i++) {
-        hall_up_orders[i] = false;
-        hall_down_orders[i] = false;
+/** @brief Mask of floors with any order in a table. */
+static inline uint64_t all_orders(const order_table_t* table) {
+    return table->cab | table->hall_up | table->hall_down;
+}
+
+/** @brief Mask of floors beyond the given floor in a direction. */
+static inline uint64_t floors_ahead(int floor, Direction direction) {
+    if (direction == DIR_UP) return floors_above(floor);
+    if (direction == DIR_DOWN) return floors_below(floor);
+    return 0;
+}
+
+static const char* const scheduler_names[] = {
+    [ORDER_SCHEDULER_BASELINE] = "baseline",
+    [ORDER_SCHEDULER_ETA_TOTAL] = "eta-total",
+    [ORDER_SCHEDULER_ETA_WORST] = "eta-worst",
+};
+
+bool order_scheduler_parse(const char* name, order_scheduler_t* parsed) {
+    for (int i = 0; i < (int)(sizeof(scheduler_names) / sizeof(scheduler_names[0])); i++) {
+        if (strcmp(name, scheduler_names[i]) == 0) {
+            *parsed = (order_scheduler_t)i;
+            return true;
+        }
     }
+    return false;
+}
+
+const char* order_scheduler_name(order_scheduler_t selected) {
+    return scheduler_names[selected];
 }
 
 /**
- * @brief Adds a new order.
+ * @brief Checks whether a car going in a direction turns around at a floor.
  *
- * @param floor The floor number (0 to N_FLOORS-1).
- * @param type The order type (CAB, HALL_UP, or HALL_DOWN).
+ * Only ETA schedulers turn at the last order; the baseline runs on to an
+ * end floor or goes idle first.
  */
-void order_manager_add_order(int floor, OrderType type) {
-    if (!is_valid_floor(floor)) return;
+static inline bool turns_at(const building_t* building, const order_table_t* table, int floor,
+                            Direction direction) {
+    return building->scheduler != ORDER_SCHEDULER_BASELINE && direction != DIR_STOP &&
+           (all_orders(table) & floors_ahead(floor, direction)) == 0;
+}
+
+bool order_table_add(const building_t* building, order_table_t* table, int floor, OrderType type) {
+    if (!is_valid_floor(building, floor)) return false;
 
+    uint64_t bit = floor_bit(floor);
     bool was_set = false;
     switch (type) {
         case ORDER_TYPE_CAB:
-            if (!cab_orders[floor]) was_set = true;
-            cab_orders[floor] = true;
+            if (!(table->cab & bit)) was_set = true;
+            table->cab |= bit;
             break;
 
         case ORDER_TYPE_HALL_UP:
-            if (floor < N_FLOORS - 1) {
-                if (!hall_up_orders[floor]) was_set = true;
-                hall_up_orders[floor] = true;
+            if (floor < building->n_floors - 1) {
+                if (!(table->hall_up & bit)) was_set = true;
+                table->hall_up |= bit;
             }
             break;
 
         case ORDER_TYPE_HALL_DOWN:
-            if (floor > 0 && floor < N_FLOORS) {
-                if (!hall_down_orders[floor - 1]) was_set = true;
-                hall_down_orders[floor - 1] = true;
+            if (floor > 0) {
+                if (!(table->hall_down & bit)) was_set = true;
+                table->hall_down |= bit;
             }
             break;
     }
+    return was_set;
+}
+
+bool order_table_has_order(const building_t* building, const order_table_t* table, int floor,
+                           OrderType type) {
+    if (!is_valid_floor(building, floor)) return false;
+
+    uint64_t bit = floor_bit(floor);
+    switch (type) {
+        case ORDER_TYPE_CAB: return (table->cab & bit) != 0;
+        case ORDER_TYPE_HALL_UP: return (table->hall_up & bit) != 0;
+        case ORDER_TYPE_HALL_DOWN: return (table->hall_down & bit) != 0;
+        default: return false;
+    }
+}
+
+/**
+ * @brief Turns the destination calls going one way from a floor into cab orders.
+ */
+static inline void pick_up(order_table_t* table, int floor, Direction direction) {
+    uint64_t boarding = table->destinations[floor] & floors_ahead(floor, direction);
+    table->destinations[floor] &= ~boarding;
+    table->cab |= boarding;
+}
+
+void order_table_clear_at_floor(const building_t* building, order_table_t* table, int floor,
+                                Direction direction) {
+    if (!is_valid_floor(building, floor)) return;
+
+    uint64_t bit = floor_bit(floor);
+    table->cab &= ~bit;
+
+    if (direction == DIR_UP) {
+        table->hall_up &= ~bit;
+        pick_up(table, floor, DIR_UP);
+    }
+    if (direction == DIR_DOWN) {
+        table->hall_down &= ~bit;
+        pick_up(table, floor, DIR_DOWN);
+    }
+    if (turns_at(building, table, floor, direction)) {
+        table->hall_up &= ~bit;
+        table->hall_down &= ~bit;
+        pick_up(table, floor, direction_opposite(direction));
+    }
+}
+
+/** @brief Hall order type serving a destination call. */
+static inline OrderType destination_hall_type(destination_call_t call) {
+    return call.destination > call.origin ? ORDER_TYPE_HALL_UP : ORDER_TYPE_HALL_DOWN;
+}
+
+bool order_table_add_destination(const building_t* building, order_table_t* table,
+                                 destination_call_t call) {
+    if (!is_valid_floor(building, call.origin) || !is_valid_floor(building, call.destination) ||
+        call.origin == call.destination) {
+        return false;
+    }
+
+    bool was_set = !order_table_has_destination(building, table, call);
+    table->destinations[call.origin] |= floor_bit(call.destination);
+    order_table_add(building, table, call.origin, destination_hall_type(call));
+    return was_set;
+}
+
+bool order_table_has_destination(const building_t* building, const order_table_t* table,
+                                 destination_call_t call) {
+    if (!is_valid_floor(building, call.origin) || !is_valid_floor(building, call.destination)) {
+        return false;
+    }
+    return (table->destinations[call.origin] & floor_bit(call.destination)) != 0;
+}
+
+bool order_table_has_orders(const order_table_t* table) {
+    return all_orders(table) != 0;
+}
+
+bool order_table_should_stop(const building_t* building, const order_table_t* table, int floor,
+                             Direction direction) {
+    if (!is_valid_floor(building, floor)) return false;
+
+    uint64_t bit = floor_bit(floor);
+    if (table->cab & bit) return true;
+
+    if (direction == DIR_UP && (table->hall_up & bit)) return true;
+    if (direction == DIR_DOWN && (table->hall_down & bit)) return true;
+
+    return (all_orders(table) & bit) && turns_at(building, table, floor, direction);
+}
+
+/**
+ * @brief Estimated service times of one sweep plan.
+ */
+typedef struct {
+    int64_t total_ms;
+    int worst_ms;
+    int first_stop;
+} sweep_t;
+
+/**
+ * @brief Simulates a stopped car serving every order of a table.
+ *
+ * The car starts at a floor heading in the given direction, stops and
+ * turns as order_table_should_stop() and order_table_clear_at_floor()
+ * say, and spends the building's floor_travel_ms per floor and
+ * DOOR_OPEN_DURATION_MS per stop. An order's service time is when the
+ * door opens for it.
+ */
+static sweep_t simulate_sweep(const building_t* building, order_table_t table, int floor,
+                              Direction direction) {
+    sweep_t sweep = { 0, 0, -1 };
+    int t = 0;
+
+    // Every pass either moves, turns or clears the last orders
+    for (int step = 0; step < 4 * building->n_floors + 4 && order_table_has_orders(&table); step++) {
+        if (order_table_should_stop(building, &table, floor, direction)) {
+            uint64_t bit = floor_bit(floor);
+            int before = !!(table.cab & bit) + !!(table.hall_up & bit) + !!(table.hall_down & bit);
+            order_table_clear_at_floor(building, &table, floor, direction);
+            int served = before - !!(table.cab & bit) - !!(table.hall_up & bit) - !!(table.hall_down & bit);
+
+            sweep.total_ms += (int64_t)served * t;
+            if (t > sweep.worst_ms) sweep.worst_ms = t;
+            if (sweep.first_stop == -1) sweep.first_stop = floor;
+            t += DOOR_OPEN_DURATION_MS;
+        }
+
+        uint64_t pending = all_orders(&table);
+        if (pending & floors_ahead(floor, direction)) {
+            floor += direction;
+            t += building->floor_travel_ms;
+        } else if (pending & floors_ahead(floor, direction_opposite(direction))) {
+            direction = direction_opposite(direction);
+        } else if (pending) {
+            // Only opposite calls left here, which a sweep in this direction turns for
+            direction = direction_opposite(direction);
+        }
+    }
+    return sweep;
+}
+
+/**
+ * @brief Chooses a stopped car's next direction by comparing both sweeps.
+ */
+static Direction eta_next_direction(const building_t* building, const order_table_t* table,
+                                    int current_floor, int* target_floor) {
+    sweep_t up = simulate_sweep(building, *table, current_floor, DIR_UP);
+    sweep_t down = simulate_sweep(building, *table, current_floor, DIR_DOWN);
+
+    bool prefer_down;
+    if (building->scheduler == ORDER_SCHEDULER_ETA_WORST) {
+        prefer_down = down.worst_ms < up.worst_ms ||
+                      (down.worst_ms == up.worst_ms && down.total_ms < up.total_ms);
+    } else {
+        prefer_down = down.total_ms < up.total_ms ||
+                      (down.total_ms == up.total_ms && down.worst_ms < up.worst_ms);
+    }
+
+    const sweep_t* best = prefer_down ? &down : &up;
+    if (best->first_stop == -1) return DIR_STOP;
+    if (target_floor) *target_floor = best->first_stop;
+    if (best->first_stop > current_floor) return DIR_UP;
+    if (best->first_stop < current_floor) return DIR_DOWN;
+    return DIR_STOP;
+}
+
+Direction order_table_next_direction(const building_t* building, const order_table_t* table,
+                                     int current_floor, Direction current_direction,
+                                     int* target_floor) {
+    if (building->scheduler != ORDER_SCHEDULER_BASELINE && current_direction == DIR_STOP &&
+        is_valid_floor(building, current_floor) && order_table_has_orders(table)) {
+        return eta_next_direction(building, table, current_floor, target_floor);
+    }
+
+    uint64_t pending = all_orders(table);
+
+    if (current_direction == DIR_UP || current_direction == DIR_STOP) {
+        uint64_t ahead = pending & floors_above(current_floor);
+        if (ahead) {
+            if (target_floor) *target_floor = __builtin_ctzll(ahead);
+            return DIR_UP;
+        }
+    }
+
+    if (current_direction == DIR_DOWN || current_direction == DIR_STOP) {
+        uint64_t behind = pending & floors_below(current_floor);
+        if (behind) {
+            if (target_floor) *target_floor = 63 - __builtin_clzll(behind);
+            return DIR_DOWN;
+        }
+    }
+
+    return DIR_STOP;
+}
+
+/**
+ * @brief Initializes an order table.
+ *
+ * Clears all orders from all floors.
+ *
+ * @param orders The order table.
+ */
+void order_manager_init(order_table_t* orders) {
+    *orders = (order_table_t){0};
+}
 
-    if (was_set) {
-        printf("[ORDERS] New order: floor %d, type %s\n", floor, order_type_to_string(type));
-        order_manager_print_status();
+/**
+ * @brief Adds a new order.
+ *
+ * New hall calls also feed the demand model.
+ *
+ * @param building The building of the car.
+ * @param orders The order table.
+ * @param floor The floor number (0 to n_floors-1).
+ * @param type The order type (CAB, HALL_UP, or HALL_DOWN).
+ */
+void order_manager_add_order(const building_t* building, order_table_t* orders, int floor,
+                             OrderType type) {
+    if (order_table_add(building, orders, floor, type)) {
+        if (orders->stamps) {
+            orders->stamps->added_ns[floor][type] = clock_now_ns();
+        }
+        if (type != ORDER_TYPE_CAB && orders->demand) {
+            demand_model_record_call(orders->demand, floor);
+        }
+        LOG(LOG_ORDER_ADDED, floor, type);
+        LOG(LOG_ORDER_STATUS, orders->cab, orders->hall_up, orders->hall_down);
+    }
+}
+
+/**
+ * @brief Adds a destination call.
+ *
+ * @param building The building of the car.
+ * @param orders The order table.
+ * @param call The origin and destination keyed in by the passenger.
+ */
+void order_manager_add_destination(const building_t* building, order_table_t* orders,
+                                   destination_call_t call) {
+    bool hall_was_set = order_table_has_order(building, orders, call.origin, destination_hall_type(call));
+
+    if (order_table_add_destination(building, orders, call)) {
+        if (orders->demand) {
+            demand_model_record_call(orders->demand, call.origin);
+        }
+        if (orders->stamps && !hall_was_set) {
+            orders->stamps->added_ns[call.origin][destination_hall_type(call)] = clock_now_ns();
+        }
+        LOG(LOG_DESTINATION_ADDED, call.origin, call.destination);
+        LOG(LOG_ORDER_STATUS, orders->cab, orders->hall_up, orders->hall_down);
     }
 }
 
@@ -97,105 +363,94 @@ void order_manager_add_order(int floor, OrderType type) {
  * @brief Clears orders at a specific floor.
  *
  * Clears the cab order and the hall order matching the current direction.
+ * Called as the door opens, so the latency of every order it clears is
+ * recorded here.
  *
+ * @param building The building of the car.
+ * @param orders The order table.
  * @param floor The floor number.
  * @param direction The current elevator direction.
  */
-void order_manager_clear_orders_at_floor(int floor, Direction direction) {
-    if (!is_valid_floor(floor)) return;
+void order_manager_clear_orders_at_floor(const building_t* building, order_table_t* orders,
+                                         int floor, Direction direction) {
+    if (!is_valid_floor(building, floor)) return;
 
-    cab_orders[floor] = false;
+    uint64_t cab_before = orders->cab;
+    uint64_t present_before[N_ORDER_TYPES] = {
+        [ORDER_TYPE_HALL_UP] = orders->hall_up & floor_bit(floor),
+        [ORDER_TYPE_HALL_DOWN] = orders->hall_down & floor_bit(floor),
+        [ORDER_TYPE_CAB] = cab_before & floor_bit(floor),
+    };
+    order_table_clear_at_floor(building, orders, floor, direction);
 
-    if (direction == DIR_UP && floor < N_FLOORS - 1) {
-        hall_up_orders[floor] = false;
-    }
-    if (direction == DIR_DOWN && floor > 0) {
-        hall_down_orders[floor - 1] = false;
+    if (orders->stamps) {
+        uint64_t now = clock_now_ns();
+        for (int type = 0; type < N_ORDER_TYPES; type++) {
+            if (present_before[type] && !order_table_has_order(building, orders, floor, (OrderType)type)) {
+                stats_order_served((OrderType)type, floor, orders->stamps->added_ns[floor][type],
+                                   orders->stamps->arrival_ns, now);
+            }
+        }
+
+        // Destination passengers picked up here now ride on cab orders
+        for (uint64_t boarded = orders->cab & ~cab_before; boarded; boarded &= boarded - 1) {
+            orders->stamps->added_ns[__builtin_ctzll(boarded)][ORDER_TYPE_CAB] = now;
+        }
     }
 
-    printf("Cleared orders at floor %d (direction: %s)\n",
-           floor, direction_to_string(direction));
+    LOG(LOG_ORDERS_CLEARED, floor, direction);
 }
 
 /**
  * @brief Checks if there are any pending orders.
  *
+ * @param orders The order table.
  * @return true if there are orders, false otherwise.
  */
-bool order_manager_has_orders(void) {
-    for (int i = 0; i < N_FLOORS; i++) {
-        if (cab_orders[i]) return true;
-    }
-    for (int i = 0; i < N_FLOORS - 1; i++) {
-        if (hall_up_orders[i]) return true;
-        if (hall_down_orders[i]) return true;
-    }
-    return false;
+bool order_manager_has_orders(const order_table_t* orders) {
+    return order_table_has_orders(orders);
 }
 
 /**
  * @brief Determines if the elevator should stop at a floor.
  *
+ * @param building The building of the car.
+ * @param orders The order table.
  * @param floor The floor to check.
  * @param direction The current movement direction.
  * @return true if the elevator should stop, false otherwise.
  */
-bool order_manager_should_stop(int floor, Direction direction) {
-    if (!is_valid_floor(floor)) return false;
-
-    if (cab_orders[floor]) return true;
-
-    if (direction == DIR_UP && floor < N_FLOORS - 1) {
-        if (hall_up_orders[floor]) return true;
-    }
-    if (direction == DIR_DOWN && floor > 0) {
-        if (hall_down_orders[floor - 1]) return true;
-    }
-
-    return false;
+bool order_manager_should_stop(const building_t* building, const order_table_t* orders, int floor,
+                               Direction direction) {
+    return order_table_should_stop(building, orders, floor, direction);
 }
 
 /**
  * @brief Determines the next direction based on current position and orders.
  *
- * Implements a simple elevator algorithm: continue in current direction
- * if there are orders ahead, otherwise reverse or stop.
+ * The building's scheduler decides. The baseline keeps going while there
+ * are orders ahead, else turns for orders behind. The ETA schedulers
+ * simulate serving every order going up first and going down first, and
+ * head for the first stop of the sweep with the lower total or worst-case
+ * service time. A decision to move is logged with its target floor.
  *
+ * @param building The building of the car.
+ * @param orders The order table.
  * @param current_floor The current floor position.
  * @param current_direction The current movement direction.
- * @return The next direction to move (DIR_UP, DIR_DOWN, or DIR_STOP).
+ * @return The next direction to move (DIR_UP, DIR_DOWN, or DIR_STOP). Under
+ *         an ETA scheduler DIR_STOP with orders pending means the best
+ *         first stop is the current floor.
  */
-Direction order_manager_get_next_direction(int current_floor, Direction current_direction) {
-    Direction result = DIR_STOP;
+Direction order_manager_get_next_direction(const building_t* building, const order_table_t* orders,
+                                           int current_floor, Direction current_direction) {
+    int target = -1;
+    Direction result = order_table_next_direction(building, orders, current_floor, current_direction,
+                                                  &target);
 
-    if (current_direction == DIR_UP || current_direction == DIR_STOP) {
-        for (int f = current_floor + 1; f < N_FLOORS; f++) {
-            bool has_hall_up = (f < N_FLOORS - 1) && hall_up_orders[f];
-            bool has_hall_down = (f > 0) && hall_down_orders[f - 1];
-            if (cab_orders[f] || has_hall_up || has_hall_down) {
-                result = DIR_UP;
-                printf("[DECISION] Floor %d, direction %s -> choosing %s (order on floor %d)\n",
-                       current_floor, direction_to_string(current_direction),
-                       direction_to_string(result), f);
-                return result;
-            }
-        }
+    if (result != DIR_STOP) {
+        LOG(LOG_DECISION, current_floor, current_direction, result, target);
     }
-
-    if (current_direction == DIR_DOWN || current_direction == DIR_STOP) {
-        for (int f = current_floor - 1; f >= 0; f--) {
-            bool has_hall_up = (f < N_FLOORS - 1) && hall_up_orders[f];
-            bool has_hall_down = (f > 0) && hall_down_orders[f - 1];
-            if (cab_orders[f] || has_hall_up || has_hall_down) {
-                result = DIR_DOWN;
-                printf("[DECISION] Floor %d, direction %s -> choosing %s (order on floor %d)\n",
-                       current_floor, direction_to_string(current_direction),
-                       direction_to_string(result), f);
-                return result;
-            }
-        }
-    }
-
     return result;
 }
 
@@ -203,37 +458,44 @@ Direction order_manager_get_next_direction(int current_floor, Direction current_
  * @brief Clears all orders.
  *
  * Used during emergency stop to reset all pending orders.
+ *
+ * @param orders The order table.
  */
-void order_manager_clear_all_orders(void) {
-    order_manager_init();
+void order_manager_clear_all_orders(order_table_t* orders) {
+    *orders = (order_table_t){ .stamps = orders->stamps, .demand = orders->demand };
 }
 
 /**
  * @brief Checks if there are orders above a given floor.
  *
+ * @param orders The order table.
  * @param floor The reference floor.
  * @return true if there are orders above, false otherwise.
  */
-bool order_manager_has_orders_above(int floor) {
-    for (int f = floor + 1; f < N_FLOORS; f++) {
-        if (cab_orders[f]) return true;
-        if (f < N_FLOORS - 1 && hall_up_orders[f]) return true;
-        if (f > 0 && hall_down_orders[f - 1]) return true;
-    }
-    return false;
+bool order_manager_has_orders_above(const order_table_t* orders, int floor) {
+    return (all_orders(orders) & floors_above(floor)) != 0;
 }
 
 /**
  * @brief Checks if there are orders below a given floor.
  *
+ * @param orders The order table.
  * @param floor The reference floor.
  * @return true if there are orders below, false otherwise.
  */
-bool order_manager_has_orders_below(int floor) {
-    for (int f = 0; f < floor; f++) {
-        if (cab_orders[f]) return true;
-        if (f < N_FLOORS - 1 && hall_up_orders[f]) return true;
-        if (f > 0 && hall_down_orders[f - 1]) return true;
+bool order_manager_has_orders_below(const order_table_t* orders, int floor) {
+    return (all_orders(orders) & floors_below(floor)) != 0;
+}
+
+/**
+ * @brief Records that the car has just reached a new floor.
+ *
+ * The time is what press-to-arrival latencies are measured against.
+ *
+ * @param orders The car's order table.
+ */
+void order_manager_note_arrival(order_table_t* orders) {
+    if (orders->stamps) {
+        orders->stamps->arrival_ns = clock_now_ns();
     }
-    return false;
 }
@@ -0,0 +1,167 @@
+/**
+ * @file order_manager.h
+ * @brief Order table type and table-level order queries.
+ *
+ * Every elevator owns an order_table_t. The order_table_* functions are
+ * the silent queries used for planning, which lets the group controller
+ * evaluate hypothetical order sets on copies; the order_manager_*
+ * functions are what the FSM calls and also log their decisions.
+ *
+ * Queries that depend on the building take the car's building_t. Its
+ * size bounds the floors, and its scheduler decides which floor a car
+ * heads for and where it stops. The baseline takes the nearest order
+ * ahead, else behind; the ETA schedulers simulate serving every pending
+ * order going up first and going down first, with travel and door times,
+ * and take the sweep with the lower total or worst-case service time.
+ *
+ * Destination calls sit beside the hall and cab orders. A destination
+ * call holds the hall order of its direction at the origin, so every
+ * scheduler stops there as for a hall call; clearing that hall order
+ * picks the passengers up and turns their destinations into cab orders.
+ */
+
+#ifndef ORDER_MANAGER_H
+#define ORDER_MANAGER_H
+
+#include <stdbool.h>
+#include <stdint.h>
+#include "demand_model.h"
+#include "elevator_types.h"
+
+/**
+ * @brief When a car's orders were accepted and when it last reached a floor.
+ */
+typedef struct {
+    uint64_t added_ns[N_FLOORS_MAX][N_ORDER_TYPES];
+    uint64_t arrival_ns;
+} order_stamps_t;
+
+/**
+ * @brief Orders for one car, one bit per floor and order type.
+ */
+typedef struct {
+    uint64_t cab;
+    uint64_t hall_up;
+    uint64_t hall_down;
+
+    /**
+     * @brief Destinations keyed at each floor by passengers not yet picked up.
+     *
+     * Bit d of destinations[f] is a destination call from floor f to floor d.
+     */
+    uint64_t destinations[N_FLOORS_MAX];
+
+    /**
+     * @brief Timestamps kept by the order_manager_* functions, or NULL.
+     *
+     * Only a car's own table has them; copies made for planning and lamp
+     * tables leave them alone.
+     */
+    order_stamps_t* stamps;
+
+    /** @brief Model the order_manager_* functions feed new hall calls to, or NULL. */
+    demand_model_t* demand;
+} order_table_t;
+
+/**
+ * @brief Looks up a scheduler by name ("baseline", "eta-total" or "eta-worst").
+ *
+ * @return true if the name is known.
+ */
+bool order_scheduler_parse(const char* name, order_scheduler_t* scheduler);
+
+/**
+ * @brief Returns the name of a scheduler.
+ */
+const char* order_scheduler_name(order_scheduler_t scheduler);
+
+/**
+ * @brief Adds an order to a table.
+ *
+ * @param building The building of the table's car.
+ * @param table The table to modify.
+ * @param floor The floor number (0 to n_floors-1).
+ * @param type The order type.
+ * @return true if the order was not already present.
+ */
+bool order_table_add(const building_t* building, order_table_t* table, int floor, OrderType type);
+
+/**
+ * @brief Checks whether a table holds a specific order.
+ */
+bool order_table_has_order(const building_t* building, const order_table_t* table, int floor,
+                           OrderType type);
+
+/**
+ * @brief Adds a destination call and the hall order of its direction.
+ *
+ * @return true if the call was not already present.
+ */
+bool order_table_add_destination(const building_t* building, order_table_t* table,
+                                 destination_call_t call);
+
+/**
+ * @brief Checks whether a table holds a destination call not yet picked up.
+ */
+bool order_table_has_destination(const building_t* building, const order_table_t* table,
+                                 destination_call_t call);
+
+/**
+ * @brief Clears the cab order and the hall order matching the direction.
+ *
+ * Under an ETA scheduler a car that has no orders left beyond the floor
+ * turns around there, so the opposite hall order is cleared as well.
+ * Destination calls whose hall order is cleared become cab orders.
+ */
+void order_table_clear_at_floor(const building_t* building, order_table_t* table, int floor,
+                                Direction direction);
+
+/**
+ * @brief Checks if a table holds any order.
+ */
+bool order_table_has_orders(const order_table_t* table);
+
+/**
+ * @brief Determines if a car with this table should stop at a floor.
+ *
+ * Under an ETA scheduler a car also stops for an opposite hall call at
+ * the last floor with orders in its direction.
+ */
+bool order_table_should_stop(const building_t* building, const order_table_t* table, int floor,
+                             Direction direction);
+
+/**
+ * @brief Determines the next direction for a car with this table.
+ *
+ * @param building The building of the table's car.
+ * @param table The table to query.
+ * @param current_floor The car's floor.
+ * @param current_direction The car's direction.
+ * @param target_floor Set to the nearest order floor in the chosen direction
+ *                     (the first stop, under an ETA scheduler), may be NULL.
+ * @return The next direction (DIR_UP, DIR_DOWN, or DIR_STOP). Under an ETA
+ *         scheduler a stopped car may get DIR_STOP with orders pending,
+ *         meaning its best first stop is the floor it is at.
+ */
+Direction order_table_next_direction(const building_t* building, const order_table_t* table,
+                                     int current_floor, Direction current_direction,
+                                     int* target_floor);
+
+void order_manager_init(order_table_t* orders);
+void order_manager_add_order(const building_t* building, order_table_t* orders, int floor,
+                             OrderType type);
+void order_manager_add_destination(const building_t* building, order_table_t* orders,
+                                   destination_call_t call);
+void order_manager_clear_orders_at_floor(const building_t* building, order_table_t* orders,
+                                         int floor, Direction direction);
+bool order_manager_has_orders(const order_table_t* orders);
+bool order_manager_should_stop(const building_t* building, const order_table_t* orders, int floor,
+                               Direction direction);
+Direction order_manager_get_next_direction(const building_t* building, const order_table_t* orders,
+                                           int current_floor, Direction current_direction);
+void order_manager_clear_all_orders(order_table_t* orders);
+bool order_manager_has_orders_above(const order_table_t* orders, int floor);
+bool order_manager_has_orders_below(const order_table_t* orders, int floor);
+void order_manager_note_arrival(order_table_t* orders);
+
+#endif
@@ -0,0 +1,275 @@
+/**
+ * @file register_backend.c
+ * @brief Hardware backends on a register file: in-process and shared memory.
+ */
+
+#include "register_backend.h"
+#include "clock.h"
+#include <errno.h>
+#include <fcntl.h>
+#include <pthread.h>
+#include <signal.h>
+#include <stdatomic.h>
+#include <stdio.h>
+#include <sys/eventfd.h>
+#include <sys/mman.h>
+#include <sys/stat.h>
+#include <unistd.h>
+
+static register_file_t memory_registers;
+static char shm_name[256] = REGISTER_FILE_DEFAULT_SHM;
+
+/** @brief Register file of the started backend. */
+static register_file_t* registers = NULL;
+
+/** @brief Whether the device is another process whose liveness must be watched. */
+static bool remote_device;
+
+/** @brief Inode of the shared memory object the started backend mapped. */
+static ino_t shm_ino;
+
+/** @brief Building the backend started with, which a restarted device must match. */
+static uint32_t device_floors;
+static uint32_t device_cars;
+
+/** @brief Signals the controller that inputs changed or the device was lost. */
+static int notify_fd = -1;
+
+/** @brief Set by the controller thread on a write, cleared on flush. */
+static bool outputs_pending = false;
+
+static atomic_bool connected = true;
+
+/** @brief Bumped by the watcher each time the device came back. */
+static atomic_uint reconnects = 0;
+
+/**
+ * @brief Register file of a restarted device that the watcher mapped,
+ *        until the controller thread takes it up in place of its own.
+ */
+static _Atomic(register_file_t*) remapped = NULL;
+
+static pthread_t watcher;
+
+static void signal_fd(int fd) {
+    uint64_t one = 1;
+    ssize_t written = write(fd, &one, sizeof(one));
+    (void)written;
+}
+
+/**
+ * @brief Maps the shared register file unless it is the object with inode
+ *        skip_ino.
+ *
+ * @param ino Set to the inode of the shared memory object, if it exists.
+ * @return The mapping, or MAP_FAILED.
+ */
+static void* shm_map(ino_t skip_ino, ino_t* ino) {
+    int fd = shm_open(shm_name, O_RDWR, 0);
+    if (fd == -1) return MAP_FAILED;
+
+    struct stat st;
+    void* map = MAP_FAILED;
+    if (fstat(fd, &st) == 0 && st.st_ino != skip_ino &&
+        (size_t)st.st_size >= sizeof(register_file_t)) {
+        *ino = st.st_ino;
+        map = mmap(NULL, sizeof(register_file_t), PROT_READ | PROT_WRITE, MAP_SHARED, fd, 0);
+    }
+    close(fd);
+    return map;
+}
+
+/**
+ * @brief Whether a register file is that of a running device with the
+ *        building the controller was started on.
+ */
+static bool device_running(const register_file_t* rf) {
+    return register_file_valid(rf) &&
+           rf->num_floors == device_floors && rf->num_cars == device_cars &&
+           !(kill(rf->device_pid, 0) == -1 && errno == ESRCH);
+}
+
+/**
+ * @brief Checks on the device behind the watched register file.
+ *
+ * A device that restarts either creates the shared memory object anew,
+ * which is mapped here and handed to the controller thread, or
+ * reinitializes the one already mapped under its new process id. Once it
+ * runs a reconnection is counted, so the controller writes all outputs
+ * again.
+ *
+ * @param rf The watched register file; replaced by a new mapping.
+ * @param pid Process id of the device last seen running.
+ * @return true if the device came back, and with it a new input epoch.
+ */
+static bool check_device(register_file_t** rf, pid_t* pid) {
+    ino_t ino;
+    register_file_t* next = shm_map(shm_ino, &ino);
+    if (next != MAP_FAILED && device_running(next)) {
+        register_file_t* stale = atomic_exchange(&remapped, next);
+        if (stale != NULL) munmap(stale, sizeof(register_file_t));
+        *rf = next;
+        shm_ino = ino;
+    } else {
+        if (next != MAP_FAILED) munmap(next, sizeof(register_file_t));
+        if (!device_running(*rf)) {
+            if (atomic_exchange(&connected, false)) signal_fd(notify_fd);
+            return false;
+        }
+        if ((*rf)->device_pid == *pid) return false;
+    }
+
+    *pid = (*rf)->device_pid;
+    atomic_fetch_add(&reconnects, 1);
+    atomic_store(&connected, true);
+    return true;
+}
+
+static void* watcher_main(void* arg) {
+    (void)arg;
+    register_file_t* rf = registers;
+    pid_t pid = rf->device_pid;
+    unsigned seen = atomic_load(&rf->input_epoch.value);
+    uint64_t checked_ns = clock_wall_ns();
+
+    while (1) {
+        unsigned now = register_file_wait(&rf->input_epoch, seen,
+                                          remote_device ? REGISTER_BACKEND_LIVENESS_MS : -1);
+        if (now != seen) {
+            seen = now;
+            signal_fd(notify_fd);
+        }
+
+        // On the clock, since a busy device never lets the wait time out
+        if (!remote_device || clock_wall_ns() - checked_ns < REGISTER_BACKEND_LIVENESS_MS * 1000000ull) {
+            continue;
+        }
+        checked_ns = clock_wall_ns();
+        if (check_device(&rf, &pid)) {
+            seen = atomic_load(&rf->input_epoch.value);
+            signal_fd(notify_fd);
+        }
+    }
+    return NULL;
+}
+
+static bool start_watcher(void) {
+    device_floors = registers->num_floors;
+    device_cars = registers->num_cars;
+    notify_fd = eventfd(0, EFD_NONBLOCK | EFD_CLOEXEC);
+    return notify_fd != -1 && pthread_create(&watcher, NULL, watcher_main, NULL) == 0;
+}
+
+register_file_t* memory_backend_device(int num_floors, int num_cars) {
+    register_file_init(&memory_registers, num_floors, num_cars);
+    return &memory_registers;
+}
+
+static bool memory_backend_start(void) {
+    if (!register_file_valid(&memory_registers)) {
+        memory_backend_device(4, 1);
+    }
+    registers = &memory_registers;
+    remote_device = false;
+    return start_watcher();
+}
+
+void shm_backend_set_name(const char* name) {
+    snprintf(shm_name, sizeof(shm_name), "%s", name);
+}
+
+static bool shm_backend_start(void) {
+    int fd = shm_open(shm_name, O_RDWR, 0);
+    if (fd == -1) {
+        printf("ERROR: No shared register file %s; is the simulator running with --shm?\n", shm_name);
+        return false;
+    }
+
+    struct stat st;
+    void* map = MAP_FAILED;
+    if (fstat(fd, &st) == 0 && (size_t)st.st_size >= sizeof(register_file_t)) {
+        map = mmap(NULL, sizeof(register_file_t), PROT_READ | PROT_WRITE, MAP_SHARED, fd, 0);
+        shm_ino = st.st_ino;
+    }
+    close(fd);
+
+    if (map == MAP_FAILED || !register_file_valid(map)) {
+        printf("ERROR: %s is not a register file of this version\n", shm_name);
+        if (map != MAP_FAILED) munmap(map, sizeof(register_file_t));
+        return false;
+    }
+    registers = map;
+    remote_device = true;
+    return start_watcher();
+}
+
+static int register_backend_num_floors(void) {
+    return (int)registers->num_floors;
+}
+
+static int register_backend_num_cars(void) {
+    return (int)registers->num_cars;
+}
+
+static void register_backend_read_inputs(int car, ElevioInputs* inputs) {
+    register_file_read_inputs(registers, car, inputs);
+}
+
+static void register_backend_write_output(int car, ElevioOutput output) {
+    register_file_write_output(registers, car, output);
+    outputs_pending = true;
+}
+
+static void register_backend_flush(void) {
+    if (!outputs_pending) return;
+    outputs_pending = false;
+    register_file_commit_outputs(registers);
+}
+
+static int register_backend_fd(void) {
+    return notify_fd;
+}
+
+static bool register_backend_connected(void) {
+    return atomic_load(&connected);
+}
+
+/**
+ * @brief Counts reconnections, first taking up the register file of a
+ *        restarted device.
+ *
+ * Swapped here, on the controller thread, so that no read or write is
+ * still using the old mapping when it goes.
+ */
+static unsigned register_backend_reconnects(void) {
+    register_file_t* next = atomic_exchange(&remapped, NULL);
+    if (next != NULL) {
+        munmap(registers, sizeof(register_file_t));
+        registers = next;
+    }
+    return atomic_load(&reconnects);
+}
+
+const hardware_backend_t memory_backend = {
+    .start = memory_backend_start,
+    .num_floors = register_backend_num_floors,
+    .num_cars = register_backend_num_cars,
+    .read_inputs = register_backend_read_inputs,
+    .write_output = register_backend_write_output,
+    .flush = register_backend_flush,
+    .fd = register_backend_fd,
+    .connected = register_backend_connected,
+    .reconnects = register_backend_reconnects,
+};
+
+const hardware_backend_t shm_backend = {
+    .start = shm_backend_start,
+    .num_floors = register_backend_num_floors,
+    .num_cars = register_backend_num_cars,
+    .read_inputs = register_backend_read_inputs,
+    .write_output = register_backend_write_output,
+    .flush = register_backend_flush,
+    .fd = register_backend_fd,
+    .connected = register_backend_connected,
+    .reconnects = register_backend_reconnects,
+};
@@ -0,0 +1,59 @@
+/**
+ * @file register_backend.h
+ * @brief Hardware backends on a register file: in-process and shared memory.
+ *
+ * memory_backend drives a register file inside the controller process,
+ * for tests and benchmarks that act as the device themselves.
+ * shm_backend maps the register file a co-located simulator exports as
+ * a POSIX shared memory object. Either way inputs are read and outputs
+ * written without a syscall; a watcher thread sleeps on the input epoch
+ * and signals the event loop's descriptor when the device published.
+ *
+ * For shm_backend the watcher also checks that the device process still
+ * runs. When it is gone the backend reports the connection lost, and the
+ * watcher carries on until a device serves the same building again,
+ * whether in a new shared memory object, which it maps, or in the old one
+ * under a new process id. It then counts a reconnection, so that the
+ * controller writes all outputs again.
+ */
+
+#ifndef REGISTER_BACKEND_H
+#define REGISTER_BACKEND_H
+
+#include "hardware_interface.h"
+#include "register_file.h"
+
+/** @brief How often the watcher checks that the shared memory device still runs, or is back. */
+#define REGISTER_BACKEND_LIVENESS_MS 200
+
+/**
+ * @brief Hardware backend on a register file inside this process.
+ */
+extern const hardware_backend_t memory_backend;
+
+/**
+ * @brief Hardware backend on a register file shared with a device process.
+ */
+extern const hardware_backend_t shm_backend;
+
+/**
+ * @brief Sets up the in-memory device and returns its register file.
+ *
+ * The caller acts as the device: it publishes inputs and reads outputs
+ * through the register_file_* functions. Call before
+ * hardware_interface_init(&memory_backend); without it the device is a
+ * 4-floor, 1-car building with every car at floor 0.
+ *
+ * @param num_floors Number of floors.
+ * @param num_cars Number of cars.
+ */
+register_file_t* memory_backend_device(int num_floors, int num_cars);
+
+/**
+ * @brief Selects the shared memory object shm_backend maps.
+ *
+ * The default is REGISTER_FILE_DEFAULT_SHM.
+ */
+void shm_backend_set_name(const char* name);
+
+#endif
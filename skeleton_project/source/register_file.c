@@ -0,0 +1,129 @@
+/**
+ * @file register_file.c
+ * @brief Register file of an elevator device, shared with its controller.
+ *
+ * The seqlocks follow io_thread.c: the writer makes the sequence odd,
+ * copies and makes it even again; a reader retries until it sees the
+ * same even sequence before and after its copy. The futexes are not
+ * process-private, since the register file may live in a shared mapping.
+ */
+
+#include "register_file.h"
+#include <limits.h>
+#include <linux/futex.h>
+#include <string.h>
+#include <sys/syscall.h>
+#include <time.h>
+#include <unistd.h>
+
+static void seq_begin(atomic_uint* seq) {
+    unsigned value = atomic_load_explicit(seq, memory_order_relaxed);
+    atomic_store_explicit(seq, value + 1, memory_order_relaxed);
+    atomic_thread_fence(memory_order_release);
+}
+
+static void seq_end(atomic_uint* seq) {
+    unsigned value = atomic_load_explicit(seq, memory_order_relaxed);
+    atomic_store_explicit(seq, value + 1, memory_order_release);
+}
+
+/** @brief Copies size bytes guarded by a seqlock into a private buffer. */
+static void seq_read(atomic_uint* seq, const void* shared, void* copy, size_t size) {
+    unsigned before, after = 0;
+
+    do {
+        before = atomic_load_explicit(seq, memory_order_acquire);
+        if (before & 1u) {
+            continue;
+        }
+        memcpy(copy, shared, size);
+        atomic_thread_fence(memory_order_acquire);
+        after = atomic_load_explicit(seq, memory_order_relaxed);
+    } while ((before & 1u) || before != after);
+}
+
+static void epoch_bump(register_epoch_t* epoch) {
+    atomic_fetch_add_explicit(&epoch->value, 1, memory_order_seq_cst);
+    if (atomic_load_explicit(&epoch->waiters, memory_order_seq_cst) > 0) {
+        syscall(SYS_futex, &epoch->value, FUTEX_WAKE, INT_MAX, NULL, NULL, 0);
+    }
+}
+
+void register_file_init(register_file_t* rf, int num_floors, int num_cars) {
+    memset(rf, 0, sizeof(*rf));
+    rf->num_floors = (uint32_t)num_floors;
+    rf->num_cars = (uint32_t)num_cars;
+    rf->device_pid = (int32_t)getpid();
+    for (int car = 0; car < ELEVIO_MAX_CARS; car++) {
+        memset(&rf->cars[car].outputs, (unsigned char)REGISTER_OUTPUT_UNSET,
+               sizeof(rf->cars[car].outputs));
+    }
+
+    // The magic goes last, so a controller never sees a half-built file as valid
+    rf->version = REGISTER_FILE_VERSION;
+    atomic_thread_fence(memory_order_release);
+    rf->magic = REGISTER_FILE_MAGIC;
+}
+
+bool register_file_valid(const register_file_t* rf) {
+    return rf->magic == REGISTER_FILE_MAGIC && rf->version == REGISTER_FILE_VERSION &&
+           rf->num_floors >= 2 && rf->num_floors <= ELEVIO_MAX_FLOORS &&
+           rf->num_cars >= 1 && rf->num_cars <= ELEVIO_MAX_CARS;
+}
+
+void register_file_publish_inputs(register_file_t* rf, int car, const ElevioInputs* inputs) {
+    register_car_t* regs = &rf->cars[car];
+    seq_begin(&regs->input_seq);
+    regs->inputs = *inputs;
+    seq_end(&regs->input_seq);
+    epoch_bump(&rf->input_epoch);
+}
+
+void register_file_read_inputs(register_file_t* rf, int car, ElevioInputs* inputs) {
+    register_car_t* regs = &rf->cars[car];
+    seq_read(&regs->input_seq, &regs->inputs, inputs, sizeof(*inputs));
+}
+
+void register_file_write_output(register_file_t* rf, int car, ElevioOutput output) {
+    register_outputs_t* out = &rf->cars[car].outputs;
+    const signed char* bytes = (const signed char*)output.bytes;
+
+    seq_begin(&rf->cars[car].output_seq);
+    switch (bytes[0]) {
+        case 1: out->motor = bytes[1]; break;
+        case 2:
+            if (bytes[1] >= 0 && bytes[1] < N_BUTTONS && bytes[2] >= 0 && bytes[2] < ELEVIO_MAX_FLOORS) {
+                out->button_lamps[(int)bytes[2]][(int)bytes[1]] = bytes[3] != 0;
+            }
+            break;
+        case 3: out->floor_indicator = bytes[1]; break;
+        case 4: out->door_light = bytes[1] != 0; break;
+        case 5: out->stop_light = bytes[1] != 0; break;
+        default: break;
+    }
+    seq_end(&rf->cars[car].output_seq);
+}
+
+void register_file_commit_outputs(register_file_t* rf) {
+    epoch_bump(&rf->output_epoch);
+}
+
+void register_file_read_outputs(register_file_t* rf, int car, register_outputs_t* outputs) {
+    register_car_t* regs = &rf->cars[car];
+    seq_read(&regs->output_seq, &regs->outputs, outputs, sizeof(*outputs));
+}
+
+unsigned register_file_wait(register_epoch_t* epoch, unsigned seen, int timeout_ms) {
+    unsigned now = atomic_load_explicit(&epoch->value, memory_order_acquire);
+    if (now != seen) return now;
+
+    // Announce the waiter before the final check, pairing with epoch_bump()
+    atomic_fetch_add_explicit(&epoch->waiters, 1, memory_order_seq_cst);
+    if (atomic_load_explicit(&epoch->value, memory_order_seq_cst) == seen) {
+        struct timespec timeout = { timeout_ms / 1000, (timeout_ms % 1000) * 1000000L };
+        syscall(SYS_futex, &epoch->value, FUTEX_WAIT, seen, timeout_ms >= 0 ? &timeout : NULL,
+                NULL, 0);
+    }
+    atomic_fetch_sub_explicit(&epoch->waiters, 1, memory_order_relaxed);
+    return atomic_load_explicit(&epoch->value, memory_order_acquire);
+}
@@ -0,0 +1,141 @@
+/**
+ * @file register_file.h
+ * @brief Register file of an elevator device, shared with its controller.
+ *
+ * The device side (a simulator, or a test driving the in-memory backend)
+ * publishes each car's inputs through a seqlock; the controller writes
+ * outputs in place through a second seqlock per car. Both sides bump an
+ * epoch counter after a change; a side waiting for changes sleeps on it
+ * as a futex and is only woken if it said it is waiting. A full input
+ * snapshot is therefore read without a syscall, and nobody has to poll.
+ *
+ * The layout holds only fixed-size fields and lock-free atomics, so the
+ * same register file works within one process and in a shared mapping
+ * between processes.
+ */
+
+#ifndef REGISTER_FILE_H
+#define REGISTER_FILE_H
+
+#include <stdatomic.h>
+#include <stdbool.h>
+#include <stdint.h>
+#include "driver/elevio.h"
+
+#define REGISTER_FILE_MAGIC 0x46475245u /* "ERGF" */
+#define REGISTER_FILE_VERSION 2
+
+/** @brief Default shared memory object of a co-located simulator. */
+#define REGISTER_FILE_DEFAULT_SHM "/elevator-registers"
+
+/**
+ * @brief Value of an output register that was never written.
+ *
+ * Outside every valid output value; in particular -1 is DIRN_DOWN.
+ */
+#define REGISTER_OUTPUT_UNSET INT8_MIN
+
+/**
+ * @brief Output registers of one car, as set by the wire-format writes.
+ *
+ * A register holds REGISTER_OUTPUT_UNSET until its first write.
+ */
+typedef struct {
+    int8_t motor;
+    int8_t floor_indicator;
+    int8_t door_light;
+    int8_t stop_light;
+    int8_t button_lamps[ELEVIO_MAX_FLOORS][N_BUTTONS];
+} register_outputs_t;
+
+/**
+ * @brief Change counter that one side bumps and the other may sleep on.
+ */
+typedef struct {
+    _Alignas(64) atomic_uint value;
+    atomic_uint waiters;
+} register_epoch_t;
+
+/**
+ * @brief Registers of one car; each seqlock on its own cache line.
+ */
+typedef struct {
+    _Alignas(64) atomic_uint input_seq;
+    ElevioInputs inputs;
+
+    _Alignas(64) atomic_uint output_seq;
+    register_outputs_t outputs;
+} register_car_t;
+
+/**
+ * @brief A whole register file.
+ */
+typedef struct {
+    uint32_t magic;
+    uint32_t version;
+    uint32_t num_floors;
+    uint32_t num_cars;
+
+    /** @brief Process id of the device, for liveness checks across processes. */
+    int32_t device_pid;
+
+    /** @brief Bumped by the device after publishing inputs. */
+    register_epoch_t input_epoch;
+
+    /** @brief Bumped by the controller after writing outputs. */
+    register_epoch_t output_epoch;
+
+    register_car_t cars[ELEVIO_MAX_CARS];
+} register_file_t;
+
+_Static_assert(ATOMIC_INT_LOCK_FREE == 2, "shared registers need lock-free atomics");
+
+/**
+ * @brief Initializes a register file for a device with all outputs unset.
+ */
+void register_file_init(register_file_t* rf, int num_floors, int num_cars);
+
+/**
+ * @brief Checks that a register file was initialized with a compatible layout.
+ */
+bool register_file_valid(const register_file_t* rf);
+
+/**
+ * @brief Publishes a car's inputs and wakes the controller. Device side only.
+ */
+void register_file_publish_inputs(register_file_t* rf, int car, const ElevioInputs* inputs);
+
+/**
+ * @brief Copies a consistent snapshot of a car's inputs.
+ */
+void register_file_read_inputs(register_file_t* rf, int car, ElevioInputs* inputs);
+
+/**
+ * @brief Applies one wire-format output write to a car's registers.
+ *
+ * Controller side only; register_file_commit_outputs() makes the writes
+ * known to the device.
+ */
+void register_file_write_output(register_file_t* rf, int car, ElevioOutput output);
+
+/**
+ * @brief Bumps the output epoch and wakes the device.
+ */
+void register_file_commit_outputs(register_file_t* rf);
+
+/**
+ * @brief Copies a consistent snapshot of a car's outputs.
+ */
+void register_file_read_outputs(register_file_t* rf, int car, register_outputs_t* outputs);
+
+/**
+ * @brief Waits until an epoch counter moves past a value.
+ *
+ * @param epoch &rf->input_epoch or &rf->output_epoch.
+ * @param seen The last value the caller has handled.
+ * @param timeout_ms Longest wait, or -1 to wait indefinitely.
+ * @return The current value of the counter.
+ */
+unsigned register_file_wait(register_epoch_t* epoch, unsigned seen, int timeout_ms);
+
+#endif
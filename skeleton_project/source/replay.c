@@ -0,0 +1,387 @@
+/**
+ * @file replay.c
+ * @brief Deterministic replay of a captured elevio trace.
+ *
+ * Inputs and outputs are read from the same mapping with independent
+ * cursors. The input cursor rebuilds each car's snapshot from its poll
+ * replies, pairing every reply with the query it answers; a snapshot is
+ * complete at its obstruction reply, which ends every poll batch. Each
+ * car has an output cursor that the controller's writes are matched
+ * against. A subscribed car's pushed events are applied to its snapshot
+ * instead; the events read together, which share a timestamp, complete
+ * one snapshot. Timer wheel deadlines that fall between two batches fire at
+ * their own time, as they did live.
+ */
+
+#include "replay.h"
+#include "clock.h"
+#include "event_loop.h"
+#include "group_controller.h"
+#include "timer_wheel.h"
+#include "driver/elevio_trace.h"
+#include <fcntl.h>
+#include <stddef.h>
+#include <stdio.h>
+#include <string.h>
+#include <sys/mman.h>
+#include <sys/stat.h>
+#include <time.h>
+#include <unistd.h>
+
+_Static_assert(offsetof(ElevioTraceHeader, startLocalMs) == ELEVIO_TRACE_HEADER_SIZE_V1,
+               "version 2 only appends to the header");
+_Static_assert(offsetof(ElevioTraceHeader, floorTravelMs) == ELEVIO_TRACE_HEADER_SIZE_V2,
+               "version 3 only appends to the header");
+
+/** @brief Queries that can be awaiting replies per car; a power of two. */
+#define REPLAY_QUERY_CAPACITY 256
+
+/** @brief Mismatches printed before the rest are only counted. */
+#define REPLAY_MAX_REPORTS 20
+
+static const uint8_t* mapping = NULL;
+static size_t mapping_size;
+
+static const ElevioTraceHeader* header;
+static const ElevioTraceRecord* records;
+static size_t record_count;
+
+static size_t input_cursor;
+static size_t output_cursor[N_CARS_MAX];
+
+/** @brief Snapshots as the controller sees them, and as being rebuilt. */
+static ElevioInputs inputs[N_CARS_MAX];
+static ElevioInputs pending[N_CARS_MAX];
+
+static uint8_t queries[N_CARS_MAX][REPLAY_QUERY_CAPACITY][4];
+static unsigned query_head[N_CARS_MAX];
+static unsigned query_tail[N_CARS_MAX];
+
+static uint64_t now_ns;
+static replay_result_t result;
+
+static uint64_t replay_clock(void) {
+    return now_ns;
+}
+
+static uint64_t record_ns(const ElevioTraceRecord* r) {
+    return header->startNs + (uint64_t)r->timeMs * 1000000u;
+}
+
+/**
+ * @brief Applies one poll reply to the car's snapshot under construction.
+ *
+ * @return true if the reply completed the snapshot.
+ */
+static bool apply_reply(int car, const ElevioTraceRecord* r) {
+    if (query_head[car] == query_tail[car]) return false;
+    const uint8_t* q = queries[car][query_tail[car]++ % REPLAY_QUERY_CAPACITY];
+    ElevioInputs* in = &pending[car];
+
+    switch (q[0]) {
+        case 6:
+            if (q[2] < ELEVIO_MAX_FLOORS && q[1] < N_BUTTONS) {
+                in->callButton[q[2]][q[1]] = r->bytes[1];
+            }
+            return false;
+        case 7:
+            in->floorSensor = r->bytes[1] ? r->bytes[2] : -1;
+            return false;
+        case 8:
+            in->stopButton = r->bytes[1];
+            return false;
+        case 9:
+            in->obstruction = r->bytes[1];
+            return true;
+        default:
+            return false;
+    }
+}
+
+/**
+ * @brief Checks whether a record is an event pushed to a car.
+ */
+static bool is_event(const ElevioTraceRecord* r, int car) {
+    return elevio_traceIsReply(r) && elevio_traceCar(r) == car &&
+           elevio_traceOpcode(r) == ELEVIO_OP_EVENT;
+}
+
+static void apply_event(int car, const ElevioTraceRecord* r) {
+    uint8_t record[4];
+    memcpy(record, r->bytes, 4);
+    record[0] = ELEVIO_OP_EVENT;
+    elevio_applyEvent(&pending[car], record);
+}
+
+/**
+ * @brief Advances the input cursor to the next completed snapshot.
+ *
+ * @param time_ns Receives the time of the snapshot's last reply.
+ * @return The car whose snapshot is now in pending[], or -1 at the end.
+ */
+static int next_batch(uint64_t* time_ns) {
+    while (input_cursor < record_count) {
+        const ElevioTraceRecord* r = &records[input_cursor++];
+        int car = elevio_traceCar(r);
+        int op = elevio_traceOpcode(r);
+        if (car >= (int)header->numCars || op < 6) continue;
+
+        if (op == ELEVIO_OP_SUBSCRIBE) {
+            // The acknowledgement; the events that follow start from rest
+            if (elevio_traceIsReply(r) && r->bytes[1] == 1) {
+                pending[car] = (ElevioInputs){ .floorSensor = -1 };
+            }
+        } else if (op == ELEVIO_OP_EVENT) {
+            apply_event(car, r);
+            while (input_cursor < record_count && is_event(&records[input_cursor], car) &&
+                   records[input_cursor].timeMs == r->timeMs) {
+                apply_event(car, &records[input_cursor++]);
+            }
+            *time_ns = record_ns(r);
+            return car;
+        } else if (!elevio_traceIsReply(r)) {
+            uint8_t* q = queries[car][query_head[car]++ % REPLAY_QUERY_CAPACITY];
+            memcpy(q, r->bytes, 4);
+            q[0] = (uint8_t)op;
+        } else if (apply_reply(car, r)) {
+            *time_ns = record_ns(r);
+            return car;
+        }
+    }
+    return -1;
+}
+
+static void report(const char* format, int car, uint64_t time_ns, const uint8_t* expected,
+                   const uint8_t* got) {
+    result.mismatches++;
+    if (result.mismatches > REPLAY_MAX_REPORTS) return;
+
+    printf("[REPLAY] car %d at %.3f s: %s", car, (double)(time_ns - header->startNs) / 1e9, format);
+    if (expected) printf(" expected %d %d %d %d", expected[0], expected[1], expected[2], expected[3]);
+    if (got) printf(" got %d %d %d %d", got[0], got[1], got[2], got[3]);
+    printf("\n");
+}
+
+/**
+ * @brief Finds the car's next recorded output, or NULL.
+ */
+static const ElevioTraceRecord* next_output(int car) {
+    while (output_cursor[car] < record_count) {
+        const ElevioTraceRecord* r = &records[output_cursor[car]++];
+        int op = elevio_traceOpcode(r);
+        if (!elevio_traceIsReply(r) && elevio_traceCar(r) == car && op >= 1 && op <= 5) {
+            return r;
+        }
+    }
+    return NULL;
+}
+
+static bool replay_start(void) {
+    // The controller starts from one snapshot of every car, as io_thread_start() takes
+    unsigned seen = 0, all = (1u << header->numCars) - 1;
+    while (seen != all) {
+        int car = next_batch(&now_ns);
+        if (car < 0) {
+            printf("[REPLAY] trace ends before every car was polled\n");
+            return false;
+        }
+        inputs[car] = pending[car];
+        seen |= 1u << car;
+        result.batches++;
+    }
+    return true;
+}
+
+static int replay_num_floors(void) {
+    return (int)header->numFloors;
+}
+
+static int replay_num_cars(void) {
+    return (int)header->numCars;
+}
+
+/** @brief Motion times for traces before version 3, which do not record them. */
+static const building_t default_building = BUILDING_DEFAULT;
+
+static int replay_floor_travel_ms(void) {
+    return header->version >= 3 ? (int)header->floorTravelMs : default_building.floor_travel_ms;
+}
+
+static int replay_floor_passing_ms(void) {
+    return header->version >= 3 ? (int)header->floorPassingMs : default_building.floor_passing_ms;
+}
+
+static void replay_read_inputs(int car, ElevioInputs* in) {
+    *in = inputs[car];
+}
+
+static void replay_write_output(int car, ElevioOutput output) {
+    const uint8_t* got = (const uint8_t*)output.bytes;
+    const ElevioTraceRecord* r = next_output(car);
+    result.outputs++;
+
+    if (r == NULL) {
+        report("output not in the recording:", car, now_ns, NULL, got);
+        return;
+    }
+
+    uint8_t expected[4];
+    memcpy(expected, r->bytes, 4);
+    expected[0] = (uint8_t)elevio_traceOpcode(r);
+    if (memcmp(expected, got, 4) != 0) {
+        report("output differs:", car, now_ns, expected, got);
+    }
+}
+
+static void replay_flush(void) {
+}
+
+const hardware_backend_t replay_backend = {
+    .start = replay_start,
+    .num_floors = replay_num_floors,
+    .num_cars = replay_num_cars,
+    .floor_travel_ms = replay_floor_travel_ms,
+    .floor_passing_ms = replay_floor_passing_ms,
+    .read_inputs = replay_read_inputs,
+    .write_output = replay_write_output,
+    .flush = replay_flush,
+    .fd = NULL,
+    .connected = NULL,
+    .reconnects = NULL,
+    .set_sample_period = NULL,
+    .samples = NULL,
+};
+
+/**
+ * @brief Sets a building's scheduler to the one the trace names, if it
+ *        names one.
+ *
+ * @return false if the name is not that of a scheduler.
+ */
+static bool select_scheduler(building_t* building) {
+    if (header->version < 3 || header->scheduler[0] == '\0') return true;
+
+    char name[ELEVIO_TRACE_SCHEDULER_LEN + 1] = {0};
+    memcpy(name, header->scheduler, sizeof(header->scheduler));
+    if (!order_scheduler_parse(name, &building->scheduler)) {
+        printf("ERROR: Trace names unknown scheduler %s\n", name);
+        return false;
+    }
+    return true;
+}
+
+bool replay_open(const char* path, building_t* building) {
+    int fd = open(path, O_RDONLY);
+    if (fd == -1) return false;
+
+    struct stat st;
+    if (fstat(fd, &st) != 0 || (size_t)st.st_size < ELEVIO_TRACE_HEADER_SIZE_V1) {
+        close(fd);
+        return false;
+    }
+    mapping_size = (size_t)st.st_size;
+    void* map = mmap(NULL, mapping_size, PROT_READ, MAP_PRIVATE, fd, 0);
+    close(fd);
+    if (map == MAP_FAILED) return false;
+    madvise(map, mapping_size, MADV_SEQUENTIAL);
+    mapping = map;
+
+    // Each version only appended to the header of the one before
+    header = (const ElevioTraceHeader*)mapping;
+    size_t header_size = header->version == 1 ? ELEVIO_TRACE_HEADER_SIZE_V1 :
+                         header->version == 2 ? ELEVIO_TRACE_HEADER_SIZE_V2 : sizeof(ElevioTraceHeader);
+    if (memcmp(header->magic, ELEVIO_TRACE_MAGIC, sizeof(header->magic)) != 0 ||
+        header->version < 1 || header->version > ELEVIO_TRACE_VERSION ||
+        mapping_size < header_size ||
+        header->recordSize != sizeof(ElevioTraceRecord) ||
+        header->numCars < 1 || header->numCars > N_CARS_MAX) {
+        replay_close();
+        return false;
+    }
+    if (!select_scheduler(building)) {
+        replay_close();
+        return false;
+    }
+    records = (const ElevioTraceRecord*)(mapping + header_size);
+    record_count = (mapping_size - header_size) / sizeof(ElevioTraceRecord);
+
+    input_cursor = 0;
+    memset(output_cursor, 0, sizeof(output_cursor));
+    memset(query_head, 0, sizeof(query_head));
+    memset(query_tail, 0, sizeof(query_tail));
+    result = (replay_result_t){0};
+    now_ns = header->startNs;
+    clock_set_source(replay_clock);
+    return true;
+}
+
+bool replay_local_ms(int64_t* local_ms) {
+    if (header->version == 1) return false;
+    *local_ms = header->startLocalMs + (int64_t)((now_ns - header->startNs) / 1000000u);
+    return true;
+}
+
+void replay_close(void) {
+    if (mapping != NULL) {
+        munmap((void*)mapping, mapping_size);
+        mapping = NULL;
+    }
+    clock_set_source(NULL);
+}
+
+/**
+ * @brief Waits until the wall clock has caught up with a trace time.
+ */
+static void pace(uint64_t time_ns, uint64_t trace_start_ns, uint64_t wall_start_ns) {
+    uint64_t due = wall_start_ns + (time_ns - trace_start_ns);
+    uint64_t wall = clock_wall_ns();
+    if (due > wall) {
+        struct timespec delay = { (time_t)((due - wall) / 1000000000u), (long)((due - wall) % 1000000000u) };
+        nanosleep(&delay, NULL);
+    }
+}
+
+replay_result_t replay_run(group_controller_t* group, bool realtime) {
+    timer_wheel_t* wheel = group_controller_wheel(group);
+    uint64_t trace_start_ns = now_ns;
+    uint64_t wall_start_ns = clock_wall_ns();
+    uint64_t end_ns = record_count > 0 ? record_ns(&records[record_count - 1]) : now_ns;
+
+    event_loop_commit_outputs(group);
+
+    while (1) {
+        uint64_t batch_ns = end_ns;
+        int car = next_batch(&batch_ns);
+
+        // Deadlines due before the snapshot fire first, on the old inputs
+        while (1) {
+            int64_t wait_ms = timer_wheel_ms_until_next(wheel);
+            if (wait_ms < 0) break;
+            uint64_t due_ns = (now_ns / 1000000u + (uint64_t)wait_ms) * 1000000u;
+            if (due_ns > batch_ns) break;
+            if (realtime) pace(due_ns, trace_start_ns, wall_start_ns);
+            if (due_ns > now_ns) now_ns = due_ns;
+            event_loop_handle_deadline(group);
+            event_loop_commit_outputs(group);
+        }
+        if (car < 0) break;
+
+        if (realtime) pace(batch_ns, trace_start_ns, wall_start_ns);
+        now_ns = batch_ns;
+        inputs[car] = pending[car];
+        result.batches++;
+        event_loop_handle_inputs(group);
+        event_loop_commit_outputs(group);
+    }
+
+    for (int car = 0; car < (int)header->numCars; car++) {
+        const ElevioTraceRecord* r;
+        while ((r = next_output(car)) != NULL) {
+            uint8_t expected[4];
+            memcpy(expected, r->bytes, 4);
+            expected[0] = (uint8_t)elevio_traceOpcode(r);
+            report("recorded output never produced:", car, record_ns(r), expected, NULL);
+        }
+    }
+    return result;
+}
@@ -0,0 +1,77 @@
+/**
+ * @file replay.h
+ * @brief Deterministic replay of a captured elevio trace.
+ *
+ * The replay backend feeds the inputs recorded in an elevio trace (see
+ * driver/elevio_trace.h) back through hardware_interface.c, with the
+ * clock set to the recorded timestamps, and checks every output the
+ * controller writes against the outputs in the recording. The trace is
+ * mapped, not read, so captures of any length replay in constant memory.
+ */
+
+#ifndef REPLAY_H
+#define REPLAY_H
+
+#include <stdbool.h>
+#include <stdint.h>
+#include "group_controller.h"
+#include "hardware_interface.h"
+
+/**
+ * @brief Outcome of a replay.
+ */
+typedef struct {
+    /** @brief Input snapshots fed to the controller. */
+    uint64_t batches;
+
+    /** @brief Outputs compared against the recording. */
+    uint64_t outputs;
+
+    /** @brief Outputs that differed, were extra, or were never produced. */
+    uint64_t mismatches;
+} replay_result_t;
+
+/**
+ * @brief Hardware backend serving the inputs of the open trace.
+ */
+extern const hardware_backend_t replay_backend;
+
+/**
+ * @brief Maps a trace file, installs its clock and sets the building's
+ *        scheduler to the one it names.
+ *
+ * Call before hardware_interface_init(&replay_backend, building). Traces
+ * before version 3 do not name one, and leave the building's scheduler.
+ *
+ * @return true on success, false if the file is missing, not a trace, or
+ *         names an unknown scheduler.
+ */
+bool replay_open(const char* path, building_t* building);
+
+/**
+ * @brief Replays the rest of the trace through the event loop steps.
+ *
+ * Requires group_controller_init() to have run on replay_backend.
+ * Mismatches are printed as they are found.
+ *
+ * @param group The group running on replay_backend.
+ * @param realtime Pace the replay to the recorded timestamps instead of
+ *                 running at full speed.
+ */
+replay_result_t replay_run(group_controller_t* group, bool realtime);
+
+/**
+ * @brief Returns the local wall-clock time the capture had reached at the
+ *        current trace time.
+ *
+ * @param local_ms Receives milliseconds since the epoch, in local time.
+ * @return false if the trace predates recording the time of day.
+ */
+bool replay_local_ms(int64_t* local_ms);
+
+/**
+ * @brief Unmaps the trace.
+ */
+void replay_close(void);
+
+#endif
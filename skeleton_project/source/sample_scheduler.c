@@ -0,0 +1,124 @@
+/**
+ * @file sample_scheduler.c
+ * @brief Input sampling period of each car, chosen by what the car is doing.
+ *
+ * The approach timer delivers an EVENT_TICK to the car's FSM. Ticks are
+ * idempotent in every state; this one only makes the event loop run, so
+ * that sample_scheduler_update() sees the approach window has opened.
+ *
+ * Everything runs on the thread driving the car's group.
+ */
+
+#include "sample_scheduler.h"
+#include "clock.h"
+#include "elevator_fsm.h"
+#include "group_controller.h"
+#include "hardware_interface.h"
+#include "order_manager.h"
+#include "stats.h"
+#include <stdbool.h>
+#include <stdint.h>
+
+/** @brief Stretches shorter than this hold too few samples to give a rate. */
+#define SAMPLE_STATS_MIN_MS 100
+
+/**
+ * @brief Picks the period for a car's current state, arming or cancelling
+ *        the approach timer as needed.
+ */
+static int choose_period_ms(car_sampling_t* s, elevator_t* e, timer_wheel_t* wheel,
+                            uint64_t now_ms) {
+    bool approaching = false;
+    int period_ms = SAMPLE_PERIOD_CRUISE_MS;
+
+    switch (e->state_id) {
+        case STATE_INIT:
+        case STATE_DOOR_OPEN:
+            period_ms = SAMPLE_PERIOD_FAST_MS;
+            break;
+        case STATE_IDLE:
+            if (!order_table_has_orders(&e->orders)) period_ms = SAMPLE_PERIOD_IDLE_MS;
+            break;
+        case STATE_MOVING_UP:
+        case STATE_MOVING_DOWN:
+            // On a floor the stop is already decided; between floors the
+            // next sensor turns on a floor's travel, less the span a sensor
+            // is on for, after the last one turned off
+            if (s->floor_sensor >= 0) break;
+            if (s->left_floor_ms == 0) {
+                period_ms = SAMPLE_PERIOD_FAST_MS;
+                break;
+            }
+            uint64_t approach_ms = s->left_floor_ms +
+                (uint64_t)(e->building->floor_travel_ms - e->building->floor_passing_ms);
+            approach_ms -= SAMPLE_APPROACH_LEAD_MS;
+            if (now_ms >= approach_ms) {
+                period_ms = SAMPLE_PERIOD_FAST_MS;
+            } else {
+                approaching = true;
+                if (!timer_wheel_is_armed(&s->approach_timer)) {
+                    timer_wheel_arm(wheel, &s->approach_timer,
+                                    (uint32_t)(approach_ms - now_ms), &e->fsm, EVENT_TICK);
+                }
+            }
+            break;
+        default:
+            break;
+    }
+
+    if (!approaching) {
+        timer_wheel_cancel(wheel, &s->approach_timer);
+    }
+    return period_ms;
+}
+
+/**
+ * @brief Records the rate achieved over the current window and starts a
+ *        new one when the state changed or the window is full.
+ */
+static void account(car_sampling_t* s, const elevator_t* e, unsigned samples, uint64_t now_ns) {
+    uint64_t elapsed_ns = now_ns - s->window_start_ns;
+    if (e->state_id == s->window_state && elapsed_ns < SAMPLE_STATS_WINDOW_MS * 1000000ull) {
+        return;
+    }
+
+    unsigned taken = samples - s->window_samples;
+    if (elapsed_ns >= SAMPLE_STATS_MIN_MS * 1000000ull && taken > 0) {
+        stats_sample_rate(s->window_state, (uint64_t)taken * 1000000000ull / elapsed_ns);
+    }
+    s->window_state = e->state_id;
+    s->window_start_ns = now_ns;
+    s->window_samples = samples;
+}
+
+void sample_scheduler_update(group_controller_t* group, int car) {
+    car_sampling_t* s = &group->sampling[car];
+    elevator_t* e = group_controller_car(group, car);
+    timer_wheel_t* wheel = group_controller_wheel(group);
+    uint64_t now_ns = clock_now_ns();
+    uint64_t now_ms = now_ns / 1000000u;
+
+    int floor_sensor = hardware_interface_read_floor_sensor(e->hw);
+    if (!s->started) {
+        s->started = true;
+        s->floor_sensor = floor_sensor;
+        s->window_state = e->state_id;
+        s->window_start_ns = now_ns;
+        s->window_samples = hardware_interface_samples(e->hw);
+    }
+
+    bool moving = e->state_id == STATE_MOVING_UP || e->state_id == STATE_MOVING_DOWN;
+    if (!moving) {
+        s->left_floor_ms = 0;
+    } else if (s->floor_sensor >= 0 && floor_sensor < 0) {
+        s->left_floor_ms = now_ms;
+    }
+    s->floor_sensor = floor_sensor;
+
+    int period_ms = choose_period_ms(s, e, wheel, now_ms);
+    if (!hardware_interface_set_sample_period(e->hw, period_ms)) {
+        timer_wheel_cancel(wheel, &s->approach_timer);
+        return;
+    }
+    account(s, e, hardware_interface_samples(e->hw), now_ns);
+}
@@ -0,0 +1,90 @@
+/**
+ * @file sample_scheduler.h
+ * @brief Input sampling period of each car, chosen by what the car is doing.
+ *
+ * A stop is decided on the sample in which the floor sensor turns on, so
+ * a car approaching a floor is sampled fast; so is a car with its door
+ * open, where obstruction and stop presses must be seen at once. A car
+ * idling without orders only needs to notice button presses and is
+ * sampled slowly. Between floors the time to the next floor is predicted
+ * from when the car left the last one, and a timer raises the rate just
+ * before the sensor is due.
+ *
+ * The achieved rate is recorded per state in the statistics. Backends that
+ * do not sample periodically, such as push-mode servers or the simulator,
+ * leave the period without effect.
+ */
+
+#ifndef SAMPLE_SCHEDULER_H
+#define SAMPLE_SCHEDULER_H
+
+#include <stdbool.h>
+#include <stdint.h>
+#include "elevator_fsm.h"
+#include "timer_wheel.h"
+
+/** @brief Period near floors, with the door open and while finding a floor. */
+#define SAMPLE_PERIOD_FAST_MS 2
+
+/** @brief Period between floors, and idling with orders or stopped. */
+#define SAMPLE_PERIOD_CRUISE_MS 10
+
+/**
+ * @brief Shortest time a button is held down, as btnDepressedTime_ms in
+ *        simulator.con.
+ */
+#define SAMPLE_SHORTEST_PRESS_MS 200
+
+/**
+ * @brief Period idling without orders.
+ *
+ * A press that starts and ends between two samples is lost, so the period
+ * stays well below the shortest press: a quarter of it, which leaves room
+ * for samples that come late. A stop is never decided at this rate.
+ */
+#define SAMPLE_PERIOD_IDLE_MS 50
+
+_Static_assert(SAMPLE_PERIOD_IDLE_MS * 4 <= SAMPLE_SHORTEST_PRESS_MS,
+               "idle sampling must see every button press");
+
+/** @brief How long before the floor sensor is due fast sampling starts. */
+#define SAMPLE_APPROACH_LEAD_MS 300
+
+/** @brief Longest stretch in one state recorded as one rate. */
+#define SAMPLE_STATS_WINDOW_MS 1000
+
+/**
+ * @brief Sampling state of one car; zeroed when its group starts.
+ */
+typedef struct {
+    bool started;
+
+    /** @brief Floor sensor at the previous update. */
+    int floor_sensor;
+
+    /** @brief When the car last left a floor, or 0 if not since it started moving. */
+    uint64_t left_floor_ms;
+
+    /** @brief Raises the rate when the next floor's sensor is about due. */
+    wheel_timer_t approach_timer;
+
+    /** @brief Stretch of time the next recorded rate covers. */
+    state_id_t window_state;
+    uint64_t window_start_ns;
+    unsigned window_samples;
+} car_sampling_t;
+
+struct group_controller;
+
+/**
+ * @brief Sets a car's sampling period for its current state and records
+ *        the rate achieved since the last call.
+ *
+ * Call after the FSMs ran, before the outputs are committed.
+ *
+ * @param group The car's group.
+ * @param car The car index.
+ */
+void sample_scheduler_update(struct group_controller* group, int car);
+
+#endif
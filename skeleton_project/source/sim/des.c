@@ -0,0 +1,502 @@
+/**
+ * @file des.c
+ * @brief Discrete-event simulation of a building, driving the real controller.
+ *
+ * Pending events live in a binary min-heap ordered by time and insertion
+ * order. Car motion is piecewise linear: a car's position is stored
+ * together with the time it was last brought up to date, and the only
+ * motion events are the points where its floor sensor changes. A motor
+ * change bumps the car's generation, which voids the boundary event
+ * scheduled for the old motion.
+ */
+
+#include "des.h"
+#include "clock.h"
+#include "event_loop.h"
+#include "group_controller.h"
+#include "timer_wheel.h"
+#include <stdio.h>
+#include <string.h>
+
+/** @brief Room for every arrival plus the car and button events in flight. */
+#define DES_HEAP_CAPACITY (DES_MAX_PASSENGERS + 4096)
+
+/** @brief Upper bound on controller rounds at one instant. */
+#define DES_MAX_SETTLE_ROUNDS 16
+
+typedef enum {
+    DES_EVENT_BOUNDARY,
+    DES_EVENT_BUTTON_RELEASE,
+    DES_EVENT_ARRIVAL
+} des_event_kind_t;
+
+typedef struct {
+    uint64_t time_ms;
+    uint64_t seq;
+    des_event_kind_t kind;
+    int car;
+
+    /** @brief Car generation for boundaries, passenger index for arrivals. */
+    uint32_t arg;
+} des_event_t;
+
+typedef struct {
+    /** @brief Travel above floor 0 at updated_ms. */
+    int64_t position_ms;
+    uint64_t updated_ms;
+    int motor;
+    uint32_t generation;
+
+    /** @brief Time each button is released; pressed while in the future. */
+    uint64_t button_release_ms[ELEVIO_MAX_FLOORS][N_BUTTONS];
+    bool button_lamp[ELEVIO_MAX_FLOORS][N_BUTTONS];
+    bool door_lamp;
+    int door_cycles;
+} des_car_t;
+
+typedef enum {
+    DES_PASSENGER_PENDING,
+    DES_PASSENGER_WAITING,
+    DES_PASSENGER_RIDING,
+    DES_PASSENGER_DONE
+} des_passenger_state_t;
+
+static des_config_t config = DES_CONFIG_DEFAULT;
+static uint64_t now_ms;
+
+/** @brief Group serving the building, while des_run() runs. */
+static group_controller_t* group;
+
+static des_car_t cars[N_CARS_MAX];
+
+static des_event_t heap[DES_HEAP_CAPACITY];
+static int heap_size;
+static uint64_t next_seq;
+
+static des_passenger_t passengers[DES_MAX_PASSENGERS];
+static des_passenger_state_t passenger_state[DES_MAX_PASSENGERS];
+static int passenger_count;
+static int passengers_left;
+
+/** @brief Passengers waiting or riding, in no particular order. */
+static int active[DES_MAX_PASSENGERS];
+static int active_count;
+
+/** @brief Set when an input changed since the controller last looked. */
+static bool inputs_changed;
+
+/** @brief Set when destination calls were handed to the group controller. */
+static bool destinations_keyed;
+
+static uint64_t virtual_ns(void) {
+    return now_ms * 1000000u;
+}
+
+static bool event_before(const des_event_t* a, const des_event_t* b) {
+    return a->time_ms != b->time_ms ? a->time_ms < b->time_ms : a->seq < b->seq;
+}
+
+static void heap_push(des_event_t event) {
+    if (heap_size == DES_HEAP_CAPACITY) {
+        fprintf(stderr, "[DES] event heap full, dropping event\n");
+        return;
+    }
+    event.seq = next_seq++;
+
+    int i = heap_size++;
+    while (i > 0 && event_before(&event, &heap[(i - 1) / 2])) {
+        heap[i] = heap[(i - 1) / 2];
+        i = (i - 1) / 2;
+    }
+    heap[i] = event;
+}
+
+static des_event_t heap_pop(void) {
+    des_event_t top = heap[0];
+    des_event_t last = heap[--heap_size];
+
+    int i = 0;
+    while (1) {
+        int child = 2 * i + 1;
+        if (child >= heap_size) break;
+        if (child + 1 < heap_size && event_before(&heap[child + 1], &heap[child])) child++;
+        if (!event_before(&heap[child], &last)) break;
+        heap[i] = heap[child];
+        i = child;
+    }
+    if (heap_size > 0) heap[i] = last;
+    return top;
+}
+
+static int64_t top_position_ms(void) {
+    return (int64_t)(config.num_floors - 1) * config.travel_between_floors_ms;
+}
+
+static int64_t car_position(const des_car_t* car) {
+    int64_t position = car->position_ms + car->motor * (int64_t)(now_ms - car->updated_ms);
+    if (position < 0) return 0;
+    if (position > top_position_ms()) return top_position_ms();
+    return position;
+}
+
+static int floor_sensor(int64_t position) {
+    int64_t t = config.travel_between_floors_ms;
+    int64_t nearest = (position + t / 2) / t;
+    int64_t offset = position - nearest * t;
+    if (nearest >= config.num_floors) return -1;
+    if (offset < 0) offset = -offset;
+    return 2 * offset <= config.travel_passing_floor_ms ? (int)nearest : -1;
+}
+
+/**
+ * @brief Schedules the next point at which the car's floor sensor changes.
+ */
+static void schedule_boundary(int index) {
+    des_car_t* car = &cars[index];
+    int64_t t = config.travel_between_floors_ms;
+    int64_t half = config.travel_passing_floor_ms / 2;
+    int64_t position = car->position_ms;
+    int floor = floor_sensor(position);
+    int64_t target;
+
+    if (car->motor > 0) {
+        if (position >= top_position_ms()) return;
+        target = floor != -1 ? floor * t + half + 1 : (position / t + 1) * t - half;
+        if (target > top_position_ms()) target = top_position_ms();
+    } else if (car->motor < 0) {
+        if (position <= 0) return;
+        target = floor != -1 ? floor * t - half - 1 : (position / t) * t + half;
+        if (target < 0) target = 0;
+    } else {
+        return;
+    }
+
+    int64_t distance = target > position ? target - position : position - target;
+    heap_push((des_event_t){
+        .time_ms = now_ms + (uint64_t)distance,
+        .kind = DES_EVENT_BOUNDARY,
+        .car = index,
+        .arg = car->generation,
+    });
+}
+
+/** @brief Brings the stored position up to now. */
+static void sync_car(des_car_t* car) {
+    car->position_ms = car_position(car);
+    car->updated_ms = now_ms;
+}
+
+static void press_button(int index, int floor, ButtonType button) {
+    cars[index].button_release_ms[floor][button] = now_ms + config.btn_depressed_ms;
+    heap_push((des_event_t){
+        .time_ms = now_ms + config.btn_depressed_ms,
+        .kind = DES_EVENT_BUTTON_RELEASE,
+        .car = index,
+    });
+    inputs_changed = true;
+}
+
+static ButtonType hall_button(const des_passenger_t* p) {
+    return p->destination > p->origin ? BUTTON_HALL_UP : BUTTON_HALL_DOWN;
+}
+
+static void deactivate(int slot) {
+    active[slot] = active[--active_count];
+}
+
+/**
+ * @brief Keys a passenger's trip in at the hall of a destination-dispatch building.
+ *
+ * Leaves the passenger unassigned if no car can take the call yet.
+ */
+static void key_in_destination(des_passenger_t* p) {
+    p->car = group_controller_destination_call(group, (destination_call_t){ p->origin, p->destination });
+    if (p->car != -1) destinations_keyed = true;
+}
+
+/**
+ * @brief Lets passengers off and on wherever a door is open.
+ *
+ * Runs whenever the controller has written its outputs. A waiting
+ * passenger boards once the hall lamp for their direction is out, since
+ * that means the car at the floor took their call. Passengers whose lamp
+ * went out without a car to board press again, as people do. Under
+ * destination dispatch a passenger boards their assigned car once it has
+ * picked up their call, as a car display would tell them.
+ */
+static void exchange_passengers(void) {
+    for (int slot = 0; slot < active_count; slot++) {
+        int index = active[slot];
+        des_passenger_t* p = &passengers[index];
+
+        if (passenger_state[index] == DES_PASSENGER_RIDING) {
+            des_car_t* car = &cars[p->car];
+            bool at_destination = car->door_lamp && floor_sensor(car_position(car)) == p->destination;
+            if (at_destination) {
+                passenger_state[index] = DES_PASSENGER_DONE;
+                p->alight_ms = now_ms;
+                p->stops += car->door_cycles;
+                passengers_left--;
+                deactivate(slot--);
+            } else if (!car->button_lamp[p->destination][BUTTON_CAB] &&
+                       car->button_release_ms[p->destination][BUTTON_CAB] <= now_ms) {
+                press_button(p->car, p->destination, BUTTON_CAB);
+            }
+            continue;
+        }
+
+        if (config.destination_dispatch) {
+            if (p->car == -1) {
+                key_in_destination(p);
+                continue;
+            }
+            des_car_t* car = &cars[p->car];
+            const order_table_t* orders = &group_controller_car(group, p->car)->orders;
+            destination_call_t call = { p->origin, p->destination };
+            if (car->door_lamp && floor_sensor(car_position(car)) == p->origin &&
+                !order_table_has_destination(&group->building, orders, call)) {
+                passenger_state[index] = DES_PASSENGER_RIDING;
+                p->board_ms = now_ms;
+                p->stops = -car->door_cycles;
+            }
+            continue;
+        }
+
+        ButtonType button = hall_button(p);
+        for (int c = 0; c < config.num_cars; c++) {
+            des_car_t* car = &cars[c];
+            if (car->door_lamp && !car->button_lamp[p->origin][button] &&
+                cars[0].button_release_ms[p->origin][button] <= now_ms &&
+                floor_sensor(car_position(car)) == p->origin) {
+                passenger_state[index] = DES_PASSENGER_RIDING;
+                p->car = c;
+                p->board_ms = now_ms;
+                p->stops = -car->door_cycles;
+                press_button(c, p->destination, BUTTON_CAB);
+                break;
+            }
+        }
+        if (passenger_state[index] == DES_PASSENGER_WAITING &&
+            !cars[0].button_lamp[p->origin][button] &&
+            cars[0].button_release_ms[p->origin][button] <= now_ms) {
+            press_button(0, p->origin, button);
+        }
+    }
+}
+
+static void apply_event(const des_event_t* event) {
+    switch (event->kind) {
+        case DES_EVENT_BOUNDARY: {
+            des_car_t* car = &cars[event->car];
+            if (event->arg != car->generation) return;
+            sync_car(car);
+            schedule_boundary(event->car);
+            inputs_changed = true;
+            break;
+        }
+        case DES_EVENT_BUTTON_RELEASE:
+            inputs_changed = true;
+            break;
+        case DES_EVENT_ARRIVAL: {
+            des_passenger_t* p = &passengers[event->arg];
+            passenger_state[event->arg] = DES_PASSENGER_WAITING;
+            active[active_count++] = (int)event->arg;
+            if (config.destination_dispatch) {
+                key_in_destination(p);
+            } else {
+                press_button(0, p->origin, hall_button(p));
+            }
+            break;
+        }
+    }
+}
+
+static bool des_start(void) {
+    return true;
+}
+
+static int des_num_floors(void) {
+    return config.num_floors;
+}
+
+static int des_num_cars(void) {
+    return config.num_cars;
+}
+
+static int des_floor_travel_ms(void) {
+    return config.travel_between_floors_ms;
+}
+
+static int des_floor_passing_ms(void) {
+    return config.travel_passing_floor_ms;
+}
+
+static void des_read_inputs(int index, ElevioInputs* inputs) {
+    const des_car_t* car = &cars[index];
+    memset(inputs, 0, sizeof(*inputs));
+    for (int floor = 0; floor < config.num_floors; floor++) {
+        for (int button = 0; button < N_BUTTONS; button++) {
+            inputs->callButton[floor][button] = car->button_release_ms[floor][button] > now_ms;
+        }
+    }
+    inputs->floorSensor = floor_sensor(car_position(car));
+}
+
+static void des_write_output(int index, ElevioOutput output) {
+    des_car_t* car = &cars[index];
+    const unsigned char* bytes = (const unsigned char*)output.bytes;
+
+    switch (bytes[0]) {
+        case 1:
+            sync_car(car);
+            car->motor = (signed char)bytes[1];
+            car->generation++;
+            schedule_boundary(index);
+            break;
+        case 2:
+            if (bytes[1] < N_BUTTONS && bytes[2] < config.num_floors) {
+                car->button_lamp[bytes[2]][bytes[1]] = bytes[3] != 0;
+            }
+            break;
+        case 4:
+            if (bytes[1] != 0 && !car->door_lamp) car->door_cycles++;
+            car->door_lamp = bytes[1] != 0;
+            break;
+        default:
+            break;
+    }
+}
+
+static void des_flush(void) {
+    exchange_passengers();
+}
+
+const hardware_backend_t des_backend = {
+    .start = des_start,
+    .num_floors = des_num_floors,
+    .num_cars = des_num_cars,
+    .floor_travel_ms = des_floor_travel_ms,
+    .floor_passing_ms = des_floor_passing_ms,
+    .read_inputs = des_read_inputs,
+    .write_output = des_write_output,
+    .flush = des_flush,
+    .fd = NULL,
+    .connected = NULL,
+    .reconnects = NULL,
+    .set_sample_period = NULL,
+    .samples = NULL,
+};
+
+bool des_init(const des_config_t* new_config) {
+    if (new_config->num_floors < 2 || new_config->num_floors > N_FLOORS_MAX ||
+        new_config->num_cars < 1 || new_config->num_cars > N_CARS_MAX) {
+        fprintf(stderr, "[DES] unsupported building of %d floors and %d cars (at most %d and %d)\n",
+                new_config->num_floors, new_config->num_cars, N_FLOORS_MAX, N_CARS_MAX);
+        return false;
+    }
+    if (new_config->start_floor < 0 || new_config->start_floor >= new_config->num_floors) {
+        fprintf(stderr, "[DES] start floor %d out of range\n", new_config->start_floor);
+        return false;
+    }
+
+    config = *new_config;
+    now_ms = 0;
+    heap_size = 0;
+    next_seq = 0;
+    passenger_count = 0;
+    passengers_left = 0;
+    active_count = 0;
+    inputs_changed = false;
+    destinations_keyed = false;
+
+    memset(cars, 0, sizeof(cars));
+    for (int c = 0; c < config.num_cars; c++) {
+        cars[c].position_ms = (int64_t)config.start_floor * config.travel_between_floors_ms;
+    }
+    clock_set_source(virtual_ns);
+    return true;
+}
+
+bool des_add_passenger(uint64_t arrive_ms, int origin, int destination) {
+    if (passenger_count == DES_MAX_PASSENGERS || origin == destination ||
+        origin < 0 || origin >= config.num_floors ||
+        destination < 0 || destination >= config.num_floors) {
+        return false;
+    }
+
+    int index = passenger_count++;
+    passengers[index] = (des_passenger_t){
+        .origin = origin,
+        .destination = destination,
+        .car = -1,
+        .arrive_ms = arrive_ms,
+        .board_ms = DES_NEVER,
+        .alight_ms = DES_NEVER,
+    };
+    passenger_state[index] = DES_PASSENGER_PENDING;
+    passengers_left++;
+    heap_push((des_event_t){ .time_ms = arrive_ms, .kind = DES_EVENT_ARRIVAL, .arg = (uint32_t)index });
+    return true;
+}
+
+void des_run(group_controller_t* serving, uint64_t until_ms) {
+    group = serving;
+    timer_wheel_t* wheel = group_controller_wheel(group);
+    event_loop_commit_outputs(group);
+
+    while (passengers_left > 0) {
+        int64_t wait_ms = timer_wheel_ms_until_next(wheel);
+        uint64_t deadline_ms = wait_ms >= 0 ? now_ms + (uint64_t)wait_ms : DES_NEVER;
+        uint64_t event_ms = heap_size > 0 ? heap[0].time_ms : DES_NEVER;
+        uint64_t next_ms = deadline_ms < event_ms ? deadline_ms : event_ms;
+
+        if (next_ms == DES_NEVER) {
+            fprintf(stderr, "[DES] stalled at t=%llu ms with %d passengers left\n",
+                    (unsigned long long)now_ms, passengers_left);
+            break;
+        }
+        if (next_ms > until_ms) break;
+        now_ms = next_ms;
+
+        if (deadline_ms <= event_ms) {
+            event_loop_handle_deadline(group);
+        } else {
+            while (heap_size > 0 && heap[0].time_ms == now_ms) {
+                des_event_t event = heap_pop();
+                apply_event(&event);
+            }
+        }
+        event_loop_commit_outputs(group);
+
+        for (int round = 0; (inputs_changed || destinations_keyed) && round < DES_MAX_SETTLE_ROUNDS;
+             round++) {
+            inputs_changed = false;
+            event_loop_handle_inputs(group);
+            if (destinations_keyed) {
+                destinations_keyed = false;
+                event_loop_handle_orders(group);
+            }
+            event_loop_commit_outputs(group);
+        }
+    }
+}
+
+uint64_t des_now_ms(void) {
+    return now_ms;
+}
+
+int des_door_cycles(void) {
+    int total = 0;
+    for (int c = 0; c < config.num_cars; c++) {
+        total += cars[c].door_cycles;
+    }
+    return total;
+}
+
+int des_passenger_count(void) {
+    return passenger_count;
+}
+
+const des_passenger_t* des_passenger(int index) {
+    return &passengers[index];
+}
@@ -0,0 +1,120 @@
+/**
+ * @file des.h
+ * @brief Discrete-event simulation of a building, driving the real controller.
+ *
+ * The simulator is a hardware_backend_t: the unmodified FSMs, group
+ * controller and event loop steps run on top of it, on a virtual clock
+ * installed through clock_set_source(). Time jumps straight from one
+ * event to the next (a car reaching a sensor boundary, a button being
+ * released, a passenger arriving, a timer wheel deadline), so hours of
+ * traffic run in well under a second and every run is reproducible.
+ *
+ * Car motion follows the SimElevatorServer model: floor f sits at
+ * f * travel_between_floors_ms of travel, and its sensor is active within
+ * travel_passing_floor_ms / 2 of it. Passengers press the hall button on
+ * arrival, board a car whose door is open at their floor once their hall
+ * lamp has gone out, press their destination and alight when the door
+ * opens there.
+ *
+ * With destination_dispatch set, passengers instead key their destination
+ * in at the hall through group_controller_destination_call() and board
+ * the car it names once its door is open at their floor and it has picked
+ * up their call.
+ */
+
+#ifndef DES_H
+#define DES_H
+
+#include <stdbool.h>
+#include <stdint.h>
+#include "group_controller.h"
+#include "hardware_interface.h"
+
+/** @brief Most passengers a run can hold. */
+#define DES_MAX_PASSENGERS 20000
+
+/** @brief Marks a passenger time that has not happened yet. */
+#define DES_NEVER UINT64_MAX
+
+/**
+ * @brief Building layout and timing.
+ */
+typedef struct {
+    int num_floors;
+    int num_cars;
+    int start_floor;
+    int travel_between_floors_ms;
+    int travel_passing_floor_ms;
+    int btn_depressed_ms;
+
+    /** @brief Passengers key in destinations instead of pressing hall buttons. */
+    bool destination_dispatch;
+} des_config_t;
+
+/**
+ * @brief One passenger and what happened to them.
+ */
+typedef struct {
+    int origin;
+    int destination;
+
+    /** @brief Car that carried the passenger (or was assigned to them), or -1. */
+    int car;
+
+    uint64_t arrive_ms;
+    uint64_t board_ms;
+    uint64_t alight_ms;
+
+    /** @brief Door openings of the car from boarding up to alighting. */
+    int stops;
+} des_passenger_t;
+
+/** @brief Defaults matching SimElevatorServer with simulator.con. */
+#define DES_CONFIG_DEFAULT { \
+    .num_floors = 4, .num_cars = 1, .start_floor = 0, \
+    .travel_between_floors_ms = 2000, .travel_passing_floor_ms = 500, \
+    .btn_depressed_ms = 200, .destination_dispatch = false }
+
+/**
+ * @brief Hardware backend backed by the simulated building.
+ */
+extern const hardware_backend_t des_backend;
+
+/**
+ * @brief Resets the building and installs the virtual clock.
+ *
+ * Call before hardware_interface_init(&des_backend).
+ *
+ * @return false if the building has more floors or cars than the
+ *         controller supports, or the start floor is not one of them.
+ */
+bool des_init(const des_config_t* config);
+
+/**
+ * @brief Schedules a passenger.
+ *
+ * @return false if the passenger is invalid or the table is full.
+ */
+bool des_add_passenger(uint64_t arrive_ms, int origin, int destination);
+
+/**
+ * @brief Runs the controller until every passenger has arrived or until
+ *        the given virtual time.
+ *
+ * Requires group_controller_init() to have run on des_backend.
+ *
+ * @param group The group serving the building.
+ * @param until_ms Virtual time to stop at.
+ */
+void des_run(group_controller_t* group, uint64_t until_ms);
+
+/** @brief Returns the current virtual time. */
+uint64_t des_now_ms(void);
+
+/** @brief Returns how often any car's door has opened. */
+int des_door_cycles(void);
+
+int des_passenger_count(void);
+const des_passenger_t* des_passenger(int index);
+
+#endif
@@ -0,0 +1,253 @@
+/**
+ * @file elevator_bench.c
+ * @brief Dispatch benchmark on standard traffic profiles.
+ *
+ * Usage:
+ *   elevator_bench [--floors n] [--cars n] [--duration ms]
+ *                  [--interval ms] [--seed s] [--profile name]
+ *                  [--scheduler name] [--dispatch hall|destination] [--park]
+ *
+ * Generates passengers for each traffic profile with exponentially
+ * distributed arrival gaps, runs them through the controller on the
+ * discrete-event simulator and prints one JSON object per profile on its
+ * own line. Runs with the same options and seed are identical, so the
+ * output can be compared between commits and between schedulers
+ * (baseline, eta-total or eta-worst) and between hall-button and
+ * destination dispatch, with and without demand-learned parking (--park).
+ * Parking only has the run itself to learn from; it starts at
+ * BENCH_START_LOCAL_MS.
+ *
+ * Profiles (shares of passengers; the lobby is floor 0):
+ *   up-peak     85% lobby to upper floors, 10% interfloor, 5% to lobby
+ *   down-peak   85% upper floors to lobby, 10% interfloor, 5% from lobby
+ *   lunch       45% from lobby, 45% to lobby, 10% interfloor
+ *   interfloor  origin and destination uniform over all floors
+ */
+
+#include "des.h"
+#include "demand_model.h"
+#include "group_controller.h"
+#include "hardware_interface.h"
+#include "order_manager.h"
+#include <math.h>
+#include <stdio.h>
+#include <stdlib.h>
+#include <string.h>
+
+typedef struct {
+    const char* name;
+
+    /** @brief Percentages of trips from the lobby and to the lobby. */
+    int from_lobby;
+    int to_lobby;
+} bench_profile_t;
+
+static const bench_profile_t profiles[] = {
+    { "up-peak", 85, 5 },
+    { "down-peak", 5, 85 },
+    { "lunch", 45, 45 },
+    { "interfloor", -1, -1 },
+};
+
+#define BENCH_PROFILE_COUNT (int)(sizeof(profiles) / sizeof(profiles[0]))
+
+/** @brief Time of day the runs start at, for the demand model. */
+#define BENCH_START_LOCAL_MS (8 * 3600 * 1000)
+
+/** @brief Time allowed after the last arrival for the building to empty. */
+#define BENCH_DRAIN_MS (3600 * 1000)
+
+typedef struct {
+    des_config_t building;
+    uint64_t duration_ms;
+    uint64_t interval_ms;
+    uint64_t seed;
+    order_scheduler_t scheduler;
+    bool park;
+} bench_options_t;
+
+static uint64_t rng_state;
+
+/** @brief splitmix64, so runs do not depend on the C library's rand(). */
+static uint64_t rng_next(void) {
+    uint64_t z = (rng_state += 0x9e3779b97f4a7c15ull);
+    z = (z ^ (z >> 30)) * 0xbf58476d1ce4e5b9ull;
+    z = (z ^ (z >> 27)) * 0x94d049bb133111ebull;
+    return z ^ (z >> 31);
+}
+
+/** @brief Uniform integer in [low, high]. */
+static int rng_range(int low, int high) {
+    return low + (int)(rng_next() % (uint64_t)(high - low + 1));
+}
+
+/** @brief Uniform double in (0, 1]. */
+static double rng_unit(void) {
+    return ((rng_next() >> 11) + 1) * (1.0 / 9007199254740992.0);
+}
+
+/**
+ * @brief Draws an origin and destination for one passenger.
+ */
+static void draw_trip(const bench_profile_t* profile, int floors, int* origin, int* destination) {
+    int roll = rng_range(0, 99);
+
+    if (profile->from_lobby >= 0 && roll < profile->from_lobby) {
+        *origin = 0;
+        *destination = rng_range(1, floors - 1);
+    } else if (profile->to_lobby >= 0 && roll < profile->from_lobby + profile->to_lobby) {
+        *origin = rng_range(1, floors - 1);
+        *destination = 0;
+    } else {
+        // Interfloor trips avoid the lobby unless the profile is uniform
+        int low = profile->from_lobby >= 0 && floors > 2 ? 1 : 0;
+        *origin = rng_range(low, floors - 1);
+        do {
+            *destination = rng_range(low, floors - 1);
+        } while (*destination == *origin);
+    }
+}
+
+static int compare_u64(const void* a, const void* b) {
+    uint64_t x = *(const uint64_t*)a, y = *(const uint64_t*)b;
+    return (x > y) - (x < y);
+}
+
+/** @brief Nearest-rank percentile of sorted values. */
+static uint64_t percentile(const uint64_t* sorted, int count, int p) {
+    int rank = (int)ceil(p / 100.0 * count);
+    return sorted[rank > 0 ? rank - 1 : 0];
+}
+
+static void print_distribution(const char* name, uint64_t* values, int count) {
+    double sum = 0;
+    for (int i = 0; i < count; i++) sum += (double)values[i];
+    qsort(values, count, sizeof(values[0]), compare_u64);
+
+    printf("\"%s\":{\"avg\":%.0f,\"p50\":%llu,\"p95\":%llu,\"p99\":%llu}", name,
+           count > 0 ? sum / count : 0.0,
+           count > 0 ? (unsigned long long)percentile(values, count, 50) : 0ull,
+           count > 0 ? (unsigned long long)percentile(values, count, 95) : 0ull,
+           count > 0 ? (unsigned long long)percentile(values, count, 99) : 0ull);
+}
+
+static uint64_t waits[DES_MAX_PASSENGERS];
+static uint64_t journeys[DES_MAX_PASSENGERS];
+
+/** @brief The group serving the simulated building. */
+static group_controller_t group;
+
+/**
+ * @brief Runs one profile on a fresh building and prints its results.
+ */
+static bool run_profile(const bench_profile_t* profile, const bench_options_t* options) {
+    building_t building = BUILDING_DEFAULT;
+    building.scheduler = options->scheduler;
+    if (!des_init(&options->building) || !hardware_interface_init(&des_backend, &building)) {
+        return false;
+    }
+    if (options->park) {
+        demand_model_init(group_controller_demand(&group), &building, NULL, BENCH_START_LOCAL_MS);
+    }
+
+    rng_state = options->seed;
+    uint64_t t = 0;
+    while (1) {
+        t += (uint64_t)(-log(rng_unit()) * (double)options->interval_ms);
+        if (t >= options->duration_ms) break;
+
+        int origin, destination;
+        draw_trip(profile, options->building.num_floors, &origin, &destination);
+        if (!des_add_passenger(t, origin, destination)) break;
+    }
+
+    group_controller_init(&group, &des_backend, &building);
+    des_run(&group, options->duration_ms + BENCH_DRAIN_MS);
+    demand_model_shutdown(group_controller_demand(&group));
+
+    int served = 0;
+    long stops = 0;
+    for (int i = 0; i < des_passenger_count(); i++) {
+        const des_passenger_t* p = des_passenger(i);
+        if (p->alight_ms == DES_NEVER) continue;
+        waits[served] = p->board_ms - p->arrive_ms;
+        journeys[served] = p->alight_ms - p->arrive_ms;
+        stops += p->stops;
+        served++;
+    }
+
+    printf("{\"profile\":\"%s\",\"scheduler\":\"%s\",\"dispatch\":\"%s\",\"park\":%s,"
+           "\"floors\":%d,\"cars\":%d,\"seed\":%llu,\"passengers\":%d,\"served\":%d,",
+           profile->name, order_scheduler_name(options->scheduler),
+           options->building.destination_dispatch ? "destination" : "hall",
+           options->park ? "true" : "false",
+           options->building.num_floors, options->building.num_cars,
+           (unsigned long long)options->seed, des_passenger_count(), served);
+    print_distribution("wait_ms", waits, served);
+    printf(",");
+    print_distribution("journey_ms", journeys, served);
+    printf(",\"stops_per_trip\":%.2f,\"door_cycles\":%d,\"virtual_ms\":%llu}\n",
+           served > 0 ? (double)stops / served : 0.0, des_door_cycles(),
+           (unsigned long long)des_now_ms());
+    return true;
+}
+
+int main(int argc, char** argv) {
+    bench_options_t options = {
+        .building = DES_CONFIG_DEFAULT,
+        .duration_ms = 3600 * 1000,
+        .interval_ms = 15000,
+        .seed = 1,
+        .scheduler = ORDER_SCHEDULER_ETA_TOTAL,
+    };
+    options.building.num_floors = 8;
+    options.building.num_cars = 2;
+    const char* only = NULL;
+
+    for (int i = 1; i < argc; i++) {
+        if (!strcmp(argv[i], "--floors") && i + 1 < argc) {
+            options.building.num_floors = atoi(argv[++i]);
+        } else if (!strcmp(argv[i], "--cars") && i + 1 < argc) {
+            options.building.num_cars = atoi(argv[++i]);
+        } else if (!strcmp(argv[i], "--duration") && i + 1 < argc) {
+            options.duration_ms = strtoull(argv[++i], NULL, 10);
+        } else if (!strcmp(argv[i], "--interval") && i + 1 < argc) {
+            options.interval_ms = strtoull(argv[++i], NULL, 10);
+        } else if (!strcmp(argv[i], "--seed") && i + 1 < argc) {
+            options.seed = strtoull(argv[++i], NULL, 10);
+        } else if (!strcmp(argv[i], "--profile") && i + 1 < argc) {
+            only = argv[++i];
+        } else if (!strcmp(argv[i], "--scheduler") && i + 1 < argc) {
+            if (!order_scheduler_parse(argv[++i], &options.scheduler)) {
+                fprintf(stderr, "%s: unknown scheduler %s\n", argv[0], argv[i]);
+                return 1;
+            }
+        } else if (!strcmp(argv[i], "--dispatch") && i + 1 < argc) {
+            options.building.destination_dispatch = !strcmp(argv[++i], "destination");
+            if (!options.building.destination_dispatch && strcmp(argv[i], "hall") != 0) {
+                fprintf(stderr, "%s: unknown dispatch mode %s\n", argv[0], argv[i]);
+                return 1;
+            }
+        } else if (!strcmp(argv[i], "--park")) {
+            options.park = true;
+        } else {
+            fprintf(stderr, "Usage: %s [--floors n] [--cars n] [--duration ms] "
+                            "[--interval ms] [--seed s] [--profile name] [--scheduler name] "
+                            "[--dispatch hall|destination] [--park]\n", argv[0]);
+            return 1;
+        }
+    }
+    if (options.building.num_floors < 2 || options.interval_ms == 0) {
+        fprintf(stderr, "%s: need at least 2 floors and a nonzero interval\n", argv[0]);
+        return 1;
+    }
+
+    for (int i = 0; i < BENCH_PROFILE_COUNT; i++) {
+        if (only != NULL && strcmp(only, profiles[i].name) != 0) continue;
+        if (!run_profile(&profiles[i], &options)) {
+            fprintf(stderr, "%s: failed to set up profile %s\n", argv[0], profiles[i].name);
+            return 1;
+        }
+    }
+    return 0;
+}
@@ -0,0 +1,169 @@
+/**
+ * @file elevator_sim.c
+ * @brief Runs the controller against the discrete-event simulator.
+ *
+ * Usage:
+ *   elevator_sim [--floors n] [--cars n] [--startFloor f] [--until ms]
+ *                [--log file] [--stats file] [--scheduler name]
+ *                [--dispatch hall|destination] [--park] [--demand file]
+ *                <scenario>
+ *
+ * Scenario lines have the form "<time_ms> <origin> <destination>", one
+ * passenger per line. Lines starting with '#' are ignored. The run ends
+ * when every passenger has arrived or at the --until time, and prints a
+ * summary of waiting and journey times in virtual time. --stats writes
+ * the latency histograms at the end of the run. --scheduler picks the
+ * order scheduler (baseline, eta-total or eta-worst). --dispatch
+ * destination has passengers key in their destination at the hall.
+ * --park lets idle cars park by a demand model learned during the run;
+ * --demand also loads the model from a file and saves it back. Virtual
+ * time 0 is midnight.
+ */
+
+#include "des.h"
+#include "demand_model.h"
+#include "group_controller.h"
+#include "hardware_interface.h"
+#include "logger.h"
+#include "order_manager.h"
+#include "stats.h"
+#include <stdio.h>
+#include <stdlib.h>
+#include <string.h>
+#include <time.h>
+
+/** @brief The group serving the simulated building. */
+static group_controller_t group;
+
+static bool load_scenario(const char* path) {
+    FILE* f = fopen(path, "r");
+    if (!f) {
+        fprintf(stderr, "[SIM] Unable to open scenario %s\n", path);
+        return false;
+    }
+
+    char line[128];
+    int line_no = 0;
+    while (fgets(line, sizeof(line), f)) {
+        line_no++;
+        unsigned long long time_ms;
+        int origin, destination;
+        if (line[0] == '#' || line[0] == '\n') continue;
+
+        if (sscanf(line, "%llu %d %d", &time_ms, &origin, &destination) != 3 ||
+            !des_add_passenger(time_ms, origin, destination)) {
+            fprintf(stderr, "[SIM] %s:%d: invalid passenger\n", path, line_no);
+        }
+    }
+
+    fclose(f);
+    return true;
+}
+
+static void print_summary(double wall_ms) {
+    int served = 0;
+    double wait_sum = 0, journey_sum = 0;
+
+    for (int i = 0; i < des_passenger_count(); i++) {
+        const des_passenger_t* p = des_passenger(i);
+        if (p->alight_ms == DES_NEVER) continue;
+        served++;
+        wait_sum += (double)(p->board_ms - p->arrive_ms);
+        journey_sum += (double)(p->alight_ms - p->arrive_ms);
+    }
+
+    printf("passengers: %d served of %d\n", served, des_passenger_count());
+    if (served > 0) {
+        printf("average wait: %.0f ms\n", wait_sum / served);
+        printf("average journey: %.0f ms\n", journey_sum / served);
+    }
+    printf("virtual time: %llu ms, wall time: %.1f ms\n",
+           (unsigned long long)des_now_ms(), wall_ms);
+}
+
+int main(int argc, char** argv) {
+    des_config_t config = DES_CONFIG_DEFAULT;
+    building_t building = BUILDING_DEFAULT;
+    uint64_t until_ms = 24ull * 3600 * 1000;
+    const char* log_path = NULL;
+    const char* stats_path = NULL;
+    const char* scenario = NULL;
+    const char* demand_path = NULL;
+    bool park = false;
+
+    for (int i = 1; i < argc; i++) {
+        if (!strcmp(argv[i], "--floors") && i + 1 < argc) {
+            config.num_floors = atoi(argv[++i]);
+        } else if (!strcmp(argv[i], "--cars") && i + 1 < argc) {
+            config.num_cars = atoi(argv[++i]);
+        } else if (!strcmp(argv[i], "--startFloor") && i + 1 < argc) {
+            config.start_floor = atoi(argv[++i]);
+        } else if (!strcmp(argv[i], "--until") && i + 1 < argc) {
+            until_ms = strtoull(argv[++i], NULL, 10);
+        } else if (!strcmp(argv[i], "--log") && i + 1 < argc) {
+            log_path = argv[++i];
+        } else if (!strcmp(argv[i], "--stats") && i + 1 < argc) {
+            stats_path = argv[++i];
+        } else if (!strcmp(argv[i], "--scheduler") && i + 1 < argc) {
+            if (!order_scheduler_parse(argv[++i], &building.scheduler)) {
+                fprintf(stderr, "%s: unknown scheduler %s\n", argv[0], argv[i]);
+                return 1;
+            }
+        } else if (!strcmp(argv[i], "--dispatch") && i + 1 < argc) {
+            config.destination_dispatch = !strcmp(argv[++i], "destination");
+            if (!config.destination_dispatch && strcmp(argv[i], "hall") != 0) {
+                fprintf(stderr, "%s: unknown dispatch mode %s\n", argv[0], argv[i]);
+                return 1;
+            }
+        } else if (!strcmp(argv[i], "--park")) {
+            park = true;
+        } else if (!strcmp(argv[i], "--demand") && i + 1 < argc) {
+            demand_path = argv[++i];
+            park = true;
+        } else if (argv[i][0] != '-' && scenario == NULL) {
+            scenario = argv[i];
+        } else {
+            fprintf(stderr, "Usage: %s [--floors n] [--cars n] [--startFloor f] "
+                            "[--until ms] [--log file] [--stats file] [--scheduler name] "
+                            "[--dispatch hall|destination] [--park] [--demand file] <scenario>\n", argv[0]);
+            return 1;
+        }
+    }
+    if (scenario == NULL) {
+        fprintf(stderr, "%s: no scenario given\n", argv[0]);
+        return 1;
+    }
+    if (!des_init(&config)) {
+        return 1;
+    }
+    if (log_path != NULL && !logger_init(log_path)) {
+        printf("ERROR: Failed to open log file %s\n", log_path);
+        return 1;
+    }
+    if (!hardware_interface_init(&des_backend, &building)) {
+        printf("ERROR: Failed to initialize simulated hardware\n");
+        return 1;
+    }
+    if (park && !demand_model_init(group_controller_demand(&group), &building, demand_path, 0)) {
+        printf("WARNING: Ignoring unusable demand model %s\n", demand_path);
+    }
+    if (!load_scenario(scenario)) {
+        return 1;
+    }
+
+    struct timespec start, end;
+    clock_gettime(CLOCK_MONOTONIC, &start);
+
+    group_controller_init(&group, &des_backend, &building);
+    des_run(&group, until_ms);
+
+    clock_gettime(CLOCK_MONOTONIC, &end);
+    print_summary((end.tv_sec - start.tv_sec) * 1e3 + (end.tv_nsec - start.tv_nsec) / 1e6);
+
+    if (stats_path != NULL && !stats_write(stats_path)) {
+        printf("ERROR: Failed to write statistics to %s\n", stats_path);
+    }
+    demand_model_shutdown(group_controller_demand(&group));
+    logger_shutdown();
+    return 0;
+}
@@ -0,0 +1,722 @@
+/**
+ * @file sim_server.c
+ * @brief Headless Linux elevator server speaking the elevio TCP protocol.
+ *
+ * Stand-in for SimElevatorServer.exe. Accepts one controller at a time on
+ * the configured port, answers the 4-byte elevio requests (opcodes 0-10),
+ * models car motion from the timings in simulator.con and injects button
+ * presses from a script file. Simulated time runs at a configurable
+ * multiple of real time.
+ *
+ * Usage:
+ *   SimElevatorServer [--config file] [--script file] [--timeScale x]
+ *                     [--port p] [--numFloors n] [--startFloor f] [--verbose]
+ *                     [--shm [name]]
+ *
+ * With --shm the server exports a register file as the POSIX shared
+ * memory object name (default REGISTER_FILE_DEFAULT_SHM) instead of
+ * listening on TCP, for a controller started with --backend shm. Inputs
+ * are published whenever one changes; the server sleeps until the next
+ * script event, button release or floor sensor edge, or until the
+ * controller commits outputs.
+ *
+ * A TCP client that subscribes (ELEVIO_OP_SUBSCRIBE) gets an event record
+ * for every input edge, sent as soon as the simulation reaches it; its
+ * queries are still answered.
+ *
+ * Script lines have the form "<time_ms> <command> [arg]", where time is in
+ * simulated milliseconds since start and command is one of:
+ *   up <floor>, down <floor>, cab <floor>  - press a call button
+ *   stop <0|1>, obstruction <0|1>          - set a switch
+ *   exit                                   - terminate the server
+ * Lines starting with '#' are ignored.
+ */
+
+#include <errno.h>
+#include <fcntl.h>
+#include <math.h>
+#include <netinet/in.h>
+#include <netinet/tcp.h>
+#include <poll.h>
+#include <signal.h>
+#include <stdbool.h>
+#include <stdint.h>
+#include <stdio.h>
+#include <stdlib.h>
+#include <string.h>
+#include <strings.h>
+#include <sys/mman.h>
+#include <sys/socket.h>
+#include <time.h>
+#include <unistd.h>
+
+#include "../driver/con_load.h"
+#include "../register_file.h"
+
+#define SIM_MAX_FLOORS 9
+#define SIM_N_BUTTONS 3
+#define SIM_MAX_SCRIPT 4096
+
+/** @brief Simulator configuration, loaded from simulator.con. */
+typedef struct {
+    int travel_between_floors_ms;
+    int travel_passing_floor_ms;
+    int btn_depressed_ms;
+    bool stop_motor_on_disconnect;
+    int num_floors;
+    int port;
+    int start_floor;
+    double time_scale;
+    bool verbose;
+} sim_config_t;
+
+/** @brief Scripted input event. */
+typedef struct {
+    double time_ms;
+    enum { SCRIPT_BUTTON, SCRIPT_STOP, SCRIPT_OBSTRUCTION, SCRIPT_EXIT } kind;
+    int button;
+    int floor;
+    int value;
+} script_event_t;
+
+/** @brief Complete simulated elevator state. */
+typedef struct {
+    double now_ms;
+
+    /** Car position in milliseconds of travel above floor 0. */
+    double position_ms;
+    int motor_direction;
+
+    /** Simulated time at which each button is released, or -1 if not pressed. */
+    double button_release_ms[SIM_MAX_FLOORS][SIM_N_BUTTONS];
+    bool stop_button;
+    bool obstruction;
+
+    bool button_lamp[SIM_MAX_FLOORS][SIM_N_BUTTONS];
+    int floor_indicator;
+    bool door_lamp;
+    bool stop_lamp;
+} sim_state_t;
+
+static sim_config_t config = {
+    .travel_between_floors_ms = 2000,
+    .travel_passing_floor_ms = 500,
+    .btn_depressed_ms = 200,
+    .stop_motor_on_disconnect = true,
+    .num_floors = 4,
+    .port = 15657,
+    .start_floor = 0,
+    .time_scale = 1.0,
+    .verbose = false,
+};
+
+static sim_state_t sim;
+
+/** @brief Whether the client subscribed, and the inputs it was last sent. */
+static bool subscribed = false;
+static ElevioInputs pushed;
+
+static script_event_t script[SIM_MAX_SCRIPT];
+static int script_len = 0;
+static int script_next = 0;
+
+static volatile sig_atomic_t running = 1;
+
+static double real_now_ms(void) {
+    struct timespec ts;
+    clock_gettime(CLOCK_MONOTONIC, &ts);
+    return ts.tv_sec * 1000.0 + ts.tv_nsec / 1e6;
+}
+
+static void on_signal(int sig) {
+    (void)sig;
+    running = 0;
+}
+
+/**
+ * @brief Loads timing and layout parameters from a simulator.con file.
+ */
+static void sim_load_config(const char* path) {
+    char stop_on_disconnect[16] = "true";
+    con_load(path,
+        con_val("travelTimeBetweenFloors_ms", &config.travel_between_floors_ms, "%d")
+        con_val("travelTimePassingFloor_ms", &config.travel_passing_floor_ms, "%d")
+        con_val("btnDepressedTime_ms", &config.btn_depressed_ms, "%d")
+        con_val("stopMotorOnDisconnect", stop_on_disconnect, "%15s")
+        con_val("numFloors", &config.num_floors, "%d")
+        con_val("port", &config.port, "%d")
+    )
+    config.stop_motor_on_disconnect = strcasecmp(stop_on_disconnect, "false") != 0;
+}
+
+/**
+ * @brief Parses a script file into the script event table.
+ *
+ * @return true on success, false if the file could not be read.
+ */
+static bool sim_load_script(const char* path) {
+    FILE* f = fopen(path, "r");
+    if (!f) {
+        fprintf(stderr, "[SIM] Unable to open script %s\n", path);
+        return false;
+    }
+
+    char line[128];
+    int line_no = 0;
+    while (fgets(line, sizeof(line), f) && script_len < SIM_MAX_SCRIPT) {
+        line_no++;
+        double t;
+        char cmd[32];
+        int arg = 0;
+        if (line[0] == '#' || line[0] == '\n') continue;
+
+        int n = sscanf(line, "%lf %31s %d", &t, cmd, &arg);
+        if (n < 2) {
+            fprintf(stderr, "[SIM] %s:%d: malformed line\n", path, line_no);
+            continue;
+        }
+
+        script_event_t ev = { .time_ms = t, .floor = arg, .value = arg };
+        if (!strcasecmp(cmd, "up")) {
+            ev.kind = SCRIPT_BUTTON;
+            ev.button = 0;
+        } else if (!strcasecmp(cmd, "down")) {
+            ev.kind = SCRIPT_BUTTON;
+            ev.button = 1;
+        } else if (!strcasecmp(cmd, "cab")) {
+            ev.kind = SCRIPT_BUTTON;
+            ev.button = 2;
+        } else if (!strcasecmp(cmd, "stop")) {
+            ev.kind = SCRIPT_STOP;
+        } else if (!strcasecmp(cmd, "obstruction")) {
+            ev.kind = SCRIPT_OBSTRUCTION;
+        } else if (!strcasecmp(cmd, "exit")) {
+            ev.kind = SCRIPT_EXIT;
+        } else {
+            fprintf(stderr, "[SIM] %s:%d: unknown command '%s'\n", path, line_no, cmd);
+            continue;
+        }
+        if (ev.kind == SCRIPT_BUTTON && (arg < 0 || arg >= config.num_floors)) {
+            fprintf(stderr, "[SIM] %s:%d: floor %d out of range\n", path, line_no, arg);
+            continue;
+        }
+
+        // Keep the table sorted by time; scripts are normally already in order
+        int i = script_len++;
+        while (i > 0 && script[i - 1].time_ms > ev.time_ms) {
+            script[i] = script[i - 1];
+            i--;
+        }
+        script[i] = ev;
+    }
+
+    fclose(f);
+    return true;
+}
+
+/**
+ * @brief Returns the floor whose sensor is active, or -1 between floors.
+ */
+static int sim_floor_sensor(void) {
+    double t = config.travel_between_floors_ms;
+    int nearest = (int)lround(sim.position_ms / t);
+    if (nearest < 0 || nearest >= config.num_floors) return -1;
+    if (fabs(sim.position_ms - nearest * t) <= config.travel_passing_floor_ms / 2.0) {
+        return nearest;
+    }
+    return -1;
+}
+
+static void sim_apply_script_event(const script_event_t* ev) {
+    switch (ev->kind) {
+        case SCRIPT_BUTTON:
+            sim.button_release_ms[ev->floor][ev->button] = ev->time_ms + config.btn_depressed_ms;
+            break;
+        case SCRIPT_STOP:
+            sim.stop_button = ev->value != 0;
+            break;
+        case SCRIPT_OBSTRUCTION:
+            sim.obstruction = ev->value != 0;
+            break;
+        case SCRIPT_EXIT:
+            running = 0;
+            break;
+    }
+    if (config.verbose) {
+        printf("[SIM] t=%.0f script event %d floor %d value %d\n",
+               sim.now_ms, ev->kind, ev->floor, ev->value);
+    }
+}
+
+/**
+ * @brief Advances the simulation to the given simulated time.
+ *
+ * Moves the car and fires script events in time order. Motion is
+ * integrated piecewise between script events so that inputs change at
+ * the right position.
+ */
+static void sim_advance(double target_ms) {
+    double top = (config.num_floors - 1) * (double)config.travel_between_floors_ms;
+
+    while (sim.now_ms < target_ms) {
+        double step_end = target_ms;
+        if (script_next < script_len && script[script_next].time_ms < step_end) {
+            step_end = script[script_next].time_ms;
+        }
+        if (step_end < sim.now_ms) step_end = sim.now_ms;
+
+        sim.position_ms += sim.motor_direction * (step_end - sim.now_ms);
+        if (sim.position_ms < 0) sim.position_ms = 0;
+        if (sim.position_ms > top) sim.position_ms = top;
+        sim.now_ms = step_end;
+
+        while (script_next < script_len && script[script_next].time_ms <= sim.now_ms) {
+            sim_apply_script_event(&script[script_next++]);
+        }
+        if (step_end == target_ms) break;
+    }
+}
+
+/**
+ * @brief Handles one 4-byte request.
+ *
+ * @param req The request bytes.
+ * @param reply Filled with the reply for query opcodes.
+ * @return true if a reply must be sent.
+ */
+static bool sim_handle_request(const unsigned char req[4], unsigned char reply[4]) {
+    memset(reply, 0, 4);
+    reply[0] = req[0];
+
+    switch (req[0]) {
+        case 0:
+            return false;
+
+        case 1:
+            sim.motor_direction = (signed char)req[1];
+            if (config.verbose) printf("[SIM] t=%.0f motor %d\n", sim.now_ms, sim.motor_direction);
+            return false;
+
+        case 2:
+            if (req[1] < SIM_N_BUTTONS && req[2] < config.num_floors) {
+                sim.button_lamp[req[2]][req[1]] = req[3] != 0;
+                if (config.verbose) printf("[SIM] t=%.0f button lamp %d floor %d: %d\n",
+                                           sim.now_ms, req[1], req[2], req[3] != 0);
+            }
+            return false;
+
+        case 3:
+            if (req[1] < config.num_floors) sim.floor_indicator = req[1];
+            if (config.verbose) printf("[SIM] t=%.0f floor indicator %d\n", sim.now_ms, req[1]);
+            return false;
+
+        case 4:
+            sim.door_lamp = req[1] != 0;
+            if (config.verbose) printf("[SIM] t=%.0f door lamp %d\n", sim.now_ms, sim.door_lamp);
+            return false;
+
+        case 5:
+            sim.stop_lamp = req[1] != 0;
+            if (config.verbose) printf("[SIM] t=%.0f stop lamp %d\n", sim.now_ms, sim.stop_lamp);
+            return false;
+
+        case 6:
+            if (req[1] < SIM_N_BUTTONS && req[2] < config.num_floors) {
+                reply[1] = sim.button_release_ms[req[2]][req[1]] > sim.now_ms;
+            }
+            return true;
+
+        case 7: {
+            int floor = sim_floor_sensor();
+            reply[1] = floor != -1;
+            reply[2] = floor != -1 ? floor : 0;
+            return true;
+        }
+
+        case 8:
+            reply[1] = sim.stop_button;
+            return true;
+
+        case 9:
+            reply[1] = sim.obstruction;
+            return true;
+
+        case ELEVIO_OP_SUBSCRIBE:
+            subscribed = true;
+            pushed = (ElevioInputs){ .floorSensor = -1 };
+            reply[1] = 1;
+            if (config.verbose) printf("[SIM] t=%.0f client subscribed\n", sim.now_ms);
+            return true;
+
+        default:
+            return false;
+    }
+}
+
+/**
+ * @brief Returns the real time until an input may next change, capped at 100 ms.
+ */
+static int sim_next_change_ms(void) {
+    double next = sim.now_ms + 100 * config.time_scale;
+
+    if (script_next < script_len && script[script_next].time_ms < next) {
+        next = script[script_next].time_ms;
+    }
+    for (int f = 0; f < config.num_floors; f++) {
+        for (int b = 0; b < SIM_N_BUTTONS; b++) {
+            double release = sim.button_release_ms[f][b];
+            if (release > sim.now_ms && release < next) next = release;
+        }
+    }
+
+    // Each floor's sensor turns on and off travel_passing_floor_ms / 2 from it
+    if (sim.motor_direction != 0) {
+        double half = config.travel_passing_floor_ms / 2.0;
+        for (int f = 0; f < config.num_floors; f++) {
+            double center = (double)f * config.travel_between_floors_ms;
+            double edges[2] = { center - half, center + half };
+            for (int i = 0; i < 2; i++) {
+                double at = sim.now_ms + (edges[i] - sim.position_ms) / sim.motor_direction;
+                if (at > sim.now_ms && at < next) next = at;
+            }
+        }
+    }
+
+    return (int)ceil((next - sim.now_ms) / config.time_scale);
+}
+
+/**
+ * @brief Creates the shared register file.
+ *
+ * @return The mapping, or NULL on failure.
+ */
+static register_file_t* sim_shm_create(const char* name) {
+    int fd = shm_open(name, O_CREAT | O_RDWR | O_TRUNC, 0600);
+    if (fd < 0) return NULL;
+
+    void* map = MAP_FAILED;
+    if (ftruncate(fd, sizeof(register_file_t)) == 0) {
+        map = mmap(NULL, sizeof(register_file_t), PROT_READ | PROT_WRITE, MAP_SHARED, fd, 0);
+    }
+    close(fd);
+    if (map == MAP_FAILED) {
+        shm_unlink(name);
+        return NULL;
+    }
+
+    register_file_init(map, config.num_floors, 1);
+    return map;
+}
+
+/**
+ * @brief Applies every output register that differs from the simulated state.
+ *
+ * Goes through sim_handle_request() so that shared memory writes are
+ * checked and logged like TCP ones.
+ */
+static void sim_apply_outputs(const register_outputs_t* out) {
+    unsigned char reply[4];
+
+    if (out->motor != REGISTER_OUTPUT_UNSET && out->motor != sim.motor_direction) {
+        sim_handle_request((const unsigned char[4]){ 1, (unsigned char)out->motor }, reply);
+    }
+    for (int f = 0; f < config.num_floors; f++) {
+        for (int b = 0; b < SIM_N_BUTTONS; b++) {
+            int lamp = out->button_lamps[f][b];
+            if (lamp != REGISTER_OUTPUT_UNSET && (lamp != 0) != sim.button_lamp[f][b]) {
+                sim_handle_request((const unsigned char[4]){ 2, b, f, lamp }, reply);
+            }
+        }
+    }
+    if (out->floor_indicator != REGISTER_OUTPUT_UNSET && out->floor_indicator != sim.floor_indicator) {
+        sim_handle_request((const unsigned char[4]){ 3, (unsigned char)out->floor_indicator }, reply);
+    }
+    if (out->door_light != REGISTER_OUTPUT_UNSET && (out->door_light != 0) != sim.door_lamp) {
+        sim_handle_request((const unsigned char[4]){ 4, out->door_light }, reply);
+    }
+    if (out->stop_light != REGISTER_OUTPUT_UNSET && (out->stop_light != 0) != sim.stop_lamp) {
+        sim_handle_request((const unsigned char[4]){ 5, out->stop_light }, reply);
+    }
+}
+
+static void sim_read_inputs(ElevioInputs* inputs) {
+    memset(inputs, 0, sizeof(*inputs));
+    for (int f = 0; f < config.num_floors; f++) {
+        for (int b = 0; b < SIM_N_BUTTONS; b++) {
+            inputs->callButton[f][b] = sim.button_release_ms[f][b] > sim.now_ms;
+        }
+    }
+    inputs->floorSensor = sim_floor_sensor();
+    inputs->stopButton = sim.stop_button;
+    inputs->obstruction = sim.obstruction;
+}
+
+/**
+ * @brief Sends the subscribed client an event record for each changed input.
+ */
+static void sim_push_events(int client_fd) {
+    ElevioInputs inputs;
+    unsigned char tx[(SIM_MAX_FLOORS * SIM_N_BUTTONS + 4) * 4];
+    size_t tx_len = 0;
+
+    sim_read_inputs(&inputs);
+
+    // The hall buttons that do not exist are never reported pressed
+    inputs.callButton[config.num_floors - 1][0] = 0;
+    inputs.callButton[0][1] = 0;
+
+    for (int f = 0; f < config.num_floors; f++) {
+        for (int b = 0; b < SIM_N_BUTTONS; b++) {
+            if (inputs.callButton[f][b] != pushed.callButton[f][b]) {
+                memcpy(&tx[tx_len], (unsigned char[4]){ ELEVIO_OP_EVENT, b, f, inputs.callButton[f][b] }, 4);
+                tx_len += 4;
+            }
+        }
+    }
+    if (inputs.floorSensor != pushed.floorSensor) {
+        if (pushed.floorSensor != -1) {
+            memcpy(&tx[tx_len], (unsigned char[4]){ ELEVIO_OP_EVENT, ELEVIO_EVENT_FLOOR_SENSOR, pushed.floorSensor, 0 }, 4);
+            tx_len += 4;
+        }
+        if (inputs.floorSensor != -1) {
+            memcpy(&tx[tx_len], (unsigned char[4]){ ELEVIO_OP_EVENT, ELEVIO_EVENT_FLOOR_SENSOR, inputs.floorSensor, 1 }, 4);
+            tx_len += 4;
+        }
+    }
+    if (inputs.stopButton != pushed.stopButton) {
+        memcpy(&tx[tx_len], (unsigned char[4]){ ELEVIO_OP_EVENT, ELEVIO_EVENT_STOP, 0, inputs.stopButton }, 4);
+        tx_len += 4;
+    }
+    if (inputs.obstruction != pushed.obstruction) {
+        memcpy(&tx[tx_len], (unsigned char[4]){ ELEVIO_OP_EVENT, ELEVIO_EVENT_OBSTRUCTION, 0, inputs.obstruction }, 4);
+        tx_len += 4;
+    }
+
+    if (tx_len > 0) {
+        send(client_fd, tx, tx_len, 0);
+        pushed = inputs;
+    }
+}
+
+/**
+ * @brief Serves a controller through the shared register file until stopped.
+ */
+static int sim_run_shm(const char* name) {
+    register_file_t* rf = sim_shm_create(name);
+    if (rf == NULL) {
+        fprintf(stderr, "[SIM] Unable to create shared register file %s: %s\n", name, strerror(errno));
+        return 1;
+    }
+    printf("[SIM] Serving register file %s, %d floors, time scale %.2f\n",
+           name, config.num_floors, config.time_scale);
+    fflush(stdout);
+
+    ElevioInputs published;
+    unsigned outputs_seen = atomic_load(&rf->output_epoch.value);
+    double real_start = real_now_ms();
+
+    sim_read_inputs(&published);
+    register_file_publish_inputs(rf, 0, &published);
+
+    while (running) {
+        sim_advance((real_now_ms() - real_start) * config.time_scale);
+
+        unsigned outputs_now = atomic_load(&rf->output_epoch.value);
+        if (outputs_now != outputs_seen) {
+            register_outputs_t out;
+            outputs_seen = outputs_now;
+            register_file_read_outputs(rf, 0, &out);
+            sim_apply_outputs(&out);
+        }
+
+        ElevioInputs inputs;
+        sim_read_inputs(&inputs);
+        if (memcmp(&inputs, &published, sizeof(inputs)) != 0) {
+            published = inputs;
+            register_file_publish_inputs(rf, 0, &published);
+        }
+
+        register_file_wait(&rf->output_epoch, outputs_seen, sim_next_change_ms());
+    }
+
+    munmap(rf, sizeof(*rf));
+    shm_unlink(name);
+    return 0;
+}
+
+static int sim_listen(int port) {
+    int fd = socket(AF_INET, SOCK_STREAM, 0);
+    if (fd < 0) return -1;
+
+    int one = 1;
+    setsockopt(fd, SOL_SOCKET, SO_REUSEADDR, &one, sizeof(one));
+
+    struct sockaddr_in addr = {
+        .sin_family = AF_INET,
+        .sin_port = htons(port),
+        .sin_addr.s_addr = htonl(INADDR_ANY),
+    };
+    if (bind(fd, (struct sockaddr*)&addr, sizeof(addr)) < 0 || listen(fd, 1) < 0) {
+        close(fd);
+        return -1;
+    }
+    return fd;
+}
+
+/**
+ * @brief Converts the next pending script time into a poll timeout.
+ */
+static int sim_poll_timeout_ms(void) {
+    if (script_next >= script_len) return 100;
+    double sim_wait = script[script_next].time_ms - sim.now_ms;
+    double real_wait = sim_wait / config.time_scale;
+    if (real_wait < 0) return 0;
+    if (real_wait > 100) return 100;
+    return (int)ceil(real_wait);
+}
+
+int main(int argc, char** argv) {
+    const char* config_path = "simulator.con";
+    const char* script_path = NULL;
+    const char* shm_name = NULL;
+
+    for (int i = 1; i < argc; i++) {
+        if (!strcmp(argv[i], "--config") && i + 1 < argc) {
+            config_path = argv[++i];
+        }
+    }
+    sim_load_config(config_path);
+
+    for (int i = 1; i < argc; i++) {
+        const char* arg = argv[i];
+        const char* val = i + 1 < argc ? argv[i + 1] : NULL;
+        if (!strcmp(arg, "--config") && val) {
+            i++;
+        } else if (!strcmp(arg, "--script") && val) {
+            script_path = val;
+            i++;
+        } else if (!strcmp(arg, "--timeScale") && val) {
+            config.time_scale = atof(val);
+            i++;
+        } else if (!strcmp(arg, "--port") && val) {
+            config.port = atoi(val);
+            i++;
+        } else if (!strcmp(arg, "--numFloors") && val) {
+            config.num_floors = atoi(val);
+            i++;
+        } else if (!strcmp(arg, "--startFloor") && val) {
+            config.start_floor = atoi(val);
+            i++;
+        } else if (!strcmp(arg, "--verbose")) {
+            config.verbose = true;
+        } else if (!strcmp(arg, "--shm")) {
+            shm_name = REGISTER_FILE_DEFAULT_SHM;
+            if (val && val[0] == '/') {
+                shm_name = val;
+                i++;
+            }
+        } else {
+            fprintf(stderr, "Usage: %s [--config file] [--script file] [--timeScale x] "
+                            "[--port p] [--numFloors n] [--startFloor f] [--verbose] "
+                            "[--shm [name]]\n", argv[0]);
+            return 1;
+        }
+    }
+
+    if (config.num_floors < 2 || config.num_floors > SIM_MAX_FLOORS) {
+        fprintf(stderr, "[SIM] numFloors must be between 2 and %d\n", SIM_MAX_FLOORS);
+        return 1;
+    }
+    if (config.start_floor < 0 || config.start_floor >= config.num_floors) {
+        fprintf(stderr, "[SIM] startFloor must be between 0 and %d\n", config.num_floors - 1);
+        return 1;
+    }
+    if (config.time_scale <= 0) {
+        fprintf(stderr, "[SIM] timeScale must be positive\n");
+        return 1;
+    }
+    if (script_path && !sim_load_script(script_path)) {
+        return 1;
+    }
+
+    for (int f = 0; f < SIM_MAX_FLOORS; f++) {
+        for (int b = 0; b < SIM_N_BUTTONS; b++) {
+            sim.button_release_ms[f][b] = -1;
+        }
+    }
+    sim.position_ms = (double)config.start_floor * config.travel_between_floors_ms;
+
+    signal(SIGINT, on_signal);
+    signal(SIGTERM, on_signal);
+    signal(SIGPIPE, SIG_IGN);
+
+    if (shm_name != NULL) {
+        return sim_run_shm(shm_name);
+    }
+
+    int listen_fd = sim_listen(config.port);
+    if (listen_fd < 0) {
+        fprintf(stderr, "[SIM] Unable to listen on port %d: %s\n", config.port, strerror(errno));
+        return 1;
+    }
+    printf("[SIM] Listening on port %d, %d floors, time scale %.2f\n",
+           config.port, config.num_floors, config.time_scale);
+    fflush(stdout);
+
+    int client_fd = -1;
+    unsigned char rx[4];
+    int rx_len = 0;
+    double real_start = real_now_ms();
+
+    while (running) {
+        struct pollfd pfd = {
+            .fd = client_fd >= 0 ? client_fd : listen_fd,
+            .events = POLLIN,
+        };
+        poll(&pfd, 1, subscribed ? sim_next_change_ms() : sim_poll_timeout_ms());
+
+        sim_advance((real_now_ms() - real_start) * config.time_scale);
+        if (subscribed) sim_push_events(client_fd);
+
+        if (!(pfd.revents & (POLLIN | POLLHUP | POLLERR))) continue;
+
+        if (client_fd < 0) {
+            client_fd = accept(listen_fd, NULL, NULL);
+            if (client_fd >= 0) {
+                int one = 1;
+                setsockopt(client_fd, IPPROTO_TCP, TCP_NODELAY, &one, sizeof(one));
+                rx_len = 0;
+                if (config.verbose) printf("[SIM] Client connected\n");
+            }
+            continue;
+        }
+
+        unsigned char buf[512];
+        ssize_t n = recv(client_fd, buf, sizeof(buf), 0);
+        if (n <= 0) {
+            close(client_fd);
+            client_fd = -1;
+            subscribed = false;
+            if (config.stop_motor_on_disconnect) sim.motor_direction = 0;
+            if (config.verbose) printf("[SIM] Client disconnected\n");
+            continue;
+        }
+
+        // Collect replies so a pipelined batch is answered with one send
+        unsigned char tx[sizeof(buf) + 4];
+        size_t tx_len = 0;
+        for (ssize_t i = 0; i < n; i++) {
+            rx[rx_len++] = buf[i];
+            if (rx_len == 4) {
+                if (sim_handle_request(rx, &tx[tx_len])) tx_len += 4;
+                rx_len = 0;
+            }
+        }
+        if (tx_len > 0) send(client_fd, tx, tx_len, 0);
+        if (subscribed) sim_push_events(client_fd);
+    }
+
+    if (client_fd >= 0) close(client_fd);
+    close(listen_fd);
+    return 0;
+}
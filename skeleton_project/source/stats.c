@@ -0,0 +1,141 @@
+/**
+ * @file stats.c
+ * @brief Latency statistics for orders and the control loop.
+ *
+ * Order latencies are kept in microseconds, tick durations in
+ * nanoseconds, sampling rates in hertz. The snapshot thread waits for
+ * SIGUSR1 with sigtimedwait(), so no signal handler runs on the control
+ * thread and the snapshot is formatted entirely off the control path.
+ */
+
+#include "stats.h"
+#include "elevator_fsm.h"
+#include "histogram.h"
+#include <errno.h>
+#include <pthread.h>
+#include <signal.h>
+#include <stdatomic.h>
+#include <stdio.h>
+#include <string.h>
+#include <time.h>
+
+static histogram_t press_to_arrival_us[N_ORDER_TYPES][N_FLOORS_MAX];
+static histogram_t press_to_door_open_us[N_ORDER_TYPES][N_FLOORS_MAX];
+static histogram_t tick_ns;
+static histogram_t sample_rate_hz[N_STATES];
+
+static char stats_path[256];
+static int stats_period_ms;
+static pthread_t writer;
+static atomic_bool running = false;
+
+void stats_order_served(OrderType type, int floor, uint64_t added_ns,
+                        uint64_t arrival_ns, uint64_t open_ns) {
+    if (type < 0 || type >= N_ORDER_TYPES || floor < 0 || floor >= N_FLOORS_MAX) return;
+
+    // An order placed while the car already stood at the floor has arrived at once
+    uint64_t arrival = arrival_ns > added_ns ? arrival_ns - added_ns : 0;
+    uint64_t open = open_ns > added_ns ? open_ns - added_ns : 0;
+    histogram_record(&press_to_arrival_us[type][floor], arrival / 1000);
+    histogram_record(&press_to_door_open_us[type][floor], open / 1000);
+}
+
+void stats_tick(uint64_t duration_ns) {
+    histogram_record(&tick_ns, duration_ns);
+}
+
+void stats_sample_rate(int state, uint64_t rate_hz) {
+    if (state < 0 || state >= N_STATES) return;
+    histogram_record(&sample_rate_hz[state], rate_hz);
+}
+
+static void write_line(FILE* file, const char* metric, const char* type, int floor,
+                       const histogram_t* h) {
+    histogram_summary_t s = histogram_summarize(h);
+    if (s.count == 0) return;
+
+    char floor_text[12] = "-";
+    if (floor >= 0) snprintf(floor_text, sizeof(floor_text), "%d", floor);
+
+    fprintf(file, "%s %s %s %llu %llu %llu %llu %llu %llu %llu\n", metric, type, floor_text,
+            (unsigned long long)s.count, (unsigned long long)s.mean,
+            (unsigned long long)s.p50, (unsigned long long)s.p90, (unsigned long long)s.p99,
+            (unsigned long long)s.p999, (unsigned long long)s.max);
+}
+
+bool stats_write(const char* path) {
+    char tmp_path[sizeof(stats_path) + 4];
+    snprintf(tmp_path, sizeof(tmp_path), "%s.tmp", path);
+
+    FILE* file = fopen(tmp_path, "w");
+    if (file == NULL) return false;
+
+    fprintf(file, "# metric type floor count mean p50 p90 p99 p999 max\n");
+    for (int type = 0; type < N_ORDER_TYPES; type++) {
+        for (int floor = 0; floor < N_FLOORS_MAX; floor++) {
+            write_line(file, "press_to_arrival_us", order_type_to_string((OrderType)type),
+                       floor, &press_to_arrival_us[type][floor]);
+        }
+    }
+    for (int type = 0; type < N_ORDER_TYPES; type++) {
+        for (int floor = 0; floor < N_FLOORS_MAX; floor++) {
+            write_line(file, "press_to_door_open_us", order_type_to_string((OrderType)type),
+                       floor, &press_to_door_open_us[type][floor]);
+        }
+    }
+    write_line(file, "fsm_tick_ns", "-", -1, &tick_ns);
+    for (int state = 0; state < N_STATES; state++) {
+        write_line(file, "sample_rate_hz", state_id_to_string((state_id_t)state), -1,
+                   &sample_rate_hz[state]);
+    }
+
+    // Readers never see a half-written snapshot
+    bool ok = fclose(file) == 0;
+    return ok && rename(tmp_path, path) == 0;
+}
+
+static void* stats_main(void* arg) {
+    (void)arg;
+    sigset_t set;
+    sigemptyset(&set);
+    sigaddset(&set, SIGUSR1);
+
+    int wait_ms = stats_period_ms > 0 ? stats_period_ms : 3600 * 1000;
+    struct timespec timeout = { wait_ms / 1000, (wait_ms % 1000) * 1000000L };
+
+    while (1) {
+        int sig = sigtimedwait(&set, NULL, &timeout);
+        if (!atomic_load(&running)) break;
+        if (sig == SIGUSR1 || (sig == -1 && errno == EAGAIN && stats_period_ms > 0)) {
+            stats_write(stats_path);
+        }
+    }
+    stats_write(stats_path);
+    return NULL;
+}
+
+bool stats_init(const char* path, int period_ms) {
+    snprintf(stats_path, sizeof(stats_path), "%s", path);
+    stats_period_ms = period_ms;
+
+    sigset_t set;
+    sigemptyset(&set);
+    sigaddset(&set, SIGUSR1);
+    if (pthread_sigmask(SIG_BLOCK, &set, NULL) != 0) {
+        return false;
+    }
+
+    atomic_store(&running, true);
+    if (pthread_create(&writer, NULL, stats_main, NULL) != 0) {
+        atomic_store(&running, false);
+        return false;
+    }
+    return true;
+}
+
+void stats_shutdown(void) {
+    if (!atomic_exchange(&running, false)) return;
+
+    pthread_kill(writer, SIGUSR1);
+    pthread_join(writer, NULL);
+}
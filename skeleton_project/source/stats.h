@@ -0,0 +1,78 @@
+/**
+ * @file stats.h
+ * @brief Latency statistics for orders and the control loop.
+ *
+ * Keeps histograms of press-to-arrival and press-to-door-open times per
+ * order type and floor, of FSM tick durations, and of the input sampling
+ * rate achieved in each controller state. A background thread
+ * writes a snapshot to a text file periodically and whenever the process
+ * receives SIGUSR1; the control loops themselves only ever record values.
+ * Every group in the process records into the same histograms, from
+ * whichever thread drives it.
+ */
+
+#ifndef STATS_H
+#define STATS_H
+
+#include <stdbool.h>
+#include <stdint.h>
+#include "elevator_types.h"
+
+/** @brief Default snapshot file, relative to the working directory. */
+#define STATS_DEFAULT_PATH "elevator.stats"
+
+/** @brief Default period between snapshots. */
+#define STATS_DEFAULT_PERIOD_MS 10000
+
+/**
+ * @brief Starts the snapshot thread.
+ *
+ * Blocks SIGUSR1 in the calling thread so that only the snapshot thread
+ * receives it; call before any other thread is created.
+ *
+ * @param path The snapshot file, replaced on every write.
+ * @param period_ms Time between snapshots, or 0 to write only on SIGUSR1.
+ * @return true on success, false otherwise.
+ */
+bool stats_init(const char* path, int period_ms);
+
+/**
+ * @brief Writes a final snapshot and stops the snapshot thread.
+ */
+void stats_shutdown(void);
+
+/**
+ * @brief Writes a snapshot of every non-empty histogram.
+ *
+ * @param path The file to replace.
+ * @return true on success, false otherwise.
+ */
+bool stats_write(const char* path);
+
+/**
+ * @brief Records an order being served.
+ *
+ * @param type The order type.
+ * @param floor The order's floor.
+ * @param added_ns When the order was accepted.
+ * @param arrival_ns When the serving car reached the floor.
+ * @param open_ns When the door was commanded open.
+ */
+void stats_order_served(OrderType type, int floor, uint64_t added_ns,
+                        uint64_t arrival_ns, uint64_t open_ns);
+
+/**
+ * @brief Records the duration of one FSM tick.
+ */
+void stats_tick(uint64_t duration_ns);
+
+/**
+ * @brief Records the input sampling rate a car achieved over a stretch of
+ *        time in one state.
+ *
+ * @param state The state, a state_id_t.
+ * @param rate_hz Samples taken per second.
+ */
+void stats_sample_rate(int state, uint64_t rate_hz);
+
+#endif
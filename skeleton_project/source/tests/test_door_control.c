@@ -0,0 +1,99 @@
+/**
+ * @file test_door_control.c
+ * @brief Door control: dwell timing on the timer wheel, obstruction
+ *        resets and holding the door open.
+ */
+
+#include "tests.h"
+#include "door_control.h"
+
+static timer_wheel_t wheel;
+static int timeouts;
+
+static void door_state(void* ctx, fsm_events_t event) {
+    (void)ctx;
+    if (event == EVENT_DOOR_TIMEOUT) timeouts++;
+}
+
+static void advance_to(uint64_t ms) {
+    test_clock_set_ms(ms);
+    timer_wheel_advance(&wheel);
+}
+
+static void start(door_t* door, hardware_t* hw, fsm_t* fsm) {
+    test_clock_set_ms(10000);
+    timer_wheel_init(&wheel);
+    timeouts = 0;
+    *fsm = (fsm_t){0};
+    fsm_transition(fsm, door_state);
+    *hw = (hardware_t){0};
+    hw->desired.door_light = 1;
+    door_control_init(door, hw, &wheel, fsm);
+}
+
+static void test_dwell(void) {
+    door_t door;
+    hardware_t hw;
+    fsm_t fsm;
+    start(&door, &hw, &fsm);
+    CHECK(door.state == DOOR_CLOSED && hw.desired.door_light == 0);
+
+    door_control_open_door(&door);
+    CHECK(hw.desired.door_light == 1);
+    CHECK(door_control_update(&door) == DOOR_OPEN);
+
+    advance_to(10000 + DOOR_OPEN_DURATION_MS - 1);
+    CHECK(timeouts == 0 && door_control_update(&door) == DOOR_OPEN);
+    advance_to(10000 + DOOR_OPEN_DURATION_MS);
+    CHECK(timeouts == 1 && door_control_update(&door) == DOOR_CLOSED);
+
+    door_control_close_door(&door);
+    CHECK(door.state == DOOR_CLOSED && hw.desired.door_light == 0);
+}
+
+static void test_obstruction_resets(void) {
+    door_t door;
+    hardware_t hw;
+    fsm_t fsm;
+    start(&door, &hw, &fsm);
+
+    door_control_open_door(&door);
+    advance_to(12000);
+    door_control_reset_timer(&door);
+    advance_to(10000 + DOOR_OPEN_DURATION_MS);
+    CHECK(timeouts == 0 && door_control_update(&door) == DOOR_OPEN);
+    advance_to(12000 + DOOR_OPEN_DURATION_MS);
+    CHECK(timeouts == 1);
+
+    // Closing cancels the dwell, and a closed door is not reopened by a reset
+    door_control_open_door(&door);
+    door_control_close_door(&door);
+    door_control_reset_timer(&door);
+    advance_to(20000 + DOOR_OPEN_DURATION_MS);
+    CHECK(timeouts == 1 && door_control_update(&door) == DOOR_CLOSED);
+}
+
+static void test_keep_open(void) {
+    door_t door;
+    hardware_t hw;
+    fsm_t fsm;
+    start(&door, &hw, &fsm);
+
+    door_control_open_door(&door);
+    door_control_keep_open(&door);
+    door_control_reset_timer(&door);
+    advance_to(10000 + 10 * DOOR_OPEN_DURATION_MS);
+    CHECK(timeouts == 0 && door_control_update(&door) == DOOR_OPEN);
+
+    // Opening again starts a normal dwell
+    door_control_open_door(&door);
+    CHECK(!door.keep_open);
+    advance_to(10000 + 11 * DOOR_OPEN_DURATION_MS);
+    CHECK(timeouts == 1 && door_control_update(&door) == DOOR_CLOSED);
+}
+
+void test_door_control(void) {
+    test_dwell();
+    test_obstruction_resets();
+    test_keep_open();
+}
@@ -0,0 +1,140 @@
+/**
+ * @file test_fsm.c
+ * @brief Event queue: priority lanes, coalescing and run-to-completion
+ *        transitions.
+ */
+
+#include "tests.h"
+#include "fsm.h"
+
+#define LOG_CAPACITY 32
+
+typedef struct {
+    fsm_t fsm;
+    fsm_events_t log[LOG_CAPACITY];
+    int count;
+
+    /** @brief Events the first state posts while handling its first tick. */
+    fsm_events_t burst[FSM_QUEUE_CAPACITY];
+    int burst_count;
+
+    /** @brief Set while a handler runs, to catch nested delivery. */
+    bool in_handler;
+    bool nested;
+} machine_t;
+
+static void record(machine_t* m, fsm_events_t event) {
+    if (m->in_handler) m->nested = true;
+    if (m->count < LOG_CAPACITY) m->log[m->count++] = event;
+}
+
+static void second_state(void* ctx, fsm_events_t event) {
+    machine_t* m = ctx;
+    record(m, event);
+}
+
+static void first_state(void* ctx, fsm_events_t event) {
+    machine_t* m = ctx;
+    record(m, event);
+    m->in_handler = true;
+
+    if (event == EVENT_TICK && m->burst_count > 0) {
+        for (int i = 0; i < m->burst_count; i++) fsm_post(&m->fsm, m->burst[i]);
+        m->burst_count = 0;
+    }
+    if (event == EVENT_FLOOR_ARRIVED) {
+        // Takes effect after this handler, then ENTRY reaches the new state
+        fsm_transition(&m->fsm, second_state);
+        fsm_dispatch(&m->fsm, EVENT_ORDER_RECEIVED);
+    }
+    m->in_handler = false;
+}
+
+static void start(machine_t* m) {
+    *m = (machine_t){ .fsm = { .ctx = m } };
+    fsm_transition(&m->fsm, first_state);
+    m->count = 0;
+}
+
+static void test_stop_overtakes_ticks(void) {
+    machine_t m;
+    start(&m);
+
+    // Posted from a handler, so all of it is queued before any is delivered
+    m.burst[0] = EVENT_ORDER_RECEIVED;
+    m.burst[1] = EVENT_TICK;
+    m.burst[2] = EVENT_OBSTRUCTION_CLEAR;
+    m.burst[3] = EVENT_STOP_PRESSED;
+    m.burst[4] = EVENT_STOP_RELEASED;
+    m.burst_count = 5;
+    fsm_dispatch(&m.fsm, EVENT_TICK);
+
+    CHECK(m.count == 6);
+    CHECK(m.log[0] == EVENT_TICK);
+    CHECK(m.log[1] == EVENT_STOP_PRESSED);
+    CHECK(m.log[2] == EVENT_STOP_RELEASED);
+    CHECK(m.log[3] == EVENT_ORDER_RECEIVED);
+    CHECK(m.log[4] == EVENT_TICK);
+    CHECK(m.log[5] == EVENT_OBSTRUCTION_CLEAR);
+    CHECK(!m.nested);
+}
+
+static void test_coalescing(void) {
+    machine_t m;
+    start(&m);
+
+    CHECK(fsm_post(&m.fsm, EVENT_TICK));
+    CHECK(fsm_post(&m.fsm, EVENT_TICK));
+    CHECK(fsm_post(&m.fsm, EVENT_OBSTRUCTION));
+    CHECK(fsm_post(&m.fsm, EVENT_OBSTRUCTION));
+    CHECK(fsm_post(&m.fsm, EVENT_ORDER_RECEIVED));
+    CHECK(fsm_post(&m.fsm, EVENT_ORDER_RECEIVED));
+    fsm_run(&m.fsm);
+
+    CHECK(m.count == 4);
+    CHECK(m.log[0] == EVENT_TICK && m.log[1] == EVENT_OBSTRUCTION);
+    CHECK(m.log[2] == EVENT_ORDER_RECEIVED && m.log[3] == EVENT_ORDER_RECEIVED);
+
+    // Once delivered, a tick may be queued again
+    CHECK(fsm_post(&m.fsm, EVENT_TICK));
+    fsm_run(&m.fsm);
+    CHECK(m.count == 5 && m.log[4] == EVENT_TICK);
+}
+
+static void test_full_lane_drops(void) {
+    machine_t m;
+    start(&m);
+
+    for (int i = 0; i < FSM_QUEUE_CAPACITY; i++) {
+        CHECK(fsm_post(&m.fsm, EVENT_ORDER_RECEIVED));
+    }
+    CHECK(!fsm_post(&m.fsm, EVENT_ORDER_RECEIVED));
+    CHECK(m.fsm.dropped == 1);
+
+    // The urgent lane has room of its own
+    CHECK(fsm_post(&m.fsm, EVENT_STOP_PRESSED));
+    fsm_run(&m.fsm);
+    CHECK(m.count == FSM_QUEUE_CAPACITY + 1 && m.log[0] == EVENT_STOP_PRESSED);
+}
+
+static void test_transition_after_handler(void) {
+    machine_t m;
+    start(&m);
+
+    fsm_dispatch(&m.fsm, EVENT_FLOOR_ARRIVED);
+
+    CHECK(m.fsm.state == second_state);
+    CHECK(m.count == 4);
+    CHECK(m.log[0] == EVENT_FLOOR_ARRIVED);
+    CHECK(m.log[1] == EVENT_EXIT);
+    CHECK(m.log[2] == EVENT_ENTRY);
+    CHECK(m.log[3] == EVENT_ORDER_RECEIVED);
+    CHECK(!m.nested);
+}
+
+void test_fsm(void) {
+    test_stop_overtakes_ticks();
+    test_coalescing();
+    test_full_lane_drops();
+    test_transition_after_handler();
+}
@@ -0,0 +1,82 @@
+/**
+ * @file test_memory_backend.c
+ * @brief The whole controller on the in-memory register file, with the
+ *        test playing the device: finding a floor, and a trip down to a
+ *        cab call with the door opening at the end.
+ */
+
+#include "tests.h"
+#include "event_loop.h"
+#include "group_controller.h"
+#include "register_backend.h"
+
+static group_controller_t group;
+static register_file_t* device;
+static ElevioInputs inputs;
+
+static register_outputs_t outputs(void) {
+    register_outputs_t out;
+    register_file_read_outputs(device, 0, &out);
+    return out;
+}
+
+/** @brief Publishes the device's inputs and runs the controller on them. */
+static void publish(void) {
+    register_file_publish_inputs(device, 0, &inputs);
+    event_loop_handle_inputs(&group);
+    event_loop_commit_outputs(&group);
+}
+
+static void test_find_floor(void) {
+    // Between floors at startup, the car goes down to the nearest one
+    CHECK(outputs().motor == DIRN_DOWN);
+    inputs.floorSensor = 1;
+    publish();
+    CHECK(outputs().motor == DIRN_STOP);
+    CHECK(outputs().floor_indicator == 1);
+}
+
+static void test_trip_down(void) {
+    inputs.floorSensor = 3;
+    publish();
+
+    inputs.callButton[0][BUTTON_CAB] = 1;
+    publish();
+    CHECK(outputs().motor == DIRN_DOWN);
+    CHECK(outputs().button_lamps[0][BUTTON_CAB] == 1);
+
+    inputs.callButton[0][BUTTON_CAB] = 0;
+    inputs.floorSensor = -1;
+    publish();
+    inputs.floorSensor = 2;
+    publish();
+    CHECK(outputs().motor == DIRN_DOWN && outputs().floor_indicator == 2);
+
+    inputs.floorSensor = -1;
+    publish();
+    inputs.floorSensor = 0;
+    publish();
+    CHECK(outputs().motor == DIRN_STOP);
+    CHECK(outputs().floor_indicator == 0 && outputs().door_light == 1);
+    CHECK(outputs().button_lamps[0][BUTTON_CAB] == 0);
+
+    test_clock_set_ms(1000 + DOOR_OPEN_DURATION_MS);
+    event_loop_handle_deadline(&group);
+    event_loop_commit_outputs(&group);
+    CHECK(outputs().door_light == 0);
+}
+
+void test_memory_backend(void) {
+    test_clock_set_ms(1000);
+    device = memory_backend_device(4, 1);
+    inputs = (ElevioInputs){ .floorSensor = -1 };
+    register_file_publish_inputs(device, 0, &inputs);
+
+    building_t building = BUILDING_DEFAULT;
+    CHECK(hardware_interface_init(&memory_backend, &building));
+    group_controller_init(&group, &memory_backend, &building);
+    event_loop_commit_outputs(&group);
+
+    test_find_floor();
+    test_trip_down();
+}
@@ -0,0 +1,185 @@
+/**
+ * @file test_order_manager.c
+ * @brief Order table: directional queries and stops across building
+ *        sizes, up to the 64th floor where the masks end, and the ETA
+ *        schedulers' turnarounds and sweep choice.
+ */
+
+#include "tests.h"
+#include "order_manager.h"
+#include <stddef.h>
+
+static const int floor_counts[] = { 2, 4, 9, 64 };
+
+/** @brief A building on the baseline, whose stops depend on the table alone. */
+static building_t baseline_building(int floors) {
+    building_t building = BUILDING_DEFAULT;
+    building.n_floors = floors;
+    building.scheduler = ORDER_SCHEDULER_BASELINE;
+    return building;
+}
+
+static void test_above_below(int floors) {
+    building_t building = baseline_building(floors);
+    int top = floors - 1;
+    order_table_t table = {0};
+
+    for (int f = 0; f < floors; f++) {
+        CHECK(!order_manager_has_orders_above(&table, f));
+        CHECK(!order_manager_has_orders_below(&table, f));
+    }
+
+    order_table_add(&building, &table, top, ORDER_TYPE_CAB);
+    for (int f = 0; f < top; f++) CHECK(order_manager_has_orders_above(&table, f));
+    CHECK(!order_manager_has_orders_above(&table, top));
+    CHECK(!order_manager_has_orders_below(&table, top));
+    CHECK(order_manager_has_orders_below(&table, floors));
+
+    table = (order_table_t){0};
+    order_table_add(&building, &table, 0, ORDER_TYPE_HALL_UP);
+    for (int f = 1; f < floors; f++) CHECK(order_manager_has_orders_below(&table, f));
+    CHECK(!order_manager_has_orders_below(&table, 0));
+    CHECK(!order_manager_has_orders_above(&table, 0));
+    CHECK(order_manager_has_orders_above(&table, -1));
+}
+
+static void test_hall_calls_at_ends(int floors) {
+    building_t building = baseline_building(floors);
+    int top = floors - 1;
+    order_table_t table = {0};
+
+    // No car goes up from the top or down from the bottom
+    CHECK(!order_table_add(&building, &table, top, ORDER_TYPE_HALL_UP));
+    CHECK(!order_table_add(&building, &table, 0, ORDER_TYPE_HALL_DOWN));
+    CHECK(!order_table_has_orders(&table));
+    CHECK(!order_table_add(&building, &table, floors, ORDER_TYPE_CAB));
+    CHECK(!order_table_add(&building, &table, -1, ORDER_TYPE_CAB));
+    CHECK(!order_table_has_orders(&table));
+
+    CHECK(order_table_add(&building, &table, top, ORDER_TYPE_HALL_DOWN));
+    CHECK(!order_table_add(&building, &table, top, ORDER_TYPE_HALL_DOWN));
+    CHECK(order_table_has_order(&building, &table, top, ORDER_TYPE_HALL_DOWN));
+}
+
+static void test_should_stop(int floors) {
+    building_t building = baseline_building(floors);
+    int top = floors - 1;
+    int middle = floors / 2;
+    order_table_t table = {0};
+
+    order_table_add(&building, &table, top, ORDER_TYPE_HALL_DOWN);
+    order_table_add(&building, &table, 0, ORDER_TYPE_HALL_UP);
+    CHECK(order_table_should_stop(&building, &table, top, DIR_DOWN));
+    CHECK(!order_table_should_stop(&building, &table, top, DIR_UP));
+    CHECK(order_table_should_stop(&building, &table, 0, DIR_UP));
+    CHECK(!order_table_should_stop(&building, &table, 0, DIR_DOWN));
+    CHECK(!order_table_should_stop(&building, &table, floors, DIR_UP));
+
+    // Cab orders stop either way; hall calls only going their way
+    table = (order_table_t){0};
+    order_table_add(&building, &table, middle, ORDER_TYPE_CAB);
+    CHECK(order_table_should_stop(&building, &table, middle, DIR_UP));
+    CHECK(order_table_should_stop(&building, &table, middle, DIR_DOWN));
+    if (middle > 0 && middle < top) {
+        order_table_add(&building, &table, middle - 1, ORDER_TYPE_HALL_DOWN);
+        CHECK(!order_table_should_stop(&building, &table, middle - 1, DIR_UP));
+        CHECK(order_table_should_stop(&building, &table, middle - 1, DIR_DOWN));
+    }
+
+    order_table_clear_at_floor(&building, &table, middle, DIR_UP);
+    CHECK(!order_table_has_order(&building, &table, middle, ORDER_TYPE_CAB));
+}
+
+static void test_next_direction(int floors) {
+    building_t building = baseline_building(floors);
+    int top = floors - 1;
+    order_table_t table = {0};
+    int target = -1;
+
+    CHECK(order_table_next_direction(&building, &table, 0, DIR_STOP, &target) == DIR_STOP);
+
+    // The nearest order ahead is the target, however far the end is
+    order_table_add(&building, &table, top, ORDER_TYPE_CAB);
+    CHECK(order_table_next_direction(&building, &table, 0, DIR_STOP, &target) == DIR_UP && target == top);
+    if (top > 1) {
+        order_table_add(&building, &table, 1, ORDER_TYPE_HALL_DOWN);
+        CHECK(order_table_next_direction(&building, &table, 0, DIR_UP, &target) == DIR_UP && target == 1);
+    }
+
+    table = (order_table_t){0};
+    order_table_add(&building, &table, 0, ORDER_TYPE_CAB);
+    CHECK(order_table_next_direction(&building, &table, top, DIR_STOP, &target) == DIR_DOWN && target == 0);
+    CHECK(order_table_next_direction(&building, &table, top, DIR_UP, &target) == DIR_STOP);
+    CHECK(order_table_next_direction(&building, &table, 0, DIR_STOP, &target) == DIR_STOP);
+}
+
+/** @brief A building of 10 floors on an ETA scheduler. */
+static building_t eta_building(order_scheduler_t scheduler) {
+    building_t building = baseline_building(10);
+    building.scheduler = scheduler;
+    return building;
+}
+
+static void test_eta_turnaround(void) {
+    building_t baseline = baseline_building(10);
+    building_t building = eta_building(ORDER_SCHEDULER_ETA_TOTAL);
+    order_table_t table = {0};
+
+    // Going up with nothing above, a car turns for a down call here...
+    order_table_add(&building, &table, 6, ORDER_TYPE_HALL_DOWN);
+    CHECK(!order_table_should_stop(&baseline, &table, 6, DIR_UP));
+    CHECK(order_table_should_stop(&building, &table, 6, DIR_UP));
+    order_table_clear_at_floor(&building, &table, 6, DIR_UP);
+    CHECK(!order_table_has_orders(&table));
+
+    // ...but not while orders lie beyond it
+    order_table_add(&building, &table, 6, ORDER_TYPE_HALL_DOWN);
+    order_table_add(&building, &table, 8, ORDER_TYPE_CAB);
+    CHECK(!order_table_should_stop(&building, &table, 6, DIR_UP));
+    order_table_clear_at_floor(&building, &table, 8, DIR_UP);
+    CHECK(order_table_has_order(&building, &table, 6, ORDER_TYPE_HALL_DOWN));
+
+    // Turning picks up the destination calls going the new way
+    table = (order_table_t){0};
+    order_table_add_destination(&building, &table, (destination_call_t){ 6, 2 });
+    CHECK(order_table_should_stop(&building, &table, 6, DIR_UP));
+    order_table_clear_at_floor(&building, &table, 6, DIR_UP);
+    CHECK(!order_table_has_destination(&building, &table, (destination_call_t){ 6, 2 }));
+    CHECK(order_table_has_order(&building, &table, 2, ORDER_TYPE_CAB));
+    CHECK(!order_table_has_order(&building, &table, 6, ORDER_TYPE_HALL_DOWN));
+}
+
+static void test_eta_sweeps(void) {
+    building_t building = eta_building(ORDER_SCHEDULER_ETA_TOTAL);
+    building_t worst = eta_building(ORDER_SCHEDULER_ETA_WORST);
+    order_table_t table = {0};
+    int target = -1;
+
+    // From floor 5, up first serves 6, 7, 8 at 2, 7 and 12 s and 3 at 25 s
+    // (46 s in all); down first serves 3 at 4 s and 6, 7, 8 at 13, 18 and
+    // 23 s (58 s in all, but none as late as 25 s)
+    order_table_add(&building, &table, 3, ORDER_TYPE_CAB);
+    order_table_add(&building, &table, 6, ORDER_TYPE_CAB);
+    order_table_add(&building, &table, 7, ORDER_TYPE_CAB);
+    order_table_add(&building, &table, 8, ORDER_TYPE_CAB);
+    CHECK(order_table_next_direction(&building, &table, 5, DIR_STOP, &target) == DIR_UP && target == 6);
+    CHECK(order_table_next_direction(&worst, &table, 5, DIR_STOP, &target) == DIR_DOWN && target == 3);
+
+    // A lone call the other way at the far end is a turnaround, not a dead end
+    table = (order_table_t){0};
+    order_table_add(&building, &table, 7, ORDER_TYPE_HALL_DOWN);
+    CHECK(order_table_next_direction(&building, &table, 2, DIR_STOP, &target) == DIR_UP && target == 7);
+    order_table_add(&building, &table, 2, ORDER_TYPE_HALL_DOWN);
+    CHECK(order_table_next_direction(&building, &table, 2, DIR_STOP, &target) == DIR_STOP);
+}
+
+void test_order_manager(void) {
+    for (size_t i = 0; i < sizeof(floor_counts) / sizeof(floor_counts[0]); i++) {
+        test_above_below(floor_counts[i]);
+        test_hall_calls_at_ends(floor_counts[i]);
+        test_should_stop(floor_counts[i]);
+        test_next_direction(floor_counts[i]);
+    }
+    test_eta_turnaround();
+    test_eta_sweeps();
+}
@@ -0,0 +1,56 @@
+/**
+ * @file test_register_file.c
+ * @brief Register file: outputs never written, and every motor direction
+ *        written over the wire format, down included.
+ */
+
+#include "tests.h"
+#include "register_file.h"
+
+static register_file_t rf;
+
+static int8_t motor(int car) {
+    register_outputs_t out;
+    register_file_read_outputs(&rf, car, &out);
+    return out.motor;
+}
+
+static void test_unset_outputs(void) {
+    register_file_init(&rf, 4, 2);
+    CHECK(register_file_valid(&rf));
+
+    register_outputs_t out;
+    register_file_read_outputs(&rf, 1, &out);
+    CHECK(out.motor == REGISTER_OUTPUT_UNSET);
+    CHECK(out.floor_indicator == REGISTER_OUTPUT_UNSET);
+    CHECK(out.door_light == REGISTER_OUTPUT_UNSET && out.stop_light == REGISTER_OUTPUT_UNSET);
+    CHECK(out.button_lamps[3][BUTTON_CAB] == REGISTER_OUTPUT_UNSET);
+}
+
+static void test_drive_down(void) {
+    register_file_init(&rf, 4, 2);
+    unsigned seen = atomic_load(&rf.output_epoch.value);
+
+    // Down is -1 on the wire, which must not read as never written
+    register_file_write_output(&rf, 1, elevio_motorDirectionOutput(DIRN_DOWN));
+    register_file_commit_outputs(&rf);
+    CHECK(register_file_wait(&rf.output_epoch, seen, 0) != seen);
+    CHECK(motor(1) == DIRN_DOWN && motor(1) != REGISTER_OUTPUT_UNSET);
+    CHECK(motor(0) == REGISTER_OUTPUT_UNSET);
+
+    register_file_write_output(&rf, 1, elevio_motorDirectionOutput(DIRN_STOP));
+    CHECK(motor(1) == DIRN_STOP);
+    register_file_write_output(&rf, 1, elevio_motorDirectionOutput(DIRN_UP));
+    CHECK(motor(1) == DIRN_UP);
+
+    register_file_write_output(&rf, 1, elevio_floorIndicatorOutput(0));
+    register_file_write_output(&rf, 1, elevio_buttonLampOutput(0, BUTTON_CAB, 0));
+    register_outputs_t out;
+    register_file_read_outputs(&rf, 1, &out);
+    CHECK(out.floor_indicator == 0 && out.button_lamps[0][BUTTON_CAB] == 0);
+}
+
+void test_register_file(void) {
+    test_unset_outputs();
+    test_drive_down();
+}
@@ -0,0 +1,54 @@
+/**
+ * @file test_runner.c
+ * @brief Runs every unit test suite; exits with status 1 if a check failed.
+ */
+
+#include "tests.h"
+#include "clock.h"
+#include <stdio.h>
+
+static int checks;
+static int failures;
+
+static uint64_t virtual_ns;
+
+static uint64_t virtual_clock(void) {
+    return virtual_ns;
+}
+
+void test_check(bool ok, const char* expr, const char* file, int line) {
+    checks++;
+    if (!ok) {
+        failures++;
+        printf("%s:%d: check failed: %s\n", file, line, expr);
+    }
+}
+
+void test_clock_set_ms(uint64_t ms) {
+    virtual_ns = ms * 1000000u;
+    clock_set_source(virtual_clock);
+}
+
+static const struct {
+    const char* name;
+    void (*run)(void);
+} suites[] = {
+    { "fsm", test_fsm },
+    { "timer_wheel", test_timer_wheel },
+    { "door_control", test_door_control },
+    { "order_manager", test_order_manager },
+    { "register_file", test_register_file },
+    { "memory_backend", test_memory_backend },
+};
+
+int main(void) {
+    for (size_t i = 0; i < sizeof(suites) / sizeof(suites[0]); i++) {
+        int failed_before = failures;
+        suites[i].run();
+        clock_set_source(NULL);
+        printf("%-16s %s\n", suites[i].name, failures == failed_before ? "ok" : "FAILED");
+    }
+
+    printf("%d checks, %d failed\n", checks, failures);
+    return failures == 0 ? 0 : 1;
+}
@@ -0,0 +1,163 @@
+/**
+ * @file test_timer_wheel.c
+ * @brief Timer wheel: expiry, re-arming, cancelling while events are
+ *        delivered, and deadlines more than a revolution away.
+ */
+
+#include "tests.h"
+#include "fsm.h"
+#include "timer_wheel.h"
+
+/** @brief Records deliveries and optionally acts on another timer. */
+typedef struct {
+    fsm_t fsm;
+    int fired;
+    uint64_t fired_at_ms;
+
+    /** @brief Timer to cancel, or to re-arm by rearm_ms, on delivery. */
+    wheel_timer_t* other;
+    uint32_t rearm_ms;
+} recorder_t;
+
+static timer_wheel_t wheel;
+static uint64_t now_ms;
+
+static void recording_state(void* ctx, fsm_events_t event) {
+    recorder_t* r = ctx;
+    if (event != EVENT_DOOR_TIMEOUT) return;
+
+    r->fired++;
+    r->fired_at_ms = now_ms;
+    if (r->other == NULL) return;
+    if (r->rearm_ms > 0) {
+        timer_wheel_arm(&wheel, r->other, r->rearm_ms, &r->fsm, EVENT_DOOR_TIMEOUT);
+    } else {
+        timer_wheel_cancel(&wheel, r->other);
+    }
+}
+
+static void recorder_init(recorder_t* r) {
+    *r = (recorder_t){ .fsm = { .ctx = r } };
+    fsm_transition(&r->fsm, recording_state);
+}
+
+/** @brief Starts an empty wheel at the given time. */
+static void start_at(uint64_t ms) {
+    now_ms = ms;
+    test_clock_set_ms(ms);
+    timer_wheel_init(&wheel);
+}
+
+static void advance_to(uint64_t ms) {
+    now_ms = ms;
+    test_clock_set_ms(ms);
+    timer_wheel_advance(&wheel);
+}
+
+static void test_expiry(void) {
+    recorder_t r;
+    wheel_timer_t timer = {0};
+    start_at(1000);
+    recorder_init(&r);
+
+    CHECK(timer_wheel_ms_until_next(&wheel) == -1);
+    timer_wheel_arm(&wheel, &timer, 3000, &r.fsm, EVENT_DOOR_TIMEOUT);
+    CHECK(timer_wheel_is_armed(&timer));
+    CHECK(timer_wheel_ms_until_next(&wheel) == 3000);
+
+    advance_to(3999);
+    CHECK(r.fired == 0);
+    advance_to(4000);
+    CHECK(r.fired == 1 && r.fired_at_ms == 4000);
+    CHECK(!timer_wheel_is_armed(&timer));
+    advance_to(5000);
+    CHECK(r.fired == 1);
+}
+
+static void test_rearm_moves_deadline(void) {
+    recorder_t r;
+    wheel_timer_t timer = {0};
+    start_at(0);
+    recorder_init(&r);
+
+    timer_wheel_arm(&wheel, &timer, 100, &r.fsm, EVENT_DOOR_TIMEOUT);
+    advance_to(50);
+    timer_wheel_arm(&wheel, &timer, 100, &r.fsm, EVENT_DOOR_TIMEOUT);
+    advance_to(100);
+    CHECK(r.fired == 0);
+    advance_to(150);
+    CHECK(r.fired == 1 && r.fired_at_ms == 150);
+
+    timer_wheel_arm(&wheel, &timer, 10, &r.fsm, EVENT_DOOR_TIMEOUT);
+    timer_wheel_cancel(&wheel, &timer);
+    timer_wheel_cancel(&wheel, &timer);
+    advance_to(200);
+    CHECK(r.fired == 1);
+    CHECK(timer_wheel_ms_until_next(&wheel) == -1);
+}
+
+static void test_cancel_during_delivery(void) {
+    recorder_t a, b;
+    wheel_timer_t timer_a = {0}, timer_b = {0};
+    start_at(0);
+    recorder_init(&a);
+    recorder_init(&b);
+
+    // Both expire in the same advance; whichever is delivered first
+    // cancels the other, which must then not be delivered
+    a.other = &timer_b;
+    b.other = &timer_a;
+    timer_wheel_arm(&wheel, &timer_a, 20, &a.fsm, EVENT_DOOR_TIMEOUT);
+    timer_wheel_arm(&wheel, &timer_b, 20, &b.fsm, EVENT_DOOR_TIMEOUT);
+    advance_to(30);
+    CHECK(a.fired + b.fired == 1);
+    advance_to(100);
+    CHECK(a.fired + b.fired == 1);
+
+    // A timer re-armed by an earlier delivery waits for its new deadline
+    a = (recorder_t){0};
+    b = (recorder_t){0};
+    recorder_init(&a);
+    recorder_init(&b);
+    a.other = &timer_b;
+    a.rearm_ms = 50;
+    b.other = &timer_a;
+    b.rearm_ms = 50;
+    timer_wheel_arm(&wheel, &timer_a, 20, &a.fsm, EVENT_DOOR_TIMEOUT);
+    timer_wheel_arm(&wheel, &timer_b, 20, &b.fsm, EVENT_DOOR_TIMEOUT);
+    advance_to(120);
+    CHECK(a.fired + b.fired == 1);
+    CHECK(timer_wheel_ms_until_next(&wheel) == 50);
+    advance_to(170);
+    CHECK(a.fired + b.fired == 2);
+}
+
+static void test_wrap(void) {
+    recorder_t r;
+    wheel_timer_t timer = {0};
+    start_at(1000);
+    recorder_init(&r);
+
+    // Expiry 1300 shares its slot with 1044, a revolution earlier
+    timer_wheel_arm(&wheel, &timer, 300, &r.fsm, EVENT_DOOR_TIMEOUT);
+    CHECK(1300 % TIMER_WHEEL_SLOTS == 1044 % TIMER_WHEEL_SLOTS);
+    advance_to(1044);
+    CHECK(r.fired == 0 && timer_wheel_is_armed(&timer));
+    for (uint64_t ms = 1045; ms < 1300; ms += 7) advance_to(ms);
+    CHECK(r.fired == 0);
+    advance_to(1300);
+    CHECK(r.fired == 1 && r.fired_at_ms == 1300);
+
+    // After a quiet spell longer than a revolution an overdue timer fires once
+    timer_wheel_arm(&wheel, &timer, 10, &r.fsm, EVENT_DOOR_TIMEOUT);
+    advance_to(1300 + 5 * TIMER_WHEEL_SLOTS);
+    CHECK(r.fired == 2);
+    CHECK(timer_wheel_ms_until_next(&wheel) == -1);
+}
+
+void test_timer_wheel(void) {
+    test_expiry();
+    test_rearm_moves_deadline();
+    test_cancel_during_delivery();
+    test_wrap();
+}
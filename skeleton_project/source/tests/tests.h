@@ -0,0 +1,31 @@
+/**
+ * @file tests.h
+ * @brief Checks and suites of the unit tests run by `make test`.
+ *
+ * Every suite is a function that makes its checks with CHECK() and
+ * returns; test_runner.c runs them all and fails if any check did. Suites
+ * that need time to pass install the virtual clock and move it by hand.
+ */
+
+#ifndef TESTS_H
+#define TESTS_H
+
+#include <stdbool.h>
+#include <stdint.h>
+
+/** @brief Records a check, printing the expression if it failed. */
+#define CHECK(cond) test_check((cond), #cond, __FILE__, __LINE__)
+
+void test_check(bool ok, const char* expr, const char* file, int line);
+
+/** @brief Installs a virtual clock reading ms milliseconds. */
+void test_clock_set_ms(uint64_t ms);
+
+void test_fsm(void);
+void test_timer_wheel(void);
+void test_door_control(void);
+void test_order_manager(void);
+void test_register_file(void);
+void test_memory_backend(void);
+
+#endif
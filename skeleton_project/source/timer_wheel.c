@@ -0,0 +1,107 @@
+/**
+ * @file timer_wheel.c
+ * @brief Millisecond timer wheel implementation.
+ *
+ * Timers hash into one of TIMER_WHEEL_SLOTS slots by expiry time, one slot
+ * per millisecond. Advancing the wheel visits only the slots between the
+ * previous and the current time, and each slot holds a short list of the
+ * timers due in that millisecond modulo the wheel size.
+ */
+
+#include "timer_wheel.h"
+#include "clock.h"
+#include <stddef.h>
+
+static void unlink_timer(timer_wheel_t* wheel, wheel_timer_t* t) {
+    if (t->prev) {
+        t->prev->next = t->next;
+    } else {
+        wheel->slots[t->expiry_ms % TIMER_WHEEL_SLOTS] = t->next;
+    }
+    if (t->next) t->next->prev = t->prev;
+    t->next = t->prev = NULL;
+    t->armed = false;
+}
+
+void timer_wheel_init(timer_wheel_t* wheel) {
+    for (int i = 0; i < TIMER_WHEEL_SLOTS; i++) {
+        wheel->slots[i] = NULL;
+    }
+    wheel->time_ms = clock_now_ms();
+}
+
+void timer_wheel_arm(timer_wheel_t* wheel, wheel_timer_t* timer, uint32_t delay_ms,
+                     fsm_t* target, fsm_events_t event) {
+    if (timer->armed) unlink_timer(wheel, timer);
+
+    timer->expiry_ms = clock_now_ms() + delay_ms;
+    if (timer->expiry_ms < wheel->time_ms) timer->expiry_ms = wheel->time_ms;
+    timer->target = target;
+    timer->event = event;
+    timer->armed = true;
+    timer->pending = false;
+
+    wheel_timer_t** slot = &wheel->slots[timer->expiry_ms % TIMER_WHEEL_SLOTS];
+    timer->next = *slot;
+    timer->prev = NULL;
+    if (*slot) (*slot)->prev = timer;
+    *slot = timer;
+}
+
+void timer_wheel_cancel(timer_wheel_t* wheel, wheel_timer_t* timer) {
+    if (timer->armed) unlink_timer(wheel, timer);
+    timer->pending = false;
+}
+
+bool timer_wheel_is_armed(const wheel_timer_t* timer) {
+    return timer->armed;
+}
+
+int64_t timer_wheel_ms_until_next(const timer_wheel_t* wheel) {
+    uint64_t now = clock_now_ms();
+    int64_t best = -1;
+
+    for (int i = 0; i < TIMER_WHEEL_SLOTS; i++) {
+        for (const wheel_timer_t* t = wheel->slots[i]; t; t = t->next) {
+            int64_t remaining = t->expiry_ms > now ? (int64_t)(t->expiry_ms - now) : 0;
+            if (best == -1 || remaining < best) best = remaining;
+        }
+    }
+    return best;
+}
+
+void timer_wheel_advance(timer_wheel_t* wheel) {
+    uint64_t now = clock_now_ms();
+    wheel_timer_t* fired = NULL;
+    wheel_timer_t** fired_tail = &fired;
+
+    // After a long quiet period one full revolution covers every slot
+    uint64_t start = wheel->time_ms;
+    if (now - start >= TIMER_WHEEL_SLOTS) start = now - TIMER_WHEEL_SLOTS + 1;
+
+    for (uint64_t tick = start; tick <= now; tick++) {
+        wheel_timer_t* t = wheel->slots[tick % TIMER_WHEEL_SLOTS];
+        while (t) {
+            wheel_timer_t* next = t->next;
+            if (t->expiry_ms <= now) {
+                unlink_timer(wheel, t);
+                t->pending = true;
+                t->fired_next = NULL;
+                *fired_tail = t;
+                fired_tail = &t->fired_next;
+            }
+            t = next;
+        }
+    }
+    wheel->time_ms = now;
+
+    // Deliver only after the wheel is consistent, since handlers re-arm and
+    // cancel timers; a timer re-armed or cancelled meanwhile is skipped
+    while (fired) {
+        wheel_timer_t* t = fired;
+        fired = t->fired_next;
+        if (!t->pending) continue;
+        t->pending = false;
+        fsm_dispatch(t->target, t->event);
+    }
+}
@@ -0,0 +1,100 @@
+/**
+ * @file timer_wheel.h
+ * @brief Millisecond timer wheel driven by the clock module.
+ *
+ * Provides one-shot timers that deliver an FSM event when they expire.
+ * Timers are embedded in their owner's state, so arming an armed timer
+ * simply moves its deadline. Each wheel is independent; a thread that
+ * runs a set of elevators owns the wheel those elevators use.
+ */
+
+#ifndef TIMER_WHEEL_H
+#define TIMER_WHEEL_H
+
+#include <stdbool.h>
+#include <stdint.h>
+#include "fsm.h"
+
+/** @brief Number of wheel slots; one revolution spans this many ms. */
+#define TIMER_WHEEL_SLOTS 256
+
+/**
+ * @brief A one-shot timer, linked into the slot of its expiry.
+ */
+typedef struct wheel_timer {
+    struct wheel_timer* next;
+    struct wheel_timer* prev;
+    uint64_t expiry_ms;
+    fsm_t* target;
+    fsm_events_t event;
+    bool armed;
+
+    /** @brief Link and flag for expired timers awaiting delivery. */
+    struct wheel_timer* fired_next;
+    bool pending;
+} wheel_timer_t;
+
+/**
+ * @brief A timer wheel.
+ */
+typedef struct {
+    wheel_timer_t* slots[TIMER_WHEEL_SLOTS];
+
+    /** @brief Time up to which the wheel has been advanced. */
+    uint64_t time_ms;
+} timer_wheel_t;
+
+/**
+ * @brief Initializes a wheel with no timers.
+ *
+ * @param wheel The wheel to initialize.
+ */
+void timer_wheel_init(timer_wheel_t* wheel);
+
+/**
+ * @brief Arms a timer, replacing any previous deadline.
+ *
+ * @param wheel The wheel to place the timer on.
+ * @param timer The timer to arm.
+ * @param delay_ms Milliseconds from now until expiry.
+ * @param target The FSM that receives the event.
+ * @param event The event dispatched on expiry.
+ */
+void timer_wheel_arm(timer_wheel_t* wheel, wheel_timer_t* timer, uint32_t delay_ms,
+                     fsm_t* target, fsm_events_t event);
+
+/**
+ * @brief Cancels a timer. Cancelling an idle timer has no effect.
+ *
+ * @param wheel The wheel the timer was armed on.
+ * @param timer The timer to cancel.
+ */
+void timer_wheel_cancel(timer_wheel_t* wheel, wheel_timer_t* timer);
+
+/**
+ * @brief Checks whether a timer is armed.
+ *
+ * @param timer The timer to check.
+ * @return true if the timer is armed and has not yet fired.
+ */
+bool timer_wheel_is_armed(const wheel_timer_t* timer);
+
+/**
+ * @brief Returns the time until the earliest armed timer expires.
+ *
+ * @param wheel The wheel to inspect.
+ * @return Milliseconds until the next expiry, 0 if overdue, -1 if none armed.
+ */
+int64_t timer_wheel_ms_until_next(const timer_wheel_t* wheel);
+
+/**
+ * @brief Fires all timers that have expired.
+ *
+ * Each expired timer is disarmed before its event is dispatched, so a
+ * state handler may re-arm it.
+ *
+ * @param wheel The wheel to advance.
+ */
+void timer_wheel_advance(timer_wheel_t* wheel);
+
+#endif
@@ -0,0 +1,122 @@
+/**
+ * @file elevator_replay.c
+ * @brief Replays a captured elevio trace through the controller.
+ *
+ * Usage: elevator_replay [--realtime] [--log file] [--demand file]
+ *                        [--scheduler name] <trace>
+ *
+ * Runs the controller on the inputs recorded in the trace, at full speed
+ * or, with --realtime, at the recorded pace, and checks that it writes the
+ * recorded outputs in the recorded order. Exits with status 0 if every
+ * output matched. The scheduler is the one the trace names; --scheduler
+ * overrides it, and picks one for traces too old to name it.
+ *
+ * Idle cars park where the demand model says, so the model starts as the
+ * traced run's did: from --demand, or else from the snapshot the
+ * controller saved beside the trace (<trace>.demand). Without either it
+ * starts empty. The file is only read.
+ */
+
+#include "replay.h"
+#include "demand_model.h"
+#include "group_controller.h"
+#include "hardware_interface.h"
+#include "logger.h"
+#include "order_manager.h"
+#include <stdio.h>
+#include <string.h>
+
+/** @brief The group the trace is replayed through. */
+static group_controller_t group;
+
+/**
+ * @brief Loads the demand model the traced run started with.
+ *
+ * @return false if an explicitly given model could not be used.
+ */
+static bool load_demand(const building_t* building, const char* trace_path,
+                        const char* demand_path) {
+    int64_t local_ms;
+    if (!replay_local_ms(&local_ms)) local_ms = DEMAND_WALL_CLOCK;
+
+    char snapshot[256];
+    if (demand_path == NULL) {
+        snprintf(snapshot, sizeof(snapshot), "%s%s", trace_path, DEMAND_TRACE_SUFFIX);
+    }
+    const char* path = demand_path != NULL ? demand_path : snapshot;
+    if (demand_model_load(group_controller_demand(&group), building, path, local_ms)) {
+        return true;
+    }
+    if (demand_path != NULL) {
+        printf("ERROR: %s is not a usable demand model\n", demand_path);
+        return false;
+    }
+    printf("No demand model snapshot %s; starting with an empty model\n", snapshot);
+    return true;
+}
+
+int main(int argc, char** argv) {
+    bool realtime = false;
+    const char* log_path = NULL;
+    const char* demand_path = NULL;
+    const char* path = NULL;
+    const char* scheduler_name = NULL;
+
+    for (int i = 1; i < argc; i++) {
+        if (!strcmp(argv[i], "--realtime")) {
+            realtime = true;
+        } else if (!strcmp(argv[i], "--log") && i + 1 < argc) {
+            log_path = argv[++i];
+        } else if (!strcmp(argv[i], "--demand") && i + 1 < argc) {
+            demand_path = argv[++i];
+        } else if (!strcmp(argv[i], "--scheduler") && i + 1 < argc) {
+            scheduler_name = argv[++i];
+        } else if (argv[i][0] != '-' && path == NULL) {
+            path = argv[i];
+        } else {
+            path = NULL;
+            break;
+        }
+    }
+    if (path == NULL) {
+        fprintf(stderr, "Usage: %s [--realtime] [--log file] [--demand file] "
+                        "[--scheduler baseline|eta-total|eta-worst] <trace>\n", argv[0]);
+        return 2;
+    }
+
+    building_t building = BUILDING_DEFAULT;
+    order_scheduler_t scheduler;
+    if (scheduler_name != NULL && !order_scheduler_parse(scheduler_name, &scheduler)) {
+        fprintf(stderr, "%s: unknown scheduler %s\n", argv[0], scheduler_name);
+        return 2;
+    }
+    if (!replay_open(path, &building)) {
+        fprintf(stderr, "%s: %s is not a readable elevio trace\n", argv[0], path);
+        return 2;
+    }
+    if (scheduler_name != NULL) {
+        building.scheduler = scheduler;
+    }
+    if (log_path != NULL && !logger_init(log_path)) {
+        printf("ERROR: Failed to open log file %s\n", log_path);
+        return 2;
+    }
+    if (!hardware_interface_init(&replay_backend, &building)) {
+        printf("ERROR: Failed to initialize replay\n");
+        return 2;
+    }
+    if (!load_demand(&building, path, demand_path)) {
+        return 2;
+    }
+
+    group_controller_init(&group, &replay_backend, &building);
+    replay_result_t result = replay_run(&group, realtime);
+
+    printf("replayed %llu input snapshots, %llu outputs, %llu mismatches\n",
+           (unsigned long long)result.batches, (unsigned long long)result.outputs,
+           (unsigned long long)result.mismatches);
+
+    logger_shutdown();
+    replay_close();
+    return result.mismatches == 0 ? 0 : 1;
+}
@@ -0,0 +1,94 @@
+/**
+ * @file log_decode.c
+ * @brief Turns a binary log written by the logger into readable text.
+ *
+ * Usage: log_decode [file]   (default: elevator.elog)
+ *
+ * Each line starts with the record's time in seconds since the first
+ * record, followed by the event's format with its arguments filled in.
+ */
+
+#include "logger.h"
+#include "elevator_types.h"
+#include <inttypes.h>
+#include <stdio.h>
+#include <string.h>
+
+/**
+ * @brief Prints a floor mask as the list of floors it contains.
+ */
+static void print_mask(uint64_t mask) {
+    printf("{");
+    for (int floor = 0; mask != 0; floor++, mask >>= 1) {
+        if (mask & 1) {
+            printf((mask >> 1) ? "%d," : "%d", floor);
+        }
+    }
+    printf("}");
+}
+
+/**
+ * @brief Prints one record according to its event format.
+ */
+static void print_record(const log_record_t* record, uint64_t start_ns) {
+    printf("%10.3f ", (double)(record->time_ns - start_ns) / 1e9);
+
+    const char* format = logger_format(record->event);
+    if (format == NULL) {
+        printf("[LOG] unknown event %" PRIu32 "\n", record->event);
+        return;
+    }
+
+    int arg = 0;
+    for (const char* c = format; *c; c++) {
+        if (*c != '%' || c[1] == '\0') {
+            putchar(*c);
+            continue;
+        }
+
+        c++;
+        int64_t value = arg < LOG_MAX_ARGS ? record->args[arg] : 0;
+        switch (*c) {
+            case 'd': printf("%" PRId64, value); arg++; break;
+            case 'T': printf("%s", order_type_to_string((OrderType)value)); arg++; break;
+            case 'D': printf("%s", direction_to_string((Direction)value)); arg++; break;
+            case 'M': print_mask((uint64_t)value); arg++; break;
+            default: putchar('%'); putchar(*c); break;
+        }
+    }
+    putchar('\n');
+}
+
+int main(int argc, char** argv) {
+    const char* path = argc > 1 ? argv[1] : LOG_DEFAULT_PATH;
+
+    FILE* file = fopen(path, "rb");
+    if (file == NULL) {
+        fprintf(stderr, "log_decode: cannot open %s\n", path);
+        return 1;
+    }
+
+    log_file_header_t header;
+    if (fread(&header, sizeof(header), 1, file) != 1 ||
+        memcmp(header.magic, LOG_FILE_MAGIC, sizeof(header.magic)) != 0 ||
+        header.version != LOG_FILE_VERSION ||
+        header.record_size != sizeof(log_record_t)) {
+        fprintf(stderr, "log_decode: %s is not a version %d log file\n", path, LOG_FILE_VERSION);
+        fclose(file);
+        return 1;
+    }
+
+    log_record_t record;
+    uint64_t start_ns = 0;
+    bool first = true;
+    while (fread(&record, sizeof(record), 1, file) == 1) {
+        if (first) {
+            start_ns = record.time_ns;
+            first = false;
+        }
+        print_record(&record, start_ns);
+    }
+
+    fclose(file);
+    return 0;
+}